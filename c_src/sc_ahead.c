@@ -0,0 +1,360 @@
+#include <erl_nif.h>
+#include <math.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "sc_plug.h"
+
+/* Render ahead. A native worker thread runs a unit (plugin, chain or
+   graph handle) decoupled from the BEAM schedulers.
+
+   The producer pushes input periods into an input ring, the worker
+   renders them into output blocks as soon as they arrive and notifies
+   the owner with {sc_ready, Tag, N}, N being the number of blocks ready.
+   The consumer pulls ready blocks. A block is a resource of its own and
+   is handed out as resource binaries, so pulling copies no samples.
+
+   Both rings are single producer, single consumer. Indices are free
+   running counters, the ring slot is the counter modulo depth. Only one
+   process at a time may push and only one at a time may pull. The
+   mutex and condition are used only to put the idle worker to sleep.
+*/
+
+static ErlNifResourceType* sc_ahead_type;
+static ErlNifResourceType* sc_ahead_block_type;
+
+typedef struct {
+  unsigned int channels;
+  int inNumSamples;
+  float data[];
+} AheadBlock;
+
+typedef struct {
+  ErlNifEnv * env;          // Holds the input binaries until rendered
+  float * in[SC_MAX_CHANNELS];
+  int inNumSamples;
+} AheadInput;
+
+typedef struct {
+  ErlNifEnv * env;          // Holds the unit handle and the tag
+  SCUnit * unit;
+  double args[SC_MAX_ARGS];
+  unsigned int depth;
+  AheadInput * in_ring;
+  AheadBlock ** out_ring;
+  _Atomic unsigned int in_head, in_tail;
+  _Atomic unsigned int out_head, out_tail;
+  ErlNifPid pid;
+  ERL_NIF_TERM tag;
+  ErlNifEnv * msg_env;
+  ErlNifMutex * lock;       // Protects args and stop
+  ErlNifCond * wake;
+  _Atomic int waiting;
+  int stop;
+  int started;
+  ErlNifTid tid;
+} Ahead;
+
+static void wake_worker(Ahead * ahead)
+{
+  if(atomic_load(&ahead->waiting)) {
+    enif_mutex_lock(ahead->lock);
+    enif_cond_signal(ahead->wake);
+    enif_mutex_unlock(ahead->lock);
+  }
+}
+
+static int worker_can_run(Ahead * ahead)
+{
+  unsigned int out_head = atomic_load(&ahead->out_head);
+  return atomic_load(&ahead->in_head) != atomic_load(&ahead->in_tail)
+    && out_head - atomic_load(&ahead->out_tail) < ahead->depth;
+}
+
+static void ahead_render(Ahead * ahead)
+{
+  unsigned int in_tail = atomic_load_explicit(&ahead->in_tail, memory_order_relaxed);
+  unsigned int out_head = atomic_load_explicit(&ahead->out_head, memory_order_relaxed);
+  AheadInput * input = &ahead->in_ring[in_tail % ahead->depth];
+  SCUnit * unit = ahead->unit;
+  int n = input->inNumSamples;
+  double args[SC_MAX_ARGS];
+  float * out[SC_MAX_CHANNELS];
+
+  enif_mutex_lock(ahead->lock);
+  memcpy(args, ahead->args, sizeof(args));
+  enif_mutex_unlock(ahead->lock);
+
+  AheadBlock * block = enif_alloc_resource(sc_ahead_block_type,
+                                           sizeof(AheadBlock)
+                                           + unit->num_outputs * n * sizeof(float));
+  block->channels = unit->num_outputs;
+  block->inNumSamples = n;
+  for(unsigned int c = 0; c < unit->num_outputs; c++){
+    out[c] = block->data + c * n;
+  }
+  (*unit->calc)(unit, out, input->in, args, n);
+
+  enif_clear_env(input->env);
+  atomic_store_explicit(&ahead->in_tail, in_tail + 1, memory_order_release);
+  ahead->out_ring[out_head % ahead->depth] = block;
+  atomic_store(&ahead->out_head, out_head + 1);
+
+  unsigned int ready = out_head + 1 - atomic_load(&ahead->out_tail);
+  ERL_NIF_TERM msg = enif_make_tuple3(ahead->msg_env,
+                                      enif_make_atom(ahead->msg_env, "sc_ready"),
+                                      enif_make_copy(ahead->msg_env, ahead->tag),
+                                      enif_make_uint(ahead->msg_env, ready));
+  // A send invalidates msg_env too, it is cleared either way
+  enif_send(NULL, &ahead->pid, ahead->msg_env, msg);
+  enif_clear_env(ahead->msg_env);
+}
+
+static void* ahead_worker(void * arg)
+{
+  Ahead * ahead = (Ahead *) arg;
+  for(;;){
+    if(!worker_can_run(ahead)) {
+      int stop;
+      enif_mutex_lock(ahead->lock);
+      atomic_store(&ahead->waiting, 1);
+      while(!ahead->stop && !worker_can_run(ahead))
+        enif_cond_wait(ahead->wake, ahead->lock);
+      atomic_store(&ahead->waiting, 0);
+      stop = ahead->stop;
+      enif_mutex_unlock(ahead->lock);
+      if(stop) break;
+    }
+    ahead_render(ahead);
+  }
+  return NULL;
+}
+
+// ErlNifResourceDtor
+static void ahead_resource_dtor(ErlNifEnv* env, void * obj){
+  Ahead * ahead = (Ahead *) obj;
+  if(ahead->started) {
+    enif_mutex_lock(ahead->lock);
+    ahead->stop = 1;
+    enif_cond_signal(ahead->wake);
+    enif_mutex_unlock(ahead->lock);
+    enif_thread_join(ahead->tid, NULL);
+  }
+  if(ahead->out_ring) {
+    unsigned int head = atomic_load(&ahead->out_head);
+    for(unsigned int i = atomic_load(&ahead->out_tail); i != head; i++){
+      enif_release_resource(ahead->out_ring[i % ahead->depth]);
+    }
+    enif_free(ahead->out_ring);
+  }
+  if(ahead->in_ring) {
+    for(unsigned int i = 0; i < ahead->depth; i++){
+      if(ahead->in_ring[i].env) enif_free_env(ahead->in_ring[i].env);
+    }
+    enif_free(ahead->in_ring);
+  }
+  if(ahead->wake) enif_cond_destroy(ahead->wake);
+  if(ahead->lock) enif_mutex_destroy(ahead->lock);
+  if(ahead->msg_env) enif_free_env(ahead->msg_env);
+  if(ahead->env) enif_free_env(ahead->env);
+}
+
+// ahead_ctor(Handle, Args, Depth, Pid, Tag)
+static ERL_NIF_TERM ahead_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * unit;
+  unsigned int depth;
+  ErlNifPid pid;
+  double args[SC_MAX_ARGS];
+
+  if((unit = sc_unit_from_handle(env, argv[0])) == NULL ||
+     unit->num_inputs > SC_MAX_CHANNELS ||
+     unit->num_outputs == 0 || unit->num_outputs > SC_MAX_CHANNELS){
+    return enif_make_badarg(env);
+  }
+  if(!sc_get_args(env, argv[1], args)){
+    return enif_make_badarg(env);
+  }
+  if(!enif_get_uint(env, argv[2], &depth) || depth == 0){
+    return enif_make_badarg(env);
+  }
+  if(!enif_get_local_pid(env, argv[3], &pid)){
+    return enif_make_badarg(env);
+  }
+
+  Ahead * ahead = enif_alloc_resource(sc_ahead_type, sizeof(Ahead));
+  memset(ahead, 0, sizeof(Ahead));
+  ahead->env = enif_alloc_env();
+  enif_make_copy(ahead->env, argv[0]);
+  ahead->tag = enif_make_copy(ahead->env, argv[4]);
+  ahead->unit = unit;
+  memcpy(ahead->args, args, sizeof(args));
+  ahead->depth = depth;
+  ahead->in_ring = enif_alloc(depth * sizeof(AheadInput));
+  for(unsigned int i = 0; i < depth; i++){
+    ahead->in_ring[i].env = enif_alloc_env();
+  }
+  ahead->out_ring = enif_alloc(depth * sizeof(AheadBlock *));
+  ahead->pid = pid;
+  ahead->msg_env = enif_alloc_env();
+  ahead->lock = enif_mutex_create("sc_ahead_lock");
+  ahead->wake = enif_cond_create("sc_ahead_wake");
+
+  if(enif_thread_create("sc_ahead_worker", &ahead->tid, ahead_worker, ahead, NULL) != 0){
+    enif_release_resource(ahead);
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Could not start worker thread",
+                                                 ERL_NIF_LATIN1));
+  }
+  ahead->started = 1;
+
+  ERL_NIF_TERM term = enif_make_resource(env, ahead);
+  enif_release_resource(ahead);
+  return term;
+}
+
+static ERL_NIF_TERM ahead_push(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Ahead * ahead;
+  unsigned int channels;
+  int inNumSamples = 0;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_ahead_type,
+                         (void**) &ahead)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  unsigned int in_head = atomic_load_explicit(&ahead->in_head, memory_order_relaxed);
+  if(in_head - atomic_load_explicit(&ahead->in_tail, memory_order_acquire) == ahead->depth){
+    return enif_make_atom(env, "full");
+  }
+
+  // The copy shares refc binaries, so the samples are not copied
+  AheadInput * input = &ahead->in_ring[in_head % ahead->depth];
+  ERL_NIF_TERM frames = enif_make_copy(input->env, argv[1]);
+  if(!sc_get_channels(input->env, frames, input->in, SC_MAX_CHANNELS, &channels, &inNumSamples)){
+    enif_clear_env(input->env);
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Input stream not a binary nor a list of binaries of one length",
+                                                 ERL_NIF_LATIN1));
+  }
+  // A unit taking more inputs than given gets the last channel repeated
+  for(unsigned int c = channels; c < SC_MAX_CHANNELS; c++){
+    input->in[c] = input->in[channels - 1];
+  }
+  input->inNumSamples = inNumSamples;
+
+  atomic_store(&ahead->in_head, in_head + 1);
+  wake_worker(ahead);
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM ahead_pull(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Ahead * ahead;
+  ERL_NIF_TERM out_term[SC_MAX_CHANNELS];
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_ahead_type,
+                         (void**) &ahead)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  unsigned int out_tail = atomic_load_explicit(&ahead->out_tail, memory_order_relaxed);
+  if(atomic_load_explicit(&ahead->out_head, memory_order_acquire) == out_tail){
+    return enif_make_atom(env, "empty");
+  }
+
+  AheadBlock * block = ahead->out_ring[out_tail % ahead->depth];
+  size_t size = block->inNumSamples * sizeof(float);
+  for(unsigned int c = 0; c < block->channels; c++){
+    out_term[c] = enif_make_resource_binary(env, block,
+                                            block->data + c * block->inNumSamples, size);
+  }
+  // The binaries now keep the block alive
+  enif_release_resource(block);
+
+  atomic_store(&ahead->out_tail, out_tail + 1);
+  wake_worker(ahead);
+
+  if (block->channels == 1){
+    return out_term[0];
+  } else {
+    return enif_make_list_from_array(env, out_term, block->channels);
+  }
+}
+
+static ERL_NIF_TERM ahead_ready(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Ahead * ahead;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_ahead_type,
+                         (void**) &ahead)){
+    return enif_make_badarg(env);
+  }
+  return enif_make_uint(env, atomic_load(&ahead->out_head) - atomic_load(&ahead->out_tail));
+}
+
+static ERL_NIF_TERM ahead_set_args(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Ahead * ahead;
+  double args[SC_MAX_ARGS];
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_ahead_type,
+                         (void**) &ahead)){
+    return enif_make_badarg(env);
+  }
+  if (!sc_get_args(env, argv[1], args)){
+    return enif_make_badarg(env);
+  }
+  enif_mutex_lock(ahead->lock);
+  memcpy(ahead->args, args, sizeof(args));
+  enif_mutex_unlock(ahead->lock);
+  return enif_make_atom(env, "ok");
+}
+
+/* ---------------------------------------------------------- */
+static ErlNifFunc nif_funcs[] = {
+  {"ahead_ctor", 5, ahead_ctor},
+  {"ahead_push", 2, ahead_push},
+  {"ahead_pull", 1, ahead_pull},
+  {"ahead_ready", 1, ahead_ready},
+  {"ahead_set_args", 2, ahead_set_args}
+};
+
+static int open_ahead_resource_types(ErlNifEnv* env)
+{
+  const char* mod = "Elixir.SC.Ahead";
+  int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
+  sc_ahead_type =
+    enif_open_resource_type(env, mod, "sc_ahead",
+                            ahead_resource_dtor, flags, NULL);
+  sc_ahead_block_type =
+    enif_open_resource_type(env, mod, "sc_ahead_block",
+                            NULL, flags, NULL);
+  return ((sc_ahead_type == NULL || sc_ahead_block_type == NULL) ? -1:0);
+}
+
+static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
+{
+  return open_ahead_resource_types(caller_env);
+}
+
+static int upgrade(ErlNifEnv* caller_env, void** priv_data, void** old_priv_data,
+		   ERL_NIF_TERM load_info)
+{
+  return open_ahead_resource_types(caller_env);
+}
+
+
+ERL_NIF_INIT(Elixir.SC.Ahead, nif_funcs, load, NULL, upgrade, NULL);
@@ -17,23 +17,179 @@ static inline int advance_int_phase(int newphase, int max){
 
 static ErlNifResourceType* analog_echo_type;
 
-typedef struct
+typedef struct AnalogEcho
 {
+  SCUnit sc;
   unsigned int rate;
   unsigned int period_size;
   float maxdelay;  // Max delay in seconds
   int bufsize;     // Size of buffer in samples, always modulo 8
   float* empty_period; // Empty period buffer
-  float* buf; // Buffer itself
+  void* buf;  // Buffer itself, samples in storage
+  int storage;  // SC_STORE_F32, F16 or I16, see sc_load
   int writephase;  // Position of write head
   float s1;   // State of the one-pole lowpass filter
+  int reset;  // Clear the state before the next block, see analog_echo_reset
 } AnalogEcho;
 
+static inline void AnalogEcho_clear(AnalogEcho* aep)
+{
+  memset(aep->buf, 0, aep->bufsize * sc_storage_size(aep->storage));
+  aep->writephase = 0;
+  aep->s1 = 0.0;
+  aep->reset = 0;
+}
+
+
+static sc_always_inline void AnalogEcho_run(AnalogEcho* aep, float * out, float * in,
+                                           double * args, int inNumSamples, const int storage)
+{
+  // control(-rate) parameters
+  double delay = args[0]; // delay
+  double fb = args[1];    // feedback coefficient
+  double coeff = args[2]; // filter coefficient
+
+  if (aep->reset) AnalogEcho_clear(aep);
+  void* buf = aep->buf;
+  int writephase = aep->writephase;
+  float s1 = aep->s1;
+  int bufsize = aep->bufsize;
+
+  if (delay > aep->maxdelay){
+    delay = aep->maxdelay;
+  }
+
+  float delay_samples = (float) aep->rate * delay;
+  int offset = delay_samples;
+  float frac = delay_samples - offset;
+
+  float a = 1 - fabsf(coeff);
+  for (int i = 0; i < inNumSamples; i++) {
+
+    // Four integer phases into the buffer
+    int phase1 = writephase - offset;
+    int phase2 = phase1 - 1;
+    int phase3 = phase1 - 2;
+    int phase0 = phase1 + 1;
+    float d0 = sc_load(buf, advance_int_phase(phase0, bufsize), storage);
+    float d1 = sc_load(buf, advance_int_phase(phase1, bufsize), storage);
+    float d2 = sc_load(buf, advance_int_phase(phase2, bufsize), storage);
+    float d3 = sc_load(buf, advance_int_phase(phase3, bufsize), storage);
+    // Use cubic interpolation with the fractional part of the delay in samples
+    float delayed = cubicinterp(frac, d0, d1, d2, d3);
+
+    // Apply lowpass filter and store the state of the filter.
+    float lowpassed = a * delayed + coeff * s1;
+    s1 = lowpassed;
+
+    // Multiply by feedback coefficient and add to input signal.
+    // zapgremlins gets rid of Bad Things like denormals, explosions, etc.
+    out[i] = zapgremlins(in[i] + fb * lowpassed);
+    sc_store(buf, writephase, out[i], storage);
+
+    writephase = advance_int_phase(writephase + 1, bufsize);
+  }
+
+  // Two variables were updated and need to be stored back into the state of the UGen.
+  aep->writephase = writephase;
+  aep->s1 = s1;
+}
+
+// As AnalogEcho_run with one delay time per sample, the read head
+// follows the modulated position (chorus, flanger, tape wobble).
+static sc_always_inline void AnalogEcho_run_ar(AnalogEcho* aep, float * out, const float * in,
+                                              const float * delay, double * args,
+                                              int inNumSamples, const int storage)
+{
+  double fb = args[1];
+  double coeff = args[2];
+
+  if (aep->reset) AnalogEcho_clear(aep);
+  void* buf = aep->buf;
+  int writephase = aep->writephase;
+  float s1 = aep->s1;
+  int bufsize = aep->bufsize;
+  float maxdelay = aep->maxdelay;
+  float rate = (float) aep->rate;
+
+  float a = 1 - fabs(coeff);
+  for (int i = 0; i < inNumSamples; i++) {
+    float d = delay[i];
+    // Clamp to [0, maxdelay], NaN reads at 0
+    if (!(d > 0.f)) {
+      d = 0.f;
+    } else if (d > maxdelay) {
+      d = maxdelay;
+    }
+    float delay_samples = rate * d;
+    int offset = delay_samples;
+    float frac = delay_samples - offset;
+
+    int phase1 = writephase - offset;
+    float d0 = sc_load(buf, advance_int_phase(phase1 + 1, bufsize), storage);
+    float d1 = sc_load(buf, advance_int_phase(phase1, bufsize), storage);
+    float d2 = sc_load(buf, advance_int_phase(phase1 - 1, bufsize), storage);
+    float d3 = sc_load(buf, advance_int_phase(phase1 - 2, bufsize), storage);
+    float delayed = cubicinterp(frac, d0, d1, d2, d3);
+
+    float lowpassed = a * delayed + coeff * s1;
+    s1 = lowpassed;
+
+    out[i] = zapgremlins(in[i] + fb * lowpassed);
+    sc_store(buf, writephase, out[i], storage);
+
+    writephase = advance_int_phase(writephase + 1, bufsize);
+  }
+
+  aep->writephase = writephase;
+  aep->s1 = s1;
+}
+
+// One kernel per storage
+static void AnalogEcho_next(AnalogEcho* aep, float * out, float * in, double * args, int inNumSamples)
+{
+  switch (aep->storage) {
+  case SC_STORE_F16:
+    AnalogEcho_run(aep, out, in, args, inNumSamples, SC_STORE_F16);
+    break;
+  case SC_STORE_I16:
+    AnalogEcho_run(aep, out, in, args, inNumSamples, SC_STORE_I16);
+    break;
+  default:
+    AnalogEcho_run(aep, out, in, args, inNumSamples, SC_STORE_F32);
+  }
+}
+
+static void AnalogEcho_next_ar(AnalogEcho* aep, float * out, const float * in,
+                               const float * delay, double * args, int inNumSamples)
+{
+  switch (aep->storage) {
+  case SC_STORE_F16:
+    AnalogEcho_run_ar(aep, out, in, delay, args, inNumSamples, SC_STORE_F16);
+    break;
+  case SC_STORE_I16:
+    AnalogEcho_run_ar(aep, out, in, delay, args, inNumSamples, SC_STORE_I16);
+    break;
+  default:
+    AnalogEcho_run_ar(aep, out, in, delay, args, inNumSamples, SC_STORE_F32);
+  }
+}
+
+static const char * const analog_echo_names[] = {"delay", "fb", "coeff"};
+
+static void analog_echo_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  sc_bus_args(sc, args);
+  AnalogEcho_next((AnalogEcho *) sc, out[0], in[0], args, inNumSamples);
+}
+
+// Live instances and bytes of the echoes, see sc_mem_charge
+static SCMemType analog_echo_mem = {"analog_echo"};
 
 static ERL_NIF_TERM analog_echo_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   double maxdelay;
   unsigned int rate, period_size;
+  int storage;
   if (!enif_get_uint(env, argv[0], &rate)){
     return enif_make_badarg(env);
   }
@@ -43,8 +199,13 @@ static ERL_NIF_TERM analog_echo_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TER
   if (!enif_get_double(env, argv[2], &maxdelay)){
     return enif_make_badarg(env);
   }
+  if (!sc_get_storage(env, argv[3], &storage)){
+    return enif_make_badarg(env);
+  }
 
   AnalogEcho * aep  = enif_alloc_resource(analog_echo_type, sizeof(AnalogEcho));
+  sc_unit_init(&aep->sc, 1, 1, 3, &analog_echo_calc);
+  sc_unit_params(&aep->sc, analog_echo_names, (double []) {maxdelay, 0.9, 0.95});
   aep->rate = rate;
   aep->period_size = period_size;
   aep->maxdelay = (float) maxdelay;
@@ -55,11 +216,19 @@ static ERL_NIF_TERM analog_echo_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TER
   }
 
   aep->bufsize = ((int)(rate * aep->maxdelay) / 8 + 2) * 8;
-  aep->buf = (float *) enif_alloc(aep->bufsize * sizeof(float));
-  memset(aep->buf, 0, aep->bufsize * sizeof(float));
+  aep->storage = storage;
+  aep->buf = sc_delay_alloc(aep->bufsize * sc_storage_size(storage));
+  memset(aep->buf, 0, aep->bufsize * sc_storage_size(storage));
 
   aep->writephase = 0;
   aep->s1 = 0.0;
+  aep->reset = 0;
+  if (!sc_mem_charge(&aep->sc.mem, &analog_echo_mem,
+                     sizeof(AnalogEcho) + period_size * sizeof(float)
+                     + aep->bufsize * sc_storage_size(storage))){
+    enif_release_resource(aep);
+    return sc_budget_exceeded(env);
+  }
   ERL_NIF_TERM term = enif_make_resource(env, aep);
   enif_release_resource(aep);
   return term;
@@ -67,8 +236,9 @@ static ERL_NIF_TERM analog_echo_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TER
 
 // ErlNifResourceDtor
 static void ae_resource_dtor(ErlNifEnv* env, void * obj){
-  enif_free(((AnalogEcho*) obj)->buf);
+  sc_delay_free(((AnalogEcho*) obj)->buf);
   enif_free(((AnalogEcho*) obj)->empty_period);
+  sc_unit_release(&((AnalogEcho*) obj)->sc);
 }
 
 static ERL_NIF_TERM analog_echo_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
@@ -76,14 +246,14 @@ static ERL_NIF_TERM analog_echo_next(ErlNifEnv* env, int argc, const ERL_NIF_TER
   AnalogEcho * aep; // state pointer
 
   // Audio rate input output
-  ErlNifBinary in_bin;
+  ErlNifBinary in_bin, delay_bin;
   float * out, * in;
   ERL_NIF_TERM out_term;
 
-  // control(-rate) parameters
-  double delay; // delay
-  double fb;    // feedback coefficient
-  double coeff; // filter coefficient
+  // control(-rate) parameters: delay, feedback and filter coefficient,
+  // or an audio rate delay binary with one delay time per sample
+  double args[3] = {0., 0., 0.};
+  const float * delay = NULL;
 
   if (!enif_get_resource(env, argv[0], analog_echo_type, (void**) &aep)){
     return enif_make_badarg(env);
@@ -92,12 +262,20 @@ static ERL_NIF_TERM analog_echo_next(ErlNifEnv* env, int argc, const ERL_NIF_TER
     return enif_make_badarg(env);
   }
 
-  if(!(enif_get_double(env, argv[2], &delay) &&
-       enif_get_double(env, argv[3], &fb) &&
-       enif_get_double(env, argv[4], &coeff))) {
+  if(enif_inspect_binary(env, argv[2], &delay_bin)){
+    delay = (const float *) delay_bin.data;
+  }
+  if(!((delay || enif_get_double(env, argv[2], &args[0])) &&
+       enif_get_double(env, argv[3], &args[1]) &&
+       enif_get_double(env, argv[4], &args[2]))) {
     return enif_make_badarg(env);
   }
 
+  if(sc_dirty_needed(in_bin.size / sizeof(float))){
+    return enif_schedule_nif(env, "analog_echo_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             analog_echo_next, argc, argv);
+  }
+
   unsigned int inNumSamples;
 
   if(in_bin.size == 0) {
@@ -107,75 +285,123 @@ static ERL_NIF_TERM analog_echo_next(ErlNifEnv* env, int argc, const ERL_NIF_TER
     inNumSamples = in_bin.size / sizeof(float);
     in = (float * ) in_bin.data;
   }
-  out = (float *) enif_make_new_binary(env, inNumSamples * sizeof(float), &out_term);
+  if(delay && delay_bin.size != inNumSamples * sizeof(float)) {
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Delay binary not as long as the input",
+                                                 ERL_NIF_LATIN1));
+  }
+  out = sc_make_output(env, &aep->sc, inNumSamples * sizeof(float), &out_term);
 
-  float* buf = aep->buf;
-  int writephase = aep->writephase;
-  float s1 = aep->s1;
-  int bufsize = aep->bufsize;
+  if(delay) {
+    // A delay binary wins over a bound delay slot, fb and coeff may be bound
+    sc_bus_args(&aep->sc, args);
+    AnalogEcho_next_ar(aep, out, in, delay, args, inNumSamples);
+  } else {
+    analog_echo_calc(&aep->sc, &out, &in, args, inNumSamples);
+  }
 
-  if (delay > aep->maxdelay){
-    delay = aep->maxdelay;
+  return out_term;
+}
+
+static ERL_NIF_TERM analog_echo_unit(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  AnalogEcho * aep;
+
+  if (!enif_get_resource(env, argv[0], analog_echo_type, (void**) &aep)){
+    return enif_make_badarg(env);
   }
+  return sc_unit_handle(env, &aep->sc);
+}
 
-  float delay_samples = (float) aep->rate * delay;
-  int offset = delay_samples;
-  float frac = delay_samples - offset;
+static ERL_NIF_TERM analog_echo_next_events(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  AnalogEcho * aep;
 
-  float a = 1 - fabsf(coeff);
-  for (unsigned int i = 0; i < inNumSamples; i++) {
+  if (!enif_get_resource(env, argv[0], analog_echo_type, (void**) &aep)){
+    return enif_make_badarg(env);
+  }
+  return sc_next_events(env, &aep->sc, "analog_echo_next_events", analog_echo_next_events,
+                        argc, argv);
+}
 
-    // Four integer phases into the buffer
-    int phase1 = writephase - offset;
-    int phase2 = phase1 - 1;
-    int phase3 = phase1 - 2;
-    int phase0 = phase1 + 1;
-    float d0 = buf[advance_int_phase(phase0, bufsize)];
-    float d1 = buf[advance_int_phase(phase1, bufsize)];
-    float d2 = buf[advance_int_phase(phase2, bufsize)];
-    float d3 = buf[advance_int_phase(phase3, bufsize)];
-    // Use cubic interpolation with the fractional part of the delay in samples
-    float delayed = cubicinterp(frac, d0, d1, d2, d3);
+static ERL_NIF_TERM analog_echo_set_params(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  AnalogEcho * aep;
 
-    // Apply lowpass filter and store the state of the filter.
-    float lowpassed = a * delayed + coeff * s1;
-    s1 = lowpassed;
+  if (!enif_get_resource(env, argv[0], analog_echo_type, (void**) &aep)){
+    return enif_make_badarg(env);
+  }
+  return sc_set_params(env, &aep->sc, argv);
+}
 
-    // Multiply by feedback coefficient and add to input signal.
-    // zapgremlins gets rid of Bad Things like denormals, explosions, etc.
-    out[i] = zapgremlins(in[i] + fb * lowpassed);
-    buf[writephase] = out[i];
+static ERL_NIF_TERM analog_echo_process(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  AnalogEcho * aep;
 
-    writephase = advance_int_phase(writephase + 1, bufsize);
+  if (!enif_get_resource(env, argv[0], analog_echo_type, (void**) &aep)){
+    return enif_make_badarg(env);
   }
+  return sc_process(env, &aep->sc, "analog_echo_process", analog_echo_process, argc, argv);
+}
 
-  // Two variables were updated and need to be stored back into the state of the UGen.
-  aep->writephase = writephase;
-  aep->s1 = s1;
+// Clear the delay line for reuse, e.g. by SC.Pool. Lazily, the next
+// call clears it before it renders.
+static ERL_NIF_TERM analog_echo_reset(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  AnalogEcho * aep;
 
-  return out_term;
+  if (!enif_get_resource(env, argv[0], analog_echo_type, (void**) &aep)){
+    return enif_make_badarg(env);
+  }
+  aep->reset = 1;
+  return enif_make_atom(env, "ok");
+}
+
+// analog_echo_delay_memory(), delay memory counters, see sc_delay_alloc
+static ERL_NIF_TERM analog_echo_delay_memory(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_delay_stats_term(env);
+}
+
+// analog_echo_memory_stats(), live instances and bytes of the echoes
+static ERL_NIF_TERM analog_echo_memory_stats(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_mem_stats(env, &analog_echo_mem, 1);
+}
+
+static ERL_NIF_TERM analog_echo_memory_budget(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_mem_budget(env, &analog_echo_mem, 1, argv);
 }
 
 /* ----------------------------------------------------------------------- */
 
 static ErlNifFunc nif_funcs[] = {
-  {"analog_echo_ctor", 3, analog_echo_ctor},
-  {"analog_echo_next", 5, analog_echo_next}
+  {"analog_echo_ctor", 4, analog_echo_ctor},
+  {"analog_echo_next", 5, analog_echo_next},
+  {"analog_echo_unit", 1, analog_echo_unit},
+  {"analog_echo_next_events", 4, analog_echo_next_events},
+  {"analog_echo_set_params", 2, analog_echo_set_params},
+  {"analog_echo_process", 2, analog_echo_process},
+  {"analog_echo_reset", 1, analog_echo_reset},
+  {"analog_echo_delay_memory", 0, analog_echo_delay_memory},
+  {"analog_echo_memory_stats", 0, analog_echo_memory_stats},
+  {"analog_echo_memory_budget", 2, analog_echo_memory_budget}
 };
 
 static int open_analog_echo_resource_type(ErlNifEnv* env)
 {
-  const char* mod = "Elixir.Granulix.Plugin.AnalogEcho";
   const char* resource_type = "analog_echo";
   int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
   analog_echo_type =
-    enif_open_resource_type(env, mod, resource_type,
-                            ae_resource_dtor, flags, NULL);
+    sc_open_unit_type(env, resource_type, ae_resource_dtor, flags);
   return ((analog_echo_type == NULL) ? -1:0);
 }
 
 static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
 {
+  sc_delay_load(caller_env, load_info);
   return open_analog_echo_resource_type(caller_env);
 }
 
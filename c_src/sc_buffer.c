@@ -0,0 +1,248 @@
+#include <erl_nif.h>
+#include <math.h>
+#include <string.h>
+#include "sc_plug.h"
+
+/* Reusable native buffers. A buffer holds one period of up to
+   SC_MAX_CHANNELS channels and runs units on it through their unit
+   handles (see sc_plug.h), so a stream of plugins works on one buffer
+   per voice instead of allocating an output binary per plugin and
+   period. Every run writes to the second of two sets of channels and
+   swaps them, kernels never see the same array as input and output.
+   Only write and read copy, from and to Erlang binaries.
+
+   A buffer is meant to be used by one process at a time.
+
+   Output block rings of units (see sc_plug.h) are set up here too, the
+   block resource type is opened by this library.
+*/
+
+static ErlNifResourceType* sc_buffer_type;
+static ErlNifResourceType* sc_block_type;
+
+typedef struct {
+  int size;               // Capacity of each channel in samples
+  int length;             // Samples of the current period
+  unsigned int channels;  // Channels of the current period
+  unsigned int front;     // Set holding the current period, 0 or 1
+  float * data;           // 2 sets of SC_MAX_CHANNELS channels of size
+} Buffer;
+
+// ErlNifResourceDtor
+static void buffer_resource_dtor(ErlNifEnv* env, void * obj){
+  enif_free(((Buffer *) obj)->data);
+}
+
+// Channel c of set s
+static inline float * buffer_channel(Buffer * buf, unsigned int s, unsigned int c){
+  return buf->data + (s * SC_MAX_CHANNELS + c) * buf->size;
+}
+
+static ERL_NIF_TERM buffer_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  int size;
+
+  if (!enif_get_int(env, argv[0], &size) || size <= 0){
+    return enif_make_badarg(env);
+  }
+
+  Buffer * buf = enif_alloc_resource(sc_buffer_type, sizeof(Buffer));
+  size_t bytes = 2 * SC_MAX_CHANNELS * size * sizeof(float);
+  buf->size = size;
+  buf->length = 0;
+  buf->channels = 1;
+  buf->front = 0;
+  buf->data = enif_alloc(bytes);
+  memset(buf->data, 0, bytes);
+
+  ERL_NIF_TERM term = enif_make_resource(env, buf);
+  enif_release_resource(buf);
+  return term;
+}
+
+// buffer_write(Ref, Frames), frames a binary or a list of channel binaries
+static ERL_NIF_TERM buffer_write(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Buffer * buf;
+  ErlNifBinary in_bin[SC_MAX_CHANNELS];
+  unsigned int channels = 0;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_buffer_type,
+                         (void**) &buf)){
+    return sc_raise(env, "No valid reference");
+  }
+
+  if(enif_inspect_binary(env, argv[1], &in_bin[0])){
+    channels = 1;
+  }else{
+    ERL_NIF_TERM list = argv[1], head, tail;
+    while (enif_get_list_cell(env, list, &head, &tail)){
+      if(channels == SC_MAX_CHANNELS || !enif_inspect_binary(env, head, &in_bin[channels])){
+        return sc_raise(env, "Input stream not a binary");
+      }
+      channels++;
+      list = tail;
+    }
+    if(channels == 0) {
+      return sc_raise(env, "Input stream not a binary nor a list");
+    }
+  }
+  for(unsigned int c = 0; c < channels; c++){
+    if(in_bin[c].size != in_bin[0].size || in_bin[c].size > buf->size * sizeof(float)){
+      return sc_raise(env, "Frames longer than the buffer or channels of different length");
+    }
+  }
+
+  buf->length = in_bin[0].size / sizeof(float);
+  buf->channels = channels;
+  for(unsigned int c = 0; c < channels; c++){
+    memcpy(buffer_channel(buf, buf->front, c), in_bin[c].data, buf->length * sizeof(float));
+  }
+  return enif_make_atom(env, "ok");
+}
+
+// buffer_run(Ref, UnitHandle, Args), args a list of floats or the atom
+// params for the sticky parameters of the unit
+static ERL_NIF_TERM buffer_run(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Buffer * buf;
+  SCUnit * unit;
+  double args[SC_MAX_ARGS];
+  float * in_array[SC_MAX_CHANNELS];
+  float * out_array[SC_MAX_CHANNELS];
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_buffer_type,
+                         (void**) &buf)){
+    return sc_raise(env, "No valid reference");
+  }
+  if ((unit = sc_unit_from_handle(env, argv[1])) == NULL ||
+      unit->num_inputs > SC_MAX_CHANNELS || unit->num_outputs > SC_MAX_CHANNELS){
+    return sc_raise(env, "No valid unit handle");
+  }
+
+  if (enif_is_identical(argv[2], enif_make_atom(env, "params"))){
+    memcpy(args, unit->params, sizeof(args));
+  }else{
+    ERL_NIF_TERM list = argv[2], head, tail;
+    unsigned int i = 0;
+    memset(args, 0, sizeof(args));
+    while (enif_get_list_cell(env, list, &head, &tail)){
+      if(i == SC_MAX_ARGS || !enif_get_double(env, head, &args[i++])){
+        return sc_raise(env, "Args not a list of floats");
+      }
+      list = tail;
+    }
+  }
+
+  if(sc_dirty_needed(buf->length)){
+    return enif_schedule_nif(env, "buffer_run", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             buffer_run, argc, argv);
+  }
+
+  unsigned int back = buf->front ^ 1;
+  // A unit taking more inputs than the buffer carries gets the last
+  // channel repeated, e.g. FreeVerb2 after a mono filter.
+  for(unsigned int c = 0; c < unit->num_inputs; c++){
+    in_array[c] = buffer_channel(buf, buf->front, sc_min(c, buf->channels - 1));
+  }
+  for(unsigned int c = 0; c < unit->num_outputs; c++){
+    out_array[c] = buffer_channel(buf, back, c);
+  }
+  (*unit->calc)(unit, out_array, in_array, args, buf->length);
+  buf->front = back;
+  buf->channels = unit->num_outputs;
+  return enif_make_atom(env, "ok");
+}
+
+// buffer_read(Ref), the current period as a binary or a list of binaries
+static ERL_NIF_TERM buffer_read(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Buffer * buf;
+  ERL_NIF_TERM out_term[SC_MAX_CHANNELS];
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_buffer_type,
+                         (void**) &buf)){
+    return sc_raise(env, "No valid reference");
+  }
+
+  for(unsigned int c = 0; c < buf->channels; c++){
+    float * out = (float *) enif_make_new_binary(env, buf->length * sizeof(float),
+                                                 &out_term[c]);
+    memcpy(out, buffer_channel(buf, buf->front, c), buf->length * sizeof(float));
+  }
+  if (buf->channels == 1){
+    return out_term[0];
+  } else {
+    return enif_make_list_from_array(env, out_term, buf->channels);
+  }
+}
+
+// buffer_ring(UnitHandle, Depth, BlockSamples), give the unit a ring of
+// Depth output blocks of BlockSamples samples. Once per unit.
+static ERL_NIF_TERM buffer_ring(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * unit;
+  unsigned int depth, samples;
+
+  if ((unit = sc_unit_from_handle(env, argv[0])) == NULL){
+    return sc_raise(env, "No valid unit handle");
+  }
+  if (!enif_get_uint(env, argv[1], &depth) || depth == 0 || depth > SC_RING_MAX ||
+      !enif_get_uint(env, argv[2], &samples) || samples == 0){
+    return enif_make_badarg(env);
+  }
+  if (unit->ring){
+    return sc_raise(env, "Unit already has a ring");
+  }
+
+  // Blocks rounded up to the vector alignment
+  size_t block_size = (samples * sizeof(float) + sizeof(sc_v4d) - 1) & ~(sizeof(sc_v4d) - 1);
+  SCRing * ring = enif_alloc(sizeof(SCRing) + depth * block_size + sizeof(sc_v4d));
+  ring->block_type = sc_block_type;
+  ring->depth = depth;
+  ring->block_size = block_size;
+  ring->blocks = sc_align(ring + 1);
+  atomic_init(&ring->free, (depth == SC_RING_MAX) ? ~0ULL : (1ULL << depth) - 1);
+  unit->ring = ring;
+  return enif_make_atom(env, "ok");
+}
+
+/* ---------------------------------------------------------- */
+static ErlNifFunc nif_funcs[] = {
+  {"buffer_ctor", 1, buffer_ctor},
+  {"buffer_write", 2, buffer_write},
+  {"buffer_run", 3, buffer_run},
+  {"buffer_read", 1, buffer_read},
+  {"buffer_ring", 3, buffer_ring}
+};
+
+static int open_buffer_resource_type(ErlNifEnv* env)
+{
+  const char* mod = "Elixir.SC.Buffer";
+  const char* resource_type = "sc_buffer";
+  int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
+  sc_buffer_type =
+    enif_open_resource_type(env, mod, resource_type,
+                            buffer_resource_dtor, flags, NULL);
+  sc_block_type =
+    enif_open_resource_type(env, mod, "sc_block",
+                            sc_block_dtor, flags, NULL);
+  return ((sc_buffer_type == NULL || sc_block_type == NULL) ? -1:0);
+}
+
+static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
+{
+  return open_buffer_resource_type(caller_env);
+}
+
+static int upgrade(ErlNifEnv* caller_env, void** priv_data, void** old_priv_data,
+		   ERL_NIF_TERM load_info)
+{
+  return open_buffer_resource_type(caller_env);
+}
+
+
+ERL_NIF_INIT(Elixir.SC.Buffer, nif_funcs, load, NULL, upgrade, NULL);
@@ -0,0 +1,209 @@
+#include <erl_nif.h>
+#include <math.h>
+#include <string.h>
+#include "sc_plug.h"
+
+/* Control buses. A bus is an array of floats shared by any number of
+   units. Values are written with relaxed atomic stores, a unit bound
+   to a bus index reads the value at the start of each calc call (see
+   sc_bus_args in sc_plug.h), so one set retunes every bound unit
+   without passing the value through their next calls.
+
+   Units are reached through their unit handles, so units of every
+   plugin library can be bound. Binding, rebinding and unbinding are
+   safe while the unit runs on another thread: the bus of a slot is
+   swapped atomically and a bus stays alive until the unit goes (see
+   sc_unit_release). bind_lock serializes binding calls on the units.
+*/
+
+static ErlNifResourceType* sc_bus_type;
+static ErlNifMutex* bind_lock;
+
+static ERL_NIF_TERM bus_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  unsigned int size;
+
+  if (!enif_get_uint(env, argv[0], &size) || size == 0){
+    return enif_make_badarg(env);
+  }
+
+  SCBus * bus = enif_alloc_resource(sc_bus_type, sizeof(SCBus) + size * sizeof(_Atomic float));
+  bus->magic = SC_BUS_MAGIC;
+  bus->size = size;
+  for(unsigned int i = 0; i < size; i++){
+    atomic_init(&bus->values[i], 0.f);
+  }
+  ERL_NIF_TERM term = enif_make_resource(env, bus);
+  enif_release_resource(bus);
+  return term;
+}
+
+// bus_set(Ref, Index, Value) or bus_set(Ref, Index, [Value]) setting
+// consecutive indices from Index on.
+static ERL_NIF_TERM bus_set(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCBus * bus;
+  unsigned int index;
+  double value;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_bus_type,
+                         (void**) &bus)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  if (!enif_get_uint(env, argv[1], &index) || index >= bus->size){
+    return enif_make_badarg(env);
+  }
+
+  if(enif_get_double(env, argv[2], &value)){
+    atomic_store_explicit(&bus->values[index], (float) value, memory_order_relaxed);
+    return enif_make_atom(env, "ok");
+  }
+
+  ERL_NIF_TERM list = argv[2], head, tail;
+  unsigned int len;
+  if(!enif_get_list_length(env, list, &len) || index + len > bus->size){
+    return enif_make_badarg(env);
+  }
+  while (enif_get_list_cell(env, list, &head, &tail)){
+    if(!enif_get_double(env, head, &value)){
+      return enif_make_badarg(env);
+    }
+    atomic_store_explicit(&bus->values[index++], (float) value, memory_order_relaxed);
+    list = tail;
+  }
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM bus_get(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCBus * bus;
+  unsigned int index;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_bus_type,
+                         (void**) &bus)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  if (!enif_get_uint(env, argv[1], &index) || index >= bus->size){
+    return enif_make_badarg(env);
+  }
+  return enif_make_double(env, atomic_load_explicit(&bus->values[index],
+                                                    memory_order_relaxed));
+}
+
+// bus_bind(Ref, Index, UnitHandle, Slot)
+static ERL_NIF_TERM bus_bind(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCBus * bus;
+  SCUnit * sc;
+  unsigned int index, slot;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_bus_type,
+                         (void**) &bus)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  if (!enif_get_uint(env, argv[1], &index) || index >= bus->size){
+    return enif_make_badarg(env);
+  }
+  if ((sc = sc_unit_from_handle(env, argv[2])) == NULL){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid unit handle",
+                                                 ERL_NIF_LATIN1));
+  }
+  if (!enif_get_uint(env, argv[3], &slot) || slot >= sc->num_args){
+    return enif_make_badarg(env);
+  }
+
+  enif_mutex_lock(bind_lock);
+  SCBind * binds = atomic_load_explicit(&sc->binds, memory_order_relaxed);
+  if(binds == NULL) {
+    binds = enif_alloc(sc->num_args * sizeof(SCBind));
+    for(unsigned int i = 0; i < sc->num_args; i++){
+      atomic_init(&binds[i].bus, NULL);
+      atomic_init(&binds[i].index, 0);
+    }
+    atomic_store_explicit(&sc->binds, binds, memory_order_release);
+  }
+  unsigned int h = 0;
+  while(h < sc->num_held && sc->held[h] != bus) h++;
+  if(h == sc->num_held) {
+    sc->held = enif_realloc(sc->held, (sc->num_held + 1) * sizeof(SCBus *));
+    sc->held[sc->num_held++] = bus;
+    enif_keep_resource(bus);
+  }
+  atomic_store_explicit(&binds[slot].index, index, memory_order_relaxed);
+  // Index before bus, a unit may be running on another thread
+  atomic_store_explicit(&binds[slot].bus, bus, memory_order_release);
+  enif_mutex_unlock(bind_lock);
+  return enif_make_atom(env, "ok");
+}
+
+// bus_unbind(UnitHandle, Slot)
+static ERL_NIF_TERM bus_unbind(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * sc;
+  unsigned int slot;
+
+  if ((sc = sc_unit_from_handle(env, argv[0])) == NULL){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid unit handle",
+                                                 ERL_NIF_LATIN1));
+  }
+  if (!enif_get_uint(env, argv[1], &slot) || slot >= sc->num_args){
+    return enif_make_badarg(env);
+  }
+  // The bus is kept in held, a running unit may still be reading it
+  enif_mutex_lock(bind_lock);
+  SCBind * binds = atomic_load_explicit(&sc->binds, memory_order_relaxed);
+  if(binds) atomic_store_explicit(&binds[slot].bus, NULL, memory_order_release);
+  enif_mutex_unlock(bind_lock);
+  return enif_make_atom(env, "ok");
+}
+
+/* ---------------------------------------------------------- */
+static ErlNifFunc nif_funcs[] = {
+  {"bus_ctor", 1, bus_ctor},
+  {"bus_set", 3, bus_set},
+  {"bus_get", 2, bus_get},
+  {"bus_bind", 4, bus_bind},
+  {"bus_unbind", 2, bus_unbind}
+};
+
+static int open_bus_resource_type(ErlNifEnv* env)
+{
+  const char* mod = "Elixir.SC.ControlBus";
+  const char* resource_type = "sc_control_bus";
+  int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
+  sc_bus_type =
+    enif_open_resource_type(env, mod, resource_type,
+                            NULL, flags, NULL);
+  if(bind_lock == NULL) bind_lock = enif_mutex_create("sc_bus_bind_lock");
+  return ((sc_bus_type == NULL || bind_lock == NULL) ? -1:0);
+}
+
+static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
+{
+  return open_bus_resource_type(caller_env);
+}
+
+static int upgrade(ErlNifEnv* caller_env, void** priv_data, void** old_priv_data,
+		   ERL_NIF_TERM load_info)
+{
+  return open_bus_resource_type(caller_env);
+}
+
+
+ERL_NIF_INIT(Elixir.SC.ControlBus, nif_funcs, load, NULL, upgrade, NULL);
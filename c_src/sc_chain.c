@@ -0,0 +1,232 @@
+#include <erl_nif.h>
+#include <math.h>
+#include <string.h>
+#include "sc_plug.h"
+
+/* A chain runs a list of plugin units back to back within one NIF call.
+   Units are referenced through their unit handles (see sc_plug.h), so
+   units from sc_filter, sc_reverb and sc_analog_echo can be mixed.
+   Intermediate stages write to two ping-pong sets of scratch buffers,
+   only the last stage writes to the binaries returned to Erlang.
+   A chain has a unit head of its own so it can in turn be run as a
+   unit, e.g. as a voice of an SC.Group.
+*/
+
+static ErlNifResourceType* sc_chain_type;
+
+typedef struct {
+  SCUnit * unit;
+  double args[SC_MAX_ARGS];
+} ChainStage;
+
+typedef struct {
+  SCUnit sc;
+  ErlNifEnv * env;      // Holds the unit handles, keeps the units alive
+  unsigned int num_stages;
+  ChainStage * stages;
+  int bufsize;          // Size of each scratch buffer in samples
+  float * scratch;      // 2 * SC_MAX_CHANNELS scratch buffers
+} Chain;
+
+// ErlNifResourceDtor
+static void chain_resource_dtor(ErlNifEnv* env, void * obj){
+  Chain * chain = (Chain *) obj;
+  if(chain->env) enif_free_env(chain->env);
+  if(chain->stages) enif_free(chain->stages);
+  if(chain->scratch) enif_free(chain->scratch);
+  sc_unit_release(&chain->sc);
+}
+
+static void chain_run(Chain * chain, float ** out, float ** in, unsigned int channels,
+                      int inNumSamples)
+{
+  float * in_array[SC_MAX_CHANNELS];
+  float * out_array[SC_MAX_CHANNELS];
+
+  if(inNumSamples > chain->bufsize) {
+    chain->bufsize = inNumSamples;
+    chain->scratch = enif_realloc(chain->scratch,
+                                  2 * SC_MAX_CHANNELS * chain->bufsize * sizeof(float));
+  }
+
+  for(unsigned int c = 0; c < channels; c++){
+    in_array[c] = in[c];
+  }
+  for(unsigned int s = 0; s < chain->num_stages; s++){
+    SCUnit * unit = chain->stages[s].unit;
+    // A unit taking more inputs than the chain carries gets the last
+    // channel repeated, e.g. FreeVerb2 after a mono filter.
+    for(unsigned int c = channels; c < unit->num_inputs; c++){
+      in_array[c] = in_array[channels - 1];
+    }
+    if(s == chain->num_stages - 1) {
+      for(unsigned int c = 0; c < unit->num_outputs; c++){
+        out_array[c] = out[c];
+      }
+    } else {
+      float * set = chain->scratch + (s & 1) * SC_MAX_CHANNELS * chain->bufsize;
+      for(unsigned int c = 0; c < unit->num_outputs; c++){
+        out_array[c] = set + c * chain->bufsize;
+      }
+    }
+    (*unit->calc)(unit, out_array, in_array, chain->stages[s].args, inNumSamples);
+    channels = unit->num_outputs;
+    for(unsigned int c = 0; c < channels; c++){
+      in_array[c] = out_array[c];
+    }
+  }
+}
+
+static void chain_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  chain_run((Chain *) sc, out, in, sc->num_inputs, inNumSamples);
+}
+
+static ERL_NIF_TERM chain_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  unsigned int len;
+  ERL_NIF_TERM list, head, tail;
+  const ERL_NIF_TERM * stage;
+  int arity;
+
+  if(!enif_get_list_length(env, argv[0], &len) || len == 0){
+    return enif_make_badarg(env);
+  }
+
+  Chain * chain = enif_alloc_resource(sc_chain_type, sizeof(Chain));
+  // Safe for the dtor on any early release
+  sc_unit_init(&chain->sc, 0, 0, 0, NULL);
+  chain->env = enif_alloc_env();
+  chain->num_stages = len;
+  chain->stages = enif_alloc(len * sizeof(ChainStage));
+  chain->bufsize = 0;
+  chain->scratch = NULL;
+
+  list = argv[0];
+  for(unsigned int i = 0; enif_get_list_cell(env, list, &head, &tail); i++){
+    ChainStage * cs = &chain->stages[i];
+    if(!(enif_get_tuple(env, head, &arity, &stage) && arity == 2 &&
+         (cs->unit = sc_unit_from_handle(env, stage[0])) != NULL &&
+         cs->unit->num_inputs <= SC_MAX_CHANNELS &&
+         cs->unit->num_outputs <= SC_MAX_CHANNELS &&
+         sc_get_args(env, stage[1], cs->args))){
+      enif_release_resource(chain);
+      return enif_make_badarg(env);
+    }
+    enif_make_copy(chain->env, stage[0]);
+    list = tail;
+  }
+  chain->sc.num_inputs = chain->stages[0].unit->num_inputs;
+  chain->sc.num_outputs = chain->stages[len - 1].unit->num_outputs;
+  chain->sc.calc = &chain_calc;
+
+  ERL_NIF_TERM term = enif_make_resource(env, chain);
+  enif_release_resource(chain);
+  return term;
+}
+
+static ERL_NIF_TERM chain_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Chain * chain;
+  ERL_NIF_TERM out_term[SC_MAX_CHANNELS];
+  float * in_array[SC_MAX_CHANNELS];
+  float * out_array[SC_MAX_CHANNELS];
+  unsigned int channels;
+  int inNumSamples = 0;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_chain_type,
+                         (void**) &chain)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  if(!sc_get_channels(env, argv[1], in_array, SC_MAX_CHANNELS, &channels, &inNumSamples)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Input stream not a binary nor a list of binaries of one length",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  if(sc_dirty_needed((size_t) inNumSamples * chain->num_stages)){
+    return enif_schedule_nif(env, "chain_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             chain_next, argc, argv);
+  }
+
+  SCUnit * last = chain->stages[chain->num_stages - 1].unit;
+  for(unsigned int c = 0; c < last->num_outputs; c++){
+    out_array[c] = sc_make_output(env, &chain->sc, inNumSamples * sizeof(float),
+                                  &out_term[c]);
+  }
+  chain_run(chain, out_array, in_array, channels, inNumSamples);
+  channels = last->num_outputs;
+
+  if (channels == 1){
+    return out_term[0];
+  } else {
+    return enif_make_list_from_array(env, out_term, channels);
+  }
+}
+
+static ERL_NIF_TERM chain_set_args(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Chain * chain;
+  unsigned int index;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_chain_type,
+                         (void**) &chain)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_uint(env, argv[1], &index) || index >= chain->num_stages){
+    return enif_make_badarg(env);
+  }
+  if (!sc_get_args(env, argv[2], chain->stages[index].args)){
+    return enif_make_badarg(env);
+  }
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM unit(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Chain * chain;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_chain_type,
+                         (void**) &chain)){
+    return enif_make_badarg(env);
+  }
+  return sc_unit_handle(env, &chain->sc);
+}
+
+/* ---------------------------------------------------------- */
+static ErlNifFunc nif_funcs[] = {
+  {"chain_ctor", 1, chain_ctor},
+  {"chain_next", 2, chain_next},
+  {"chain_set_args", 3, chain_set_args},
+  {"chain_unit", 1, unit}
+};
+
+static int open_chain_resource_type(ErlNifEnv* env)
+{
+  const char* resource_type = "sc_chain";
+  int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
+  sc_chain_type =
+    sc_open_unit_type(env, resource_type, chain_resource_dtor, flags);
+  return ((sc_chain_type == NULL) ? -1:0);
+}
+
+static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
+{
+  return open_chain_resource_type(caller_env);
+}
+
+static int upgrade(ErlNifEnv* caller_env, void** priv_data, void** old_priv_data,
+		   ERL_NIF_TERM load_info)
+{
+  return open_chain_resource_type(caller_env);
+}
+
+
+ERL_NIF_INIT(Elixir.SC.Chain, nif_funcs, load, NULL, upgrade, NULL);
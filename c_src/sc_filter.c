@@ -26,6 +26,26 @@
 #include "sc_plug.h"
 
 static ErlNifResourceType* sc_filter_type;
+// Banks have no unit head, keep them apart from the units
+static ErlNifResourceType* sc_filter_bank_type;
+
+// Live instances and bytes per plugin type, see sc_mem_charge
+enum { MEM_RAMP, MEM_LAG, MEM_LAGUD, MEM_LPF, MEM_HPF, MEM_BPF, MEM_BRF,
+       MEM_LHPF_BANK, MEM_LAG_BANK, FILTER_MEM_TYPES };
+static SCMemType filter_mem[FILTER_MEM_TYPES] = {
+  {"ramp"}, {"lag"}, {"lagud"}, {"lpf"}, {"hpf"}, {"bpf"}, {"brf"},
+  {"lhpf_bank"}, {"lag_bank"}
+};
+
+// ErlNifResourceDtor
+static void filter_resource_dtor(ErlNifEnv* env, void * obj){
+  sc_unit_release((SCUnit *) obj);
+}
+
+// ErlNifResourceDtor of the banks, the tag is their first member
+static void filter_bank_dtor(ErlNifEnv* env, void * obj){
+  sc_mem_release((SCMemTag *) obj);
+}
 
 // NaNs are not equal to any floating point number
 static const float uninitializedControl = NAN;
@@ -39,14 +59,117 @@ static double radians_per_sample(double rate) {
   return 2.0 * PI / rate;
 }
 
+/*  Control rate batches.
+
+    The scalar paths of the *_next NIFs run one control rate step per
+    call. The *_next_kr NIFs run the same steps over N values in one
+    call, a binary of floats giving a binary of floats and a list of
+    floats a list of floats. Parameters are read once per batch.
+*/
+typedef double (*KrFun)(SCUnit *, double in, double * args);
+
+static ERL_NIF_TERM kr_batch(ErlNifEnv* env, SCUnit * sc, KrFun step, double * args,
+                             const char * name,
+                             ERL_NIF_TERM (*fp)(ErlNifEnv*, int, const ERL_NIF_TERM []),
+                             int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary in_bin;
+  unsigned int len;
+
+  if(enif_inspect_binary(env, argv[1], &in_bin)){
+    len = in_bin.size / sizeof(float);
+  }else if(!enif_get_list_length(env, argv[1], &len)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Not a binary nor a list of floats",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(sc_dirty_needed(len)){
+    return enif_schedule_nif(env, name, ERL_NIF_DIRTY_JOB_CPU_BOUND, fp, argc, argv);
+  }
+  sc_bus_args(sc, args);
+
+  if(enif_is_binary(env, argv[1])){
+    ERL_NIF_TERM out_term;
+    float * in = (float *) in_bin.data;
+    float * out = (float *) enif_make_new_binary(env, len * sizeof(float), &out_term);
+    for(unsigned int i = 0; i < len; i++){
+      out[i] = (float) (*step)(sc, in[i], args);
+    }
+    return out_term;
+  }
+
+  // Check all values before the first step, a bad list leaves the unit untouched
+  double * in = enif_alloc(len * (sizeof(double) + sizeof(ERL_NIF_TERM)));
+  ERL_NIF_TERM * out = (ERL_NIF_TERM *) (in + len);
+  ERL_NIF_TERM list = argv[1], head, tail;
+  for(unsigned int i = 0; enif_get_list_cell(env, list, &head, &tail); i++){
+    if(!enif_get_double(env, head, &in[i])){
+      enif_free(in);
+      return enif_raise_exception(env,
+                                  enif_make_string(env,
+                                                   "Not a binary nor a list of floats",
+                                                   ERL_NIF_LATIN1));
+    }
+    list = tail;
+  }
+  for(unsigned int i = 0; i < len; i++){
+    out[i] = enif_make_double(env, (*step)(sc, in[i], args));
+  }
+  ERL_NIF_TERM out_list = enif_make_list_from_array(env, out, len);
+  enif_free(in);
+  return out_list;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 
-typedef struct {
+typedef struct Ramp {
+  SCUnit sc;
   double m_level, m_slope;
   int m_counter, first;
   unsigned int rate, period_size;
 } Ramp;
 
+static void Ramp_next(Ramp* unit, float * out, float * in, double * args, int inNumSamples) {
+  double period = args[0]; // lagtime
+  if(unit->first) {
+    unit->m_level = *in;
+    unit->first = 0;
+  }
+  double slope = unit->m_slope;
+  double level = unit->m_level;
+  int counter = unit->m_counter;
+  int remain = inNumSamples;
+  while (remain) {
+    // A segment ending on the last sample takes its next target from
+    // the first sample of the next call
+    if (counter <= 0) {
+      counter = (int)(period * unit->rate);
+      counter = sc_max(1, counter);
+      slope = (*in - level) / counter;
+    }
+    int nsmps = sc_min(remain, counter);
+    for(int i = 0; i < nsmps; i++) {
+      *out++ = level;
+      level += slope;
+    }
+    in += nsmps;
+    counter -= nsmps;
+    remain -= nsmps;
+  }
+  unit->m_level = level;
+  unit->m_slope = slope;
+  unit->m_counter = counter;
+}
+
+static const char * const ramp_names[] = {"lagTime"};
+static const double ramp_defaults[] = {0.1};
+
+static void ramp_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  sc_bus_args(sc, args);
+  Ramp_next((Ramp *) sc, out[0], in[0], args, inNumSamples);
+}
+
 static ERL_NIF_TERM ramp_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   unsigned int rate, period_size;
@@ -59,16 +182,42 @@ static ERL_NIF_TERM ramp_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
   }
 
   Ramp * unit = enif_alloc_resource(sc_filter_type, sizeof(Ramp));
+  sc_unit_init(&unit->sc, 1, 1, 1, &ramp_calc);
+  sc_unit_params(&unit->sc, ramp_names, ramp_defaults);
   unit->rate = rate;
   unit->period_size = period_size;
   unit->m_counter = 1;
   unit->m_slope = 0.f;
   unit->first  = 1;
+  if (!sc_mem_charge(&unit->sc.mem, &filter_mem[MEM_RAMP], sizeof(Ramp))){
+    enif_release_resource(unit);
+    return sc_budget_exceeded(env);
+  }
   ERL_NIF_TERM term = enif_make_resource(env, unit);
   enif_release_resource(unit);
   return term;
 }
 
+// One control rate step, the unit runs at rate / period_size from the first step
+static double ramp_kr(SCUnit * sc, double in, double * args) {
+  Ramp * unit = (Ramp *) sc;
+  double period = args[0]; // lagtime
+  if(unit->first) {
+    unit->m_level = in;
+    unit->rate = unit->rate / unit->period_size;
+    unit->period_size = 1;
+    unit->first = 0;
+  }
+  double out = unit->m_level;
+  unit->m_level += unit->m_slope;
+  if (--unit->m_counter <= 0) {
+    int counter = (int)(period * unit->rate);
+    unit->m_counter = counter = sc_max(1, counter);
+    unit->m_slope = (in - unit->m_level) / counter;
+  }
+  return out;
+}
+
 static ERL_NIF_TERM ramp_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   Ramp * unit;
@@ -87,65 +236,88 @@ static ERL_NIF_TERM ramp_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
   }
 
   if(enif_inspect_binary(env, argv[1], &in_bin)){
+    if(sc_dirty_needed(in_bin.size / sizeof(float))){
+      return enif_schedule_nif(env, "ramp_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                               ramp_next, argc, argv);
+    }
     ERL_NIF_TERM out_term;
     int no_of_frames = in_bin.size / sizeof(float);
     float * in = (float * ) in_bin.data;
-    float * out = (float *) enif_make_new_binary(env, in_bin.size, &out_term);
-    if(unit->first) {
-      unit->m_level = *in;
-      unit->first = 0;
-    }
-    double slope = unit->m_slope;
-    double level = unit->m_level;
-    int counter = unit->m_counter;
-    int remain = no_of_frames;
-    while (remain) {
-      int nsmps = sc_min(remain, counter);
-      for(int i = 0; i < nsmps; i++) {
-        *out++ = level;
-        level += slope;
-      }
-      in += nsmps;
-      counter -= nsmps;
-      remain -= nsmps;
-      if (counter <= 0) {
-        counter = (int)(period * unit->rate);
-        counter = sc_max(1, counter);
-        slope = (*in - level) / counter;
-      }
-    }
-    unit->m_level = level;
-    unit->m_slope = slope;
-    unit->m_counter = counter;
+    float * out = sc_make_output(env, &unit->sc, in_bin.size, &out_term);
+    ramp_calc(&unit->sc, &out, &in, &period, no_of_frames);
     return out_term;
   }else if(enif_get_double(env, argv[1], &in_scalar)){
-    if(unit->first) {
-      unit->m_level = in_scalar;
-      unit->rate = unit->rate / unit->period_size;
-      unit->period_size = 1;
-      unit->first = 0;
-    }
-    double out = unit->m_level;
-    if (--unit->m_counter <= 0) {
-      int counter = (int)(period * unit->rate);
-      unit->m_counter = counter = sc_max(1, counter);
-      unit->m_slope = (in_scalar - unit->m_level) / counter;
-    }
-    return(enif_make_double(env, out));
+    sc_bus_args(&unit->sc, &period);
+    return(enif_make_double(env, ramp_kr(&unit->sc, in_scalar, &period)));
   }else{
     return enif_make_badarg(env);
   }
 }
 
+static ERL_NIF_TERM ramp_next_kr(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Ramp * unit;
+  double period; // lagtime
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &unit)){
+    return enif_make_badarg(env);
+  }
+  if(!enif_get_double(env, argv[2], &period)){
+    return enif_make_badarg(env);
+  }
+  return kr_batch(env, &unit->sc, &ramp_kr, &period, "ramp_next_kr", ramp_next_kr, argc, argv);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 
-typedef struct {
+typedef struct Lag {
+  SCUnit sc;
   float m_lag;
   double m_b1, m_y1;
   uint rate, period_size;
   int first;
 } Lag;
 
+static void Lag_next(Lag* unit, float * out, float * in, double * args, int inNumSamples) {
+  double lag = args[0];
+  if(unit->first){
+    unit->m_y1 = *in;
+    unit->first = 0;
+  }
+
+  double y1 = unit->m_y1;
+  double b1 = unit->m_b1;
+  double y0;
+
+  if (lag == unit->m_lag) {
+    for(int i = 0; i < inNumSamples; i++) {
+      y0 = *in++;
+      *out++ = y1 = y0 + b1 * (y1 - y0);
+    }
+  } else {
+    unit->m_b1 = lag == 0.f ? 0.f : exp(log001 / (lag * unit->rate));
+    double b1_slope = (unit->m_b1 - b1) / unit->period_size;
+    unit->m_lag = lag;
+    for(int i = 0; i < inNumSamples; i++){
+      b1 += b1_slope;
+      y0 = *in++;
+      *out++ = y1 = y0 + b1 * (y1 - y0);
+    }
+  }
+  unit->m_y1 = zapgremlins(y1);
+}
+
+static void lag_block(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  Lag_next((Lag *) sc, out[0], in[0], args, inNumSamples);
+}
+
+static void lag_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  sc_bus_args(sc, args);
+  sc_subblocks(sc, &lag_block, out, in, args, inNumSamples, ((Lag *) sc)->period_size);
+}
+
 static ERL_NIF_TERM lag_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   unsigned int rate, period_size;
@@ -156,27 +328,58 @@ static ERL_NIF_TERM lag_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]
     return enif_make_badarg(env);
   }
   Lag * unit = enif_alloc_resource(sc_filter_type, sizeof(Lag));
+  sc_unit_init(&unit->sc, 1, 1, 1, &lag_calc);
+  sc_unit_params(&unit->sc, ramp_names, ramp_defaults);
   unit->m_lag = uninitializedControl;
   unit->m_b1 = 0.f;
   unit->rate = rate;
   unit->period_size = period_size;
   unit->first = 1;
   unit->m_y1 = uninitializedControl;
+  if (!sc_mem_charge(&unit->sc.mem, &filter_mem[MEM_LAG], sizeof(Lag))){
+    enif_release_resource(unit);
+    return sc_budget_exceeded(env);
+  }
   ERL_NIF_TERM term = enif_make_resource(env, unit);
   enif_release_resource(unit);
   return term;
 }
 
+// One control rate step, the unit runs at rate / period_size from the first step
+static double lag_kr(SCUnit * sc, double in, double * args) {
+  Lag * unit = (Lag *) sc;
+  double lag = args[0];
+  if(unit->first){
+    unit->m_y1 = in;
+    unit->rate = unit->rate / unit->period_size;
+    unit->period_size = 1;
+    unit->first = 0;
+  }
+
+  double y1 = unit->m_y1;
+  double b1 = unit->m_b1;
+  double y0, out;
+
+  if (lag == unit->m_lag) {
+    y0 = in;
+    out = y1 = y0 + b1 * (y1 - y0);
+  } else {
+    unit->m_b1 = b1 = lag == 0.f ? 0.f : exp(log001 / (lag * unit->rate));
+    unit->m_lag = lag;
+    y0 = in;
+    out = y1 = y0 + b1 * (y1 - y0);
+  }
+  unit->m_y1 = zapgremlins(y1);
+  return out;
+}
+
 static ERL_NIF_TERM lag_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   Lag * unit;
   ErlNifBinary in_bin;
-  float * out, * in;
-  int is_bin;
-  double in_scalar, out_scalar;
+  double in_scalar;
   ERL_NIF_TERM out_term;
   double lag;
-  int inNumSamples;
 
   if (!enif_get_resource(env, argv[0],
                          sc_filter_type,
@@ -185,70 +388,51 @@ static ERL_NIF_TERM lag_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]
                                 enif_make_string(env, "No valid reference", ERL_NIF_LATIN1));
   }
 
-  if(enif_inspect_binary(env, argv[1], &in_bin)){
-    inNumSamples = in_bin.size / sizeof(float);
-    in = (float * ) in_bin.data;
-    out = (float *) enif_make_new_binary(env, in_bin.size, &out_term);
-    is_bin = 1;
-  }else if(enif_get_double(env, argv[1], &in_scalar)){
-    is_bin = 0;
-  }else{
-    return enif_raise_exception(env,
-                                enif_make_string(env, "Not a binary nor a float", ERL_NIF_LATIN1));
-  }
-
   if(!enif_get_double(env, argv[2], &lag)){
     return enif_raise_exception(env,
                                 enif_make_string(env, "Lagtime not a float", ERL_NIF_LATIN1));
   }
 
-  if(unit->first){
-    unit->m_y1 = is_bin?(*in):in_scalar;
-    if(!is_bin) {
-      unit->rate = unit->rate / unit->period_size;
-      unit->period_size = 1;
+  if(enif_inspect_binary(env, argv[1], &in_bin)){
+    if(sc_dirty_needed(in_bin.size / sizeof(float))){
+      return enif_schedule_nif(env, "lag_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                               lag_next, argc, argv);
     }
-    unit->first = 0;
+    int inNumSamples = in_bin.size / sizeof(float);
+    float * in = (float * ) in_bin.data;
+    float * out = sc_make_output(env, &unit->sc, in_bin.size, &out_term);
+    lag_calc(&unit->sc, &out, &in, &lag, inNumSamples);
+    return out_term;
+  }else if(!enif_get_double(env, argv[1], &in_scalar)){
+    return enif_raise_exception(env,
+                                enif_make_string(env, "Not a binary nor a float", ERL_NIF_LATIN1));
   }
 
-  double y1 = unit->m_y1;
-  double b1 = unit->m_b1;
-  double y0;
+  sc_bus_args(&unit->sc, &lag);
+  return enif_make_double(env, lag_kr(&unit->sc, in_scalar, &lag));
+}
 
-  if(is_bin){
-    if (lag == unit->m_lag) {
-      for(int i = 0; i < inNumSamples; i++) {
-        y0 = *in++;
-        *out++ = y1 = y0 + b1 * (y1 - y0);
-      }
-    } else {
-      unit->m_b1 = lag == 0.f ? 0.f : exp(log001 / (lag * unit->rate));
-      double b1_slope = (unit->m_b1 - b1) / unit->period_size;
-      unit->m_lag = lag;
-      for(int i = 0; i < inNumSamples; i++){
-        b1 += b1_slope;
-        y0 = *in++;
-        *out++ = y1 = y0 + b1 * (y1 - y0);
-      }
-    }
-  }else{
-    if (lag == unit->m_lag) {
-      y0 = in_scalar;
-      out_scalar = y1 = y0 + b1 * (y1 - y0);
-    } else {
-      unit->m_b1 = b1 = lag == 0.f ? 0.f : exp(log001 / (lag * unit->rate));
-      unit->m_lag = lag;
-      y0 = in_scalar;
-      out_scalar = y1 = y0 + b1 * (y1 - y0);
-    }
-    out_term = enif_make_double(env, out_scalar);
+static ERL_NIF_TERM lag_next_kr(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Lag * unit;
+  double lag;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &unit)){
+    return enif_raise_exception(env,
+                                enif_make_string(env, "No valid reference", ERL_NIF_LATIN1));
   }
-  unit->m_y1 = zapgremlins(y1);
-  return out_term;
+  if(!enif_get_double(env, argv[2], &lag)){
+    return enif_raise_exception(env,
+                                enif_make_string(env, "Lagtime not a float", ERL_NIF_LATIN1));
+  }
+  return kr_batch(env, &unit->sc, &lag_kr, &lag, "lag_next_kr", lag_next_kr, argc, argv);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////
 typedef struct LagUD {
+  SCUnit sc;
   double m_lagu, m_lagd;
   double m_b1u, m_b1d, m_y1;
   double rate, period_size;
@@ -292,6 +476,24 @@ static void LagUD_next(LagUD* unit, float * out, float * in, double * args, int
     unit->m_y1 = zapgremlins(y1);
 }
 
+static void lagud_block(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  LagUD * unit = (LagUD *) sc;
+  (*unit->next)(unit, out[0], in[0], args, inNumSamples);
+}
+
+static const char * const lagud_names[] = {"lagTimeU", "lagTimeD"};
+static const double lagud_defaults[] = {0.1, 0.1};
+
+static void lagud_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  LagUD * unit = (LagUD *) sc;
+  sc_bus_args(sc, args);
+  if(unit->first) {
+    (*unit->next)(unit, out[0], in[0], args, 1);
+    unit->first = 0;
+  }
+  sc_subblocks(sc, &lagud_block, out, in, args, inNumSamples, unit->period_size);
+}
+
 static ERL_NIF_TERM lagud_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   unsigned int rate, period_size;
@@ -302,6 +504,8 @@ static ERL_NIF_TERM lagud_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv
     return enif_make_badarg(env);
   }
   LagUD * unit = enif_alloc_resource(sc_filter_type, sizeof(LagUD));
+  sc_unit_init(&unit->sc, 1, 1, 2, &lagud_calc);
+  sc_unit_params(&unit->sc, lagud_names, lagud_defaults);
   unit->m_lagu = uninitializedControl;
   unit->m_lagd = uninitializedControl;
   unit->m_b1u = 0.;
@@ -311,10 +515,29 @@ static ERL_NIF_TERM lagud_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv
   unit->first = 1;
   unit->m_y1 = uninitializedControl;
   unit->next = &LagUD_next;
+  if (!sc_mem_charge(&unit->sc.mem, &filter_mem[MEM_LAGUD], sizeof(LagUD))){
+    enif_release_resource(unit);
+    return sc_budget_exceeded(env);
+  }
   ERL_NIF_TERM term = enif_make_resource(env, unit);
   enif_release_resource(unit);
   return term;
 }
+// One control rate step, the unit runs at rate / period_size from the first step
+static double lagud_kr(SCUnit * sc, double in_scalar, double * args) {
+  LagUD * unit = (LagUD *) sc;
+  float in[1], out[1];
+  in[0] = (float) in_scalar;
+  if(unit->first) {
+    unit->rate = unit->rate/unit->period_size;
+    unit->period_size = 1;
+    (*unit->next)(unit, out, in, args, 1);
+    unit->first = 0;
+  }
+  (*unit->next)(unit, out, in, args, 1);
+  return (double) out[0];
+}
+
 static ERL_NIF_TERM lagud_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   LagUD * unit;
@@ -348,27 +571,19 @@ static ERL_NIF_TERM lagud_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv
   }
 
   if(enif_inspect_binary(env, argv[1], &in_bin)){
+    if(sc_dirty_needed(in_bin.size / sizeof(float))){
+      return enif_schedule_nif(env, "lagud_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                               lagud_next, argc, argv);
+    }
     ERL_NIF_TERM out_term;
     int inNumSamples = in_bin.size / sizeof(float);
     float * in = (float *) in_bin.data;
-    float * out = (float *) enif_make_new_binary(env, in_bin.size, &out_term);
-    if(unit->first) {
-      (*unit->next)(unit, out, in, args, 1);
-      unit->first = 0;
-    }
-    (*unit->next)(unit, out, in, args, inNumSamples);
+    float * out = sc_make_output(env, &unit->sc, in_bin.size, &out_term);
+    lagud_calc(&unit->sc, &out, &in, args, inNumSamples);
     return out_term;
   }else if(enif_get_double(env, argv[1], &in_scalar)){
-    float in[1], out[1];
-    in[0] = (float) in_scalar;
-    if(unit->first) {
-      unit->rate = unit->rate/unit->period_size;
-      unit->period_size = 1;
-      (*unit->next)(unit, out, in, args, 1);
-      unit->first = 0;
-    }
-    (*unit->next)(unit, out, in, args, 1);
-    return(enif_make_double(env, (double) out[0]));
+    sc_bus_args(&unit->sc, args);
+    return(enif_make_double(env, lagud_kr(&unit->sc, in_scalar, args)));
   }else{
     return enif_raise_exception(env,
                                 enif_make_string(env,
@@ -377,8 +592,37 @@ static ERL_NIF_TERM lagud_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv
   }
 }
 
+static ERL_NIF_TERM lagud_next_kr(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  LagUD * unit;
+  double args[2];
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &unit)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(!enif_get_double(env, argv[2], &args[0])){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Lag UP not a float",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(!enif_get_double(env, argv[3], &args[1])){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Lag DOWN not a float",
+                                                 ERL_NIF_LATIN1));
+  }
+  return kr_batch(env, &unit->sc, &lagud_kr, args, "lagud_next_kr", lagud_next_kr, argc, argv);
+}
+
 /* ------------------------------------------------------------ */
 typedef struct LHPF {
+  SCUnit sc;
   double m_freq, m_bw;
   double m_y1, m_y2, m_a0, m_a1, m_b1, m_b2;
   double rate, period_size;
@@ -862,6 +1106,24 @@ static void BRF_next_1(LHPF* unit, double * out, double in, double * args) {
   unit->m_y2 = zapgremlins(y2);
 }
 
+static void lhpf_block(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  LHPF * unit = (LHPF *) sc;
+  (*unit->next)(unit, out[0], in[0], args, inNumSamples);
+}
+
+static const char * const lhpf_names[] = {"frequency", "bwr"};
+static const double lhpf_defaults[] = {440.0, 1.0};
+
+static void lhpf_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  LHPF * unit = (LHPF *) sc;
+  sc_bus_args(sc, args);
+  if(unit->first) {
+    (*unit->next)(unit, out[0], in[0], args, inNumSamples);
+    unit->first = 0;
+  }
+  sc_subblocks(sc, &lhpf_block, out, in, args, inNumSamples, unit->period_size);
+}
+
 /* ---------------------------------------------------------- */
 
 static ERL_NIF_TERM lhpf_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
@@ -890,6 +1152,7 @@ static ERL_NIF_TERM lhpf_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
   unit->m_y2 = 0.;
   unit->m_freq = uninitializedControl;
   unit->m_bw = uninitializedControl;
+  sc_unit_init(&unit->sc, 1, 1, 1, &lhpf_calc);
   if (strcmp(type, "lpf") == 0) {
     unit->next = &LPF_next;
     unit->next_1 = &LPF_next_1;
@@ -897,25 +1160,53 @@ static ERL_NIF_TERM lhpf_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
     unit->next = &HPF_next;
     unit->next_1 = &HPF_next_1;
   } else if (strcmp(type, "bpf") == 0) {
+    unit->sc.num_args = 2;
     unit->next = &BPF_next;
     unit->next_1 = &BPF_next_1;
   } else if (strcmp(type, "brf") == 0) {
+    unit->sc.num_args = 2;
     unit->next = &BRF_next;
     unit->next_1 = &BRF_next_1;
   } else {
+    enif_release_resource(unit);
     return enif_make_badarg(env);
   }
+  sc_unit_params(&unit->sc, lhpf_names, lhpf_defaults);
+  if (!sc_mem_charge(&unit->sc.mem, sc_mem_find(filter_mem, FILTER_MEM_TYPES, type), sizeof(LHPF))){
+    enif_release_resource(unit);
+    return sc_budget_exceeded(env);
+  }
   ERL_NIF_TERM term = enif_make_resource(env, unit);
   enif_release_resource(unit);
   return term;
 }
 
+// One control rate step, the unit runs at rate / period_size from the first step
+static double lhpf_kr(SCUnit * sc, double in, double * args) {
+  LHPF * unit = (LHPF *) sc;
+  double out;
+  if(unit->first) {
+    (*unit->next_1)(unit, &out, in, args);
+    unit->rate = unit->rate / unit->period_size;
+    unit->period_size = 1;
+    unit->first = 0;
+  }
+  (*unit->next_1)(unit, &out, in, args);
+  return out;
+}
+
+// Audio rate freq and bw, defined with the banks below
+static void LHPF_next_ar(LHPF * unit, float * out, const float * in,
+                         const float * freq, double freq_k,
+                         const float * bw, double bw_k, int inNumSamples);
+
 static ERL_NIF_TERM lhpf_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   LHPF * unit;
-  ErlNifBinary in_bin;
+  ErlNifBinary in_bin, freq_bin, bw_bin;
+  const float * freq_ar = NULL, * bw_ar = NULL;
   double in_scalar;
-  double args[4];
+  double args[4] = {0., 1., 0., 0.};
 
   if (!enif_get_resource(env, argv[0],
                          sc_filter_type,
@@ -926,7 +1217,11 @@ static ERL_NIF_TERM lhpf_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
                                                  ERL_NIF_LATIN1));
   }
 
-  if(!enif_get_double(env, argv[2], &args[0])){
+  // Frequency and bandwidth are a float or, at audio rate, a binary
+  // of floats as long as the input
+  if(enif_inspect_binary(env, argv[2], &freq_bin)){
+    freq_ar = (const float *) freq_bin.data;
+  }else if(!enif_get_double(env, argv[2], &args[0])){
     return enif_raise_exception(env,
                                 enif_make_string(env,
                                                  "Frequency not a float",
@@ -934,7 +1229,9 @@ static ERL_NIF_TERM lhpf_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
   }
 
   if(argc > 3) {
-    if(!enif_get_double(env, argv[3], &args[1])){
+    if(enif_inspect_binary(env, argv[3], &bw_bin)){
+      bw_ar = (const float *) bw_bin.data;
+    }else if(!enif_get_double(env, argv[3], &args[1])){
       return enif_raise_exception(env,
                                   enif_make_string(env,
                                                    "Bandwidth not a float",
@@ -943,26 +1240,35 @@ static ERL_NIF_TERM lhpf_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
   }
 
   if(enif_inspect_binary(env, argv[1], &in_bin)){
+    if((freq_ar && freq_bin.size != in_bin.size) || (bw_ar && bw_bin.size != in_bin.size)){
+      return enif_raise_exception(env,
+                                  enif_make_string(env,
+                                                   "Frequency or bandwidth binary not as long as the input",
+                                                   ERL_NIF_LATIN1));
+    }
+    if(sc_dirty_needed(in_bin.size / sizeof(float))){
+      return enif_schedule_nif(env, "lhpf_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                               lhpf_next, argc, argv);
+    }
     ERL_NIF_TERM out_term;
     int inNumSamples = in_bin.size / sizeof(float);
     float * in = (float *) in_bin.data;
-    float * out = (float *) enif_make_new_binary(env, in_bin.size, &out_term);
-    if(unit->first) {
-      (*unit->next)(unit, out, in, args, inNumSamples);
-      unit->first = 0;
+    float * out = sc_make_output(env, &unit->sc, in_bin.size, &out_term);
+    if(freq_ar || bw_ar) {
+      sc_bus_args(&unit->sc, args);
+      LHPF_next_ar(unit, out, in, freq_ar, args[0], bw_ar, args[1], inNumSamples);
+    } else {
+      lhpf_calc(&unit->sc, &out, &in, args, inNumSamples);
     }
-    (*unit->next)(unit, out, in, args, inNumSamples);
     return out_term;
+  }else if(freq_ar || bw_ar){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Audio rate frequency needs a binary input",
+                                                 ERL_NIF_LATIN1));
   }else if(enif_get_double(env, argv[1], &in_scalar)){
-    double out;
-    if(unit->first) {
-      (*unit->next_1)(unit, &out, in_scalar, args);
-      unit->rate = unit->rate / unit->period_size;
-      unit->period_size = 1;
-      unit->first = 0;
-    }
-    (*unit->next_1)(unit, &out, in_scalar, args);
-    return(enif_make_double(env, out));
+    sc_bus_args(&unit->sc, args);
+    return(enif_make_double(env, lhpf_kr(&unit->sc, in_scalar, args)));
   }else{
     return enif_raise_exception(env,
                                 enif_make_string(env,
@@ -971,6 +1277,702 @@ static ERL_NIF_TERM lhpf_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[
   }
 }
 
+static ERL_NIF_TERM lhpf_next_kr(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  LHPF * unit;
+  double args[2] = {0., 1.};
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &unit)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(!enif_get_double(env, argv[2], &args[0])){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Frequency not a float",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(argc > 3 && !enif_get_double(env, argv[3], &args[1])){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Bandwidth not a float",
+                                                 ERL_NIF_LATIN1));
+  }
+  return kr_batch(env, &unit->sc, &lhpf_kr, args, "lhpf_next_kr", lhpf_next_kr, argc, argv);
+}
+
+/* ------------------------------------------------------------ */
+/* Voice banks.
+
+   A bank holds N instances of the same filter with the state stored
+   structure of arrays, SC_LANES voices per lane group. The recurrences
+   are serial in time but independent between voices, so each lane
+   group is filtered in one vector register per state variable.
+
+   Input and output are one packed binary, the periods of all voices
+   concatenated (voice major). Per voice parameters are given as a list
+   with one float per voice, or a single float for all voices.
+   Numerically a voice gives the same result as its scalar unit.
+*/
+
+enum { BANK_LPF, BANK_HPF, BANK_BPF, BANK_BRF };
+
+typedef struct {
+  sc_v4d m_freq, m_bw;
+  sc_v4d m_y1, m_y2, m_a0, m_a1, m_b1, m_b2;
+} LHPFLanes;
+
+typedef struct LHPFBank {
+  SCMemTag mem;             // First, see filter_bank_dtor
+  unsigned int num_voices, num_groups;
+  int type;
+  double rate;
+  int period_size;
+  int first;
+  LHPFLanes * lanes;        // num_groups lane groups, in the resource
+  double * args;            // freq and bw per voice, padded to lane groups
+} LHPFBank;
+
+// Bank parameter, one float per voice or one for all. Lanes past the
+// last voice repeat its value to keep the pad lanes well conditioned.
+// With args NULL the term is only checked, callers check every
+// parameter before writing any so a bad one leaves the bank as it was.
+static int get_bank_args(ErlNifEnv* env, ERL_NIF_TERM term, unsigned int num_voices,
+                         unsigned int num_lanes, double * args)
+{
+  ERL_NIF_TERM head, tail;
+  unsigned int i = 0;
+  double value;
+  if(enif_get_double(env, term, &value)){
+    if(args) args[0] = value;
+    i = 1;
+  }else{
+    while(enif_get_list_cell(env, term, &head, &tail)){
+      if(i == num_voices || !enif_get_double(env, head, &value)) return 0;
+      if(args) args[i] = value;
+      term = tail;
+      i++;
+    }
+    if(i != num_voices) return 0;
+  }
+  if(args) for(; i < num_lanes; i++) args[i] = args[i - 1];
+  return 1;
+}
+
+static void lhpf_bank_coefs(int type, double rate, double freq, double bw,
+                            double * a0, double * a1, double * b1, double * b2) {
+  double pfreq, pbw, C, C2, sqrt2C, D;
+  switch(type) {
+  case BANK_LPF:
+    pfreq = freq * radians_per_sample(rate) * 0.5;
+    C = 1. / tan(pfreq);
+    C2 = C * C;
+    sqrt2C = C * sqrt2;
+    *a0 = 1. / (1. + sqrt2C + C2);
+    *b1 = -2. * (1. - C2) * *a0;
+    *b2 = -(1. - sqrt2C + C2) * *a0;
+    break;
+  case BANK_HPF:
+    pfreq = freq * radians_per_sample(rate) * 0.5;
+    C = tan(pfreq);
+    C2 = C * C;
+    sqrt2C = C * sqrt2;
+    *a0 = 1. / (1. + sqrt2C + C2);
+    *b1 = 2. * (1. - C2) * *a0;
+    *b2 = -(1. - sqrt2C + C2) * *a0;
+    break;
+  case BANK_BPF:
+    pfreq = freq * radians_per_sample(rate);
+    pbw = bw * pfreq * 0.5;
+    C = 1. / tan(pbw);
+    D = 2. * cos(pfreq);
+    *a0 = 1. / (1. + C);
+    *b1 = C * D * *a0;
+    *b2 = (1. - C) * *a0;
+    break;
+  case BANK_BRF:
+    pfreq = freq * radians_per_sample(rate);
+    pbw = bw * pfreq * 0.5;
+    C = tan(pbw);
+    D = 2. * cos(pfreq);
+    *a0 = 1. / (1. + C);
+    *a1 = -D * *a0;
+    *b2 = (1. - C) * *a0;
+    break;
+  }
+}
+
+// One sample of the biquad, type is a constant after inlining.
+// Vectors go by pointer, by value changes the ABI without -mavx.
+enum { C_A0, C_A1, C_B1, C_B2 };
+
+static inline void lhpf_bank_step(const int type, sc_v4d * out, const sc_v4d * x,
+                                  sc_v4d * y1, sc_v4d * y2, const sc_v4d * c) {
+  sc_v4d y0, ay;
+  switch(type) {
+  case BANK_LPF:
+    y0 = *x + c[C_B1] * *y1 + c[C_B2] * *y2;
+    *out = c[C_A0] * (y0 + 2. * *y1 + *y2);
+    break;
+  case BANK_HPF:
+    y0 = *x + c[C_B1] * *y1 + c[C_B2] * *y2;
+    *out = c[C_A0] * (y0 - 2. * *y1 + *y2);
+    break;
+  case BANK_BPF:
+    y0 = *x + c[C_B1] * *y1 + c[C_B2] * *y2;
+    *out = c[C_A0] * (y0 - *y2);
+    break;
+  default:
+    ay = c[C_A1] * *y1;
+    y0 = *x - ay - c[C_B2] * *y2;
+    *out = c[C_A0] * (y0 + *y2) + ay;
+    break;
+  }
+  *y2 = *y1;
+  *y1 = y0;
+}
+
+/*  Audio rate frequency and bandwidth for the LHPF units.
+
+    Coefficients follow freq and bw sample by sample instead of ramping
+    every third sample. A chunk is done in two passes, the first
+    computes the coefficients of every sample (held values are not
+    recomputed), the second runs the biquad over the chunk, so the
+    transcendental calls are not interleaved with the recursion.
+    freq or bw NULL takes the scalar value instead.
+*/
+#define LHPF_AR_CHUNK 64
+
+static inline void LHPF_run_ar(LHPF * unit, float * out, const float * in,
+                               const float * freq, double freq_k,
+                               const float * bw, double bw_k,
+                               int inNumSamples, const int type) {
+  double c[4][LHPF_AR_CHUNK];
+  double f_prev = unit->m_freq, b_prev = unit->m_bw;
+  double a0 = unit->m_a0, a1 = unit->m_a1, b1 = unit->m_b1, b2 = unit->m_b2;
+  double y0, y1 = unit->m_y1, y2 = unit->m_y2, ay;
+
+  for(int offset = 0; offset < inNumSamples; offset += LHPF_AR_CHUNK) {
+    int n = sc_min(LHPF_AR_CHUNK, inNumSamples - offset);
+    for(int i = 0; i < n; i++) {
+      double f = freq ? freq[offset + i] : freq_k;
+      double b = bw ? bw[offset + i] : bw_k;
+      if(f != f_prev || b != b_prev) {
+        lhpf_bank_coefs(type, unit->rate, f, b, &a0, &a1, &b1, &b2);
+        f_prev = f;
+        b_prev = b;
+      }
+      c[C_A0][i] = a0; c[C_A1][i] = a1; c[C_B1][i] = b1; c[C_B2][i] = b2;
+    }
+    const float * x = in + offset;
+    float * o = out + offset;
+    for(int i = 0; i < n; i++) {
+      switch(type) {
+      case BANK_LPF:
+        y0 = x[i] + c[C_B1][i] * y1 + c[C_B2][i] * y2;
+        o[i] = c[C_A0][i] * (y0 + 2. * y1 + y2);
+        break;
+      case BANK_HPF:
+        y0 = x[i] + c[C_B1][i] * y1 + c[C_B2][i] * y2;
+        o[i] = c[C_A0][i] * (y0 - 2. * y1 + y2);
+        break;
+      case BANK_BPF:
+        y0 = x[i] + c[C_B1][i] * y1 + c[C_B2][i] * y2;
+        o[i] = c[C_A0][i] * (y0 - y2);
+        break;
+      default:
+        ay = c[C_A1][i] * y1;
+        y0 = x[i] - ay - c[C_B2][i] * y2;
+        o[i] = c[C_A0][i] * (y0 + y2) + ay;
+        break;
+      }
+      y2 = y1;
+      y1 = y0;
+    }
+  }
+  unit->m_freq = f_prev;
+  unit->m_bw = b_prev;
+  unit->m_a0 = a0; unit->m_a1 = a1; unit->m_b1 = b1; unit->m_b2 = b2;
+  unit->m_y1 = zapgremlins(y1);
+  unit->m_y2 = zapgremlins(y2);
+}
+
+static void LHPF_dispatch_ar(LHPF * unit, float * out, const float * in,
+                             const float * freq, double freq_k,
+                             const float * bw, double bw_k, int inNumSamples) {
+  if(unit->next == &LPF_next) {
+    LHPF_run_ar(unit, out, in, freq, freq_k, bw, bw_k, inNumSamples, BANK_LPF);
+  } else if(unit->next == &HPF_next) {
+    LHPF_run_ar(unit, out, in, freq, freq_k, bw, bw_k, inNumSamples, BANK_HPF);
+  } else if(unit->next == &BPF_next) {
+    LHPF_run_ar(unit, out, in, freq, freq_k, bw, bw_k, inNumSamples, BANK_BPF);
+  } else {
+    LHPF_run_ar(unit, out, in, freq, freq_k, bw, bw_k, inNumSamples, BANK_BRF);
+  }
+}
+
+static void LHPF_next_ar(LHPF * unit, float * out, const float * in,
+                         const float * freq, double freq_k,
+                         const float * bw, double bw_k, int inNumSamples) {
+  if(unit->first) {
+    // Prime as lhpf_calc does, the first sample is run once more
+    float prime;
+    LHPF_dispatch_ar(unit, &prime, in, freq, freq_k, bw, bw_k, 1);
+    unit->first = 0;
+  }
+  LHPF_dispatch_ar(unit, out, in, freq, freq_k, bw, bw_k, inNumSamples);
+}
+
+// Voice v of the packed binaries starts at v * stride
+static inline void LHPFBank_run(LHPFBank * bank, float * out, float * in,
+                                int inNumSamples, int stride, const int type) {
+  // Coefficients move every third sample, as in the scalar units
+  int mFilterLoops = inNumSamples / 3;
+  int mFilterRemain = inNumSamples % 3;
+  double mFilterSlope = (mFilterLoops == 0) ? 0. : 1. / mFilterLoops;
+  double * freq = bank->args;
+  double * bw = bank->args + bank->num_groups * SC_LANES;
+
+  for(unsigned int g = 0; g < bank->num_groups; g++) {
+    LHPFLanes * l = &bank->lanes[g];
+    unsigned int first_voice = g * SC_LANES;
+    unsigned int nv = sc_min(SC_LANES, bank->num_voices - first_voice);
+    float * ip[SC_LANES];
+    float * op[SC_LANES];
+    for(unsigned int k = 0; k < SC_LANES; k++) {
+      ip[k] = in + (first_voice + (k < nv ? k : 0)) * stride;
+      op[k] = out + (first_voice + k) * stride;
+    }
+
+    sc_v4d next_a0 = l->m_a0, next_a1 = l->m_a1, next_b1 = l->m_b1, next_b2 = l->m_b2;
+    for(unsigned int k = 0; k < SC_LANES; k++) {
+      double f = freq[first_voice + k];
+      double b = bw[first_voice + k];
+      if(f != l->m_freq[k] || (type >= BANK_BPF && b != l->m_bw[k])) {
+        double a0, a1, b1, b2;
+        a1 = next_a1[k]; b1 = next_b1[k];
+        lhpf_bank_coefs(type, bank->rate, f, b, &a0, &a1, &b1, &b2);
+        next_a0[k] = a0; next_a1[k] = a1; next_b1[k] = b1; next_b2[k] = b2;
+        l->m_freq[k] = f;
+        l->m_bw[k] = b;
+      }
+    }
+
+    sc_v4d y1 = l->m_y1, y2 = l->m_y2;
+    sc_v4d x, o;
+    if(bank->first) {
+      // Prime as the scalar units do, the first input sample is
+      // taken as state with the new coefficients
+      for(unsigned int k = 0; k < SC_LANES; k++) {
+        y1[k] = zapgremlins(ip[k][0]);
+        y2[k] = 0.;
+      }
+      l->m_a0 = next_a0; l->m_a1 = next_a1; l->m_b1 = next_b1; l->m_b2 = next_b2;
+    }
+    sc_v4d c[4] = {l->m_a0, l->m_a1, l->m_b1, l->m_b2};
+    sc_v4d slope[4] = {(next_a0 - c[C_A0]) * mFilterSlope,
+                       (next_a1 - c[C_A1]) * mFilterSlope,
+                       (next_b1 - c[C_B1]) * mFilterSlope,
+                       (next_b2 - c[C_B2]) * mFilterSlope};
+
+    int i = 0;
+    for(int loop = 0; loop < mFilterLoops; loop++) {
+      for(int j = 0; j < 3; j++, i++) {
+        for(unsigned int k = 0; k < SC_LANES; k++) x[k] = ip[k][i];
+        lhpf_bank_step(type, &o, &x, &y1, &y2, c);
+        for(unsigned int k = 0; k < nv; k++) op[k][i] = o[k];
+      }
+      for(int j = 0; j < 4; j++) c[j] += slope[j];
+    }
+    for(int r = 0; r < mFilterRemain; r++, i++) {
+      for(unsigned int k = 0; k < SC_LANES; k++) x[k] = ip[k][i];
+      lhpf_bank_step(type, &o, &x, &y1, &y2, c);
+      for(unsigned int k = 0; k < nv; k++) op[k][i] = o[k];
+    }
+
+    l->m_a0 = next_a0; l->m_a1 = next_a1; l->m_b1 = next_b1; l->m_b2 = next_b2;
+    for(unsigned int k = 0; k < SC_LANES; k++) {
+      l->m_y1[k] = zapgremlins(y1[k]);
+      l->m_y2[k] = zapgremlins(y2[k]);
+    }
+  }
+  bank->first = 0;
+}
+
+static void LHPFBank_next(LHPFBank * bank, float * out, float * in, int inNumSamples) {
+  // Sub-blocks of one control period, see sc_subblocks
+  int period = bank->period_size < 1 ? inNumSamples : bank->period_size;
+  for(int offset = 0; offset < inNumSamples; offset += period) {
+    int n = sc_min(period, inNumSamples - offset);
+    switch(bank->type) {
+    case BANK_LPF: LHPFBank_run(bank, out + offset, in + offset, n, inNumSamples, BANK_LPF); break;
+    case BANK_HPF: LHPFBank_run(bank, out + offset, in + offset, n, inNumSamples, BANK_HPF); break;
+    case BANK_BPF: LHPFBank_run(bank, out + offset, in + offset, n, inNumSamples, BANK_BPF); break;
+    default: LHPFBank_run(bank, out + offset, in + offset, n, inNumSamples, BANK_BRF); break;
+    }
+  }
+}
+
+static ERL_NIF_TERM lhpf_bank_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  unsigned int rate, period_size, num_voices;
+  char type[12];
+  int bank_type;
+  if (!enif_get_uint(env, argv[0], &rate)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_uint(env, argv[1], &period_size)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_atom(env, argv[2], type, 12, ERL_NIF_LATIN1)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_uint(env, argv[3], &num_voices) || num_voices == 0){
+    return enif_make_badarg(env);
+  }
+  if (strcmp(type, "lpf") == 0) {
+    bank_type = BANK_LPF;
+  } else if (strcmp(type, "hpf") == 0) {
+    bank_type = BANK_HPF;
+  } else if (strcmp(type, "bpf") == 0) {
+    bank_type = BANK_BPF;
+  } else if (strcmp(type, "brf") == 0) {
+    bank_type = BANK_BRF;
+  } else {
+    return enif_make_badarg(env);
+  }
+
+  unsigned int num_groups = (num_voices + SC_LANES - 1) / SC_LANES;
+  size_t lanes_size = num_groups * sizeof(LHPFLanes);
+  size_t args_size = 2 * num_groups * SC_LANES * sizeof(double);
+  size_t bytes = sizeof(LHPFBank) + sizeof(sc_v4d) + lanes_size + args_size;
+  LHPFBank * bank = enif_alloc_resource(sc_filter_bank_type, bytes);
+  bank->mem.type = NULL;
+  bank->num_voices = num_voices;
+  bank->num_groups = num_groups;
+  bank->type = bank_type;
+  bank->rate = (double) rate;
+  bank->period_size = period_size;
+  bank->first = 1;
+  bank->lanes = sc_align(bank + 1);
+  bank->args = (double *) (bank->lanes + num_groups);
+  memset(bank->lanes, 0, lanes_size);
+  // BPF and BRF banks run with the default bandwidth until one is given
+  for(unsigned int i = 0; i < num_groups * SC_LANES; i++) {
+    bank->args[i] = lhpf_defaults[0];
+    bank->args[num_groups * SC_LANES + i] = lhpf_defaults[1];
+  }
+  for(unsigned int g = 0; g < num_groups; g++) {
+    for(unsigned int k = 0; k < SC_LANES; k++) {
+      bank->lanes[g].m_freq[k] = uninitializedControl;
+      bank->lanes[g].m_bw[k] = uninitializedControl;
+    }
+  }
+  if (!sc_mem_charge(&bank->mem, &filter_mem[MEM_LHPF_BANK], bytes)){
+    enif_release_resource(bank);
+    return sc_budget_exceeded(env);
+  }
+  ERL_NIF_TERM term = enif_make_resource(env, bank);
+  enif_release_resource(bank);
+  return term;
+}
+
+static ERL_NIF_TERM lhpf_bank_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  LHPFBank * bank;
+  ErlNifBinary in_bin;
+  ERL_NIF_TERM out_term;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_bank_type,
+                         (void**) &bank)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  unsigned int num_lanes = bank->num_groups * SC_LANES;
+  if(!get_bank_args(env, argv[2], bank->num_voices, num_lanes, NULL)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Frequency not a float nor a list of floats",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(argc > 3 && !get_bank_args(env, argv[3], bank->num_voices, num_lanes, NULL)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Bandwidth not a float nor a list of floats",
+                                                 ERL_NIF_LATIN1));
+  }
+  get_bank_args(env, argv[2], bank->num_voices, num_lanes, bank->args);
+  if(argc > 3) get_bank_args(env, argv[3], bank->num_voices, num_lanes, bank->args + num_lanes);
+
+  if(!enif_inspect_binary(env, argv[1], &in_bin) ||
+     in_bin.size % (bank->num_voices * sizeof(float)) != 0){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Not a binary of one period per voice",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(sc_dirty_needed(in_bin.size / sizeof(float))){
+    return enif_schedule_nif(env, "lhpf_bank_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             lhpf_bank_next, argc, argv);
+  }
+  int inNumSamples = in_bin.size / (bank->num_voices * sizeof(float));
+  float * out = (float *) enif_make_new_binary(env, in_bin.size, &out_term);
+  LHPFBank_next(bank, out, (float *) in_bin.data, inNumSamples);
+  return out_term;
+}
+
+/* ------------------------------------------------------------ */
+
+typedef struct {
+  sc_v4d m_lagu, m_lagd;
+  sc_v4d m_b1u, m_b1d, m_y1;
+} LagLanes;
+
+typedef struct LagBank {
+  SCMemTag mem;             // First, see filter_bank_dtor
+  unsigned int num_voices, num_groups;
+  double rate, period_size;
+  int first;
+  LagLanes * lanes;         // num_groups lane groups, in the resource
+  double * args;            // lag up and down per voice, padded to lane groups
+} LagBank;
+
+// Voice v of the packed binaries starts at v * stride
+static void LagBank_run(LagBank * bank, float * out, float * in, int inNumSamples, int stride) {
+  double * lagu = bank->args;
+  double * lagd = bank->args + bank->num_groups * SC_LANES;
+
+  for(unsigned int g = 0; g < bank->num_groups; g++) {
+    LagLanes * l = &bank->lanes[g];
+    unsigned int first_voice = g * SC_LANES;
+    unsigned int nv = sc_min(SC_LANES, bank->num_voices - first_voice);
+    float * ip[SC_LANES];
+    float * op[SC_LANES];
+    for(unsigned int k = 0; k < SC_LANES; k++) {
+      ip[k] = in + (first_voice + (k < nv ? k : 0)) * stride;
+      op[k] = out + (first_voice + k) * stride;
+    }
+    if(bank->first) {
+      for(unsigned int k = 0; k < SC_LANES; k++) l->m_y1[k] = ip[k][0];
+    }
+
+    sc_v4d y1 = l->m_y1;
+    sc_v4d b1u = l->m_b1u;
+    sc_v4d b1d = l->m_b1d;
+    sc_v4d x;
+    int changed = 0;
+    for(unsigned int k = 0; k < SC_LANES; k++) {
+      double u = lagu[first_voice + k];
+      double d = lagd[first_voice + k];
+      if(u != l->m_lagu[k] || d != l->m_lagd[k]) {
+        l->m_b1u[k] = u == 0. ? 0. : exp(log001 / (u * bank->rate));
+        l->m_b1d[k] = d == 0. ? 0. : exp(log001 / (d * bank->rate));
+        l->m_lagu[k] = u;
+        l->m_lagd[k] = d;
+        changed = 1;
+      }
+    }
+
+    if(!changed) {
+      for(int i = 0; i < inNumSamples; i++) {
+        for(unsigned int k = 0; k < SC_LANES; k++) x[k] = ip[k][i];
+        y1 = x + sc_v4d_select_gt(x, y1, b1u, b1d) * (y1 - x);
+        for(unsigned int k = 0; k < nv; k++) op[k][i] = y1[k];
+      }
+    } else {
+      sc_v4d b1u_slope = (l->m_b1u - b1u) / bank->period_size;
+      sc_v4d b1d_slope = (l->m_b1d - b1d) / bank->period_size;
+      for(int i = 0; i < inNumSamples; i++) {
+        b1u += b1u_slope;
+        b1d += b1d_slope;
+        for(unsigned int k = 0; k < SC_LANES; k++) x[k] = ip[k][i];
+        y1 = x + sc_v4d_select_gt(x, y1, b1u, b1d) * (y1 - x);
+        for(unsigned int k = 0; k < nv; k++) op[k][i] = y1[k];
+      }
+    }
+    for(unsigned int k = 0; k < SC_LANES; k++) l->m_y1[k] = zapgremlins(y1[k]);
+  }
+  bank->first = 0;
+}
+
+static void LagBank_next(LagBank * bank, float * out, float * in, int inNumSamples) {
+  // Sub-blocks of one control period, see sc_subblocks
+  int period = bank->period_size < 1 ? inNumSamples : bank->period_size;
+  for(int offset = 0; offset < inNumSamples; offset += period) {
+    LagBank_run(bank, out + offset, in + offset, sc_min(period, inNumSamples - offset),
+                inNumSamples);
+  }
+}
+
+static ERL_NIF_TERM lag_bank_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  unsigned int rate, period_size, num_voices;
+  if (!enif_get_uint(env, argv[0], &rate)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_uint(env, argv[1], &period_size)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_uint(env, argv[2], &num_voices) || num_voices == 0){
+    return enif_make_badarg(env);
+  }
+
+  unsigned int num_groups = (num_voices + SC_LANES - 1) / SC_LANES;
+  size_t lanes_size = num_groups * sizeof(LagLanes);
+  size_t args_size = 2 * num_groups * SC_LANES * sizeof(double);
+  size_t bytes = sizeof(LagBank) + sizeof(sc_v4d) + lanes_size + args_size;
+  LagBank * bank = enif_alloc_resource(sc_filter_bank_type, bytes);
+  bank->mem.type = NULL;
+  bank->num_voices = num_voices;
+  bank->num_groups = num_groups;
+  bank->rate = rate;
+  bank->period_size = period_size;
+  bank->first = 1;
+  bank->lanes = sc_align(bank + 1);
+  bank->args = (double *) (bank->lanes + num_groups);
+  memset(bank->lanes, 0, lanes_size);
+  memset(bank->args, 0, args_size);
+  for(unsigned int g = 0; g < num_groups; g++) {
+    for(unsigned int k = 0; k < SC_LANES; k++) {
+      bank->lanes[g].m_lagu[k] = uninitializedControl;
+      bank->lanes[g].m_lagd[k] = uninitializedControl;
+    }
+  }
+  if (!sc_mem_charge(&bank->mem, &filter_mem[MEM_LAG_BANK], bytes)){
+    enif_release_resource(bank);
+    return sc_budget_exceeded(env);
+  }
+  ERL_NIF_TERM term = enif_make_resource(env, bank);
+  enif_release_resource(bank);
+  return term;
+}
+
+static ERL_NIF_TERM lag_bank_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  LagBank * bank;
+  ErlNifBinary in_bin;
+  ERL_NIF_TERM out_term;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_bank_type,
+                         (void**) &bank)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  unsigned int num_lanes = bank->num_groups * SC_LANES;
+  if(!get_bank_args(env, argv[2], bank->num_voices, num_lanes, NULL)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Lag UP not a float nor a list of floats",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(!get_bank_args(env, argv[argc - 1], bank->num_voices, num_lanes, NULL)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Lag DOWN not a float nor a list of floats",
+                                                 ERL_NIF_LATIN1));
+  }
+  get_bank_args(env, argv[2], bank->num_voices, num_lanes, bank->args);
+  get_bank_args(env, argv[argc - 1], bank->num_voices, num_lanes, bank->args + num_lanes);
+
+  if(!enif_inspect_binary(env, argv[1], &in_bin) ||
+     in_bin.size % (bank->num_voices * sizeof(float)) != 0){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Not a binary of one period per voice",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(sc_dirty_needed(in_bin.size / sizeof(float))){
+    return enif_schedule_nif(env, "lag_bank_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             lag_bank_next, argc, argv);
+  }
+  int inNumSamples = in_bin.size / (bank->num_voices * sizeof(float));
+  float * out = (float *) enif_make_new_binary(env, in_bin.size, &out_term);
+  LagBank_next(bank, out, (float *) in_bin.data, inNumSamples);
+  return out_term;
+}
+
+/* ---------------------------------------------------------- */
+
+static ERL_NIF_TERM unit(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * sc;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &sc)){
+    return enif_make_badarg(env);
+  }
+  return sc_unit_handle(env, sc);
+}
+
+static ERL_NIF_TERM next_events(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * sc;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &sc)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  return sc_next_events(env, sc, "next_events", next_events, argc, argv);
+}
+
+static ERL_NIF_TERM set_params(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * sc;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &sc)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  return sc_set_params(env, sc, argv);
+}
+
+static ERL_NIF_TERM process(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * sc;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_filter_type,
+                         (void**) &sc)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  return sc_process(env, sc, "process", process, argc, argv);
+}
+
+// memory_stats(), live instances and bytes per filter type
+static ERL_NIF_TERM memory_stats(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_mem_stats(env, filter_mem, FILTER_MEM_TYPES);
+}
+
+static ERL_NIF_TERM memory_budget(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_mem_budget(env, filter_mem, FILTER_MEM_TYPES, argv);
+}
+
 /* ---------------------------------------------------------- */
 static ErlNifFunc nif_funcs[] = {
   {"ramp_ctor", 2, ramp_ctor},
@@ -981,7 +1983,24 @@ static ErlNifFunc nif_funcs[] = {
   {"lagud_next", 4, lagud_next},
   {"lhpf_ctor", 3, lhpf_ctor},
   {"lhpf_next", 3, lhpf_next},
-  {"lhpf_next", 4, lhpf_next}
+  {"lhpf_next", 4, lhpf_next},
+  {"ramp_next_kr", 3, ramp_next_kr},
+  {"lag_next_kr", 3, lag_next_kr},
+  {"lagud_next_kr", 4, lagud_next_kr},
+  {"lhpf_next_kr", 3, lhpf_next_kr},
+  {"lhpf_next_kr", 4, lhpf_next_kr},
+  {"lhpf_bank_ctor", 4, lhpf_bank_ctor},
+  {"lhpf_bank_next", 3, lhpf_bank_next},
+  {"lhpf_bank_next", 4, lhpf_bank_next},
+  {"lag_bank_ctor", 3, lag_bank_ctor},
+  {"lag_bank_next", 3, lag_bank_next},
+  {"lag_bank_next", 4, lag_bank_next},
+  {"unit", 1, unit},
+  {"next_events", 4, next_events},
+  {"set_params", 2, set_params},
+  {"process", 2, process},
+  {"memory_stats", 0, memory_stats},
+  {"memory_budget", 2, memory_budget}
 };
 
 static int open_filter_resource_type(ErlNifEnv* env)
@@ -990,9 +2009,11 @@ static int open_filter_resource_type(ErlNifEnv* env)
   const char* resource_type = "sc_filter";
   int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
   sc_filter_type =
-    enif_open_resource_type(env, mod, resource_type,
-                            NULL, flags, NULL);
-  return ((sc_filter_type == NULL) ? -1:0);
+    sc_open_unit_type(env, resource_type, filter_resource_dtor, flags);
+  sc_filter_bank_type =
+    enif_open_resource_type(env, mod, "sc_filter_bank",
+                            filter_bank_dtor, flags, NULL);
+  return ((sc_filter_type == NULL || sc_filter_bank_type == NULL) ? -1:0);
 }
 
 static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
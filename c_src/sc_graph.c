@@ -0,0 +1,355 @@
+#include <erl_nif.h>
+#include <math.h>
+#include <string.h>
+#include "sc_plug.h"
+
+/* A graph runs a flat, topologically sorted list of ops compiled by
+   SC.Graph. Every op reads and writes wires. A wire is either a graph
+   input binary, a graph output binary or one of the scratch buffers.
+   SC.Graph colors the wires by liveness so a graph only needs as many
+   scratch buffers as there are signals alive at the same time.
+
+   Wire numbering: [0, num_inputs) graph inputs,
+   [num_inputs, num_inputs + num_outputs) graph outputs, then scratch.
+
+   Like a chain, a graph has a unit head of its own and can be run as
+   a unit.
+*/
+
+static ErlNifResourceType* sc_graph_type;
+
+typedef struct {
+  SCUnit * unit;          // NULL for a sum of the inputs
+  double args[SC_MAX_ARGS];
+  unsigned int num_inputs, num_outputs;
+  unsigned int * wires;   // Input wires followed by output wires
+} GraphOp;
+
+typedef struct {
+  SCUnit sc;
+  ErlNifEnv * env;        // Holds the unit handles, keeps the units alive
+  unsigned int num_inputs, num_outputs, num_scratch, num_ops;
+  GraphOp * ops;
+  unsigned int * wires;
+  int bufsize;            // Size of each scratch buffer in samples
+  float * scratch;
+  float ** bufs;          // Wire table
+} Graph;
+
+// ErlNifResourceDtor
+static void graph_resource_dtor(ErlNifEnv* env, void * obj){
+  Graph * graph = (Graph *) obj;
+  if(graph->env) enif_free_env(graph->env);
+  if(graph->ops) enif_free(graph->ops);
+  if(graph->wires) enif_free(graph->wires);
+  if(graph->scratch) enif_free(graph->scratch);
+  if(graph->bufs) enif_free(graph->bufs);
+  sc_unit_release(&graph->sc);
+}
+
+static int get_wires(ErlNifEnv* env, ERL_NIF_TERM list, unsigned int * wires,
+                     unsigned int num_wires)
+{
+  ERL_NIF_TERM head, tail;
+  unsigned int i = 0;
+  while (enif_get_list_cell(env, list, &head, &tail)){
+    if(!enif_get_uint(env, head, &wires[i]) || wires[i] >= num_wires){
+      return 0;
+    }
+    list = tail;
+    i++;
+  }
+  return 1;
+}
+
+static int get_op(ErlNifEnv* env, ERL_NIF_TERM term, Graph * graph, GraphOp * op,
+                  unsigned int ** wires)
+{
+  const ERL_NIF_TERM * tuple;
+  int arity;
+  unsigned int num_wires = graph->num_inputs + graph->num_outputs + graph->num_scratch;
+  char sum[4];
+
+  if(!(enif_get_tuple(env, term, &arity, &tuple) && arity == 4 &&
+       enif_get_list_length(env, tuple[2], &op->num_inputs) &&
+       enif_get_list_length(env, tuple[3], &op->num_outputs) &&
+       sc_get_args(env, tuple[1], op->args))){
+    return 0;
+  }
+  if(enif_get_atom(env, tuple[0], sum, 4, ERL_NIF_LATIN1) && strcmp(sum, "sum") == 0){
+    op->unit = NULL;
+    if(op->num_inputs == 0 || op->num_outputs != 1) return 0;
+  } else {
+    op->unit = sc_unit_from_handle(env, tuple[0]);
+    if(op->unit == NULL ||
+       op->num_inputs != op->unit->num_inputs ||
+       op->num_outputs != op->unit->num_outputs) return 0;
+    enif_make_copy(graph->env, tuple[0]);
+  }
+  op->wires = *wires;
+  *wires += op->num_inputs + op->num_outputs;
+  if(!(get_wires(env, tuple[2], op->wires, num_wires) &&
+       get_wires(env, tuple[3], op->wires + op->num_inputs, num_wires))){
+    return 0;
+  }
+  // Ops may not write graph inputs nor read their own outputs
+  for(unsigned int o = op->num_inputs; o < op->num_inputs + op->num_outputs; o++){
+    if(op->wires[o] < graph->num_inputs) return 0;
+    for(unsigned int i = 0; i < op->num_inputs; i++){
+      if(op->wires[i] == op->wires[o]) return 0;
+    }
+  }
+  return 1;
+}
+
+static void graph_sum(float * out, float ** in, unsigned int num_inputs, int inNumSamples)
+{
+  memcpy(out, in[0], inNumSamples * sizeof(float));
+  for(unsigned int j = 1; j < num_inputs; j++){
+    float * inj = in[j];
+    for(int i = 0; i < inNumSamples; i++){
+      out[i] += inj[i];
+    }
+  }
+}
+
+static void graph_run(Graph * graph, float ** out, float ** in, int inNumSamples)
+{
+  float ** bufs = graph->bufs;
+
+  if(inNumSamples > graph->bufsize) {
+    graph->bufsize = inNumSamples;
+    graph->scratch = enif_realloc(graph->scratch,
+                                  (graph->num_scratch > 0 ? graph->num_scratch : 1)
+                                  * graph->bufsize * sizeof(float));
+  }
+
+  for(unsigned int i = 0; i < graph->num_inputs; i++){
+    bufs[i] = in[i];
+  }
+  for(unsigned int o = 0; o < graph->num_outputs; o++){
+    bufs[graph->num_inputs + o] = out[o];
+  }
+  for(unsigned int s = 0; s < graph->num_scratch; s++){
+    bufs[graph->num_inputs + graph->num_outputs + s] = graph->scratch + s * graph->bufsize;
+  }
+
+  for(unsigned int i = 0; i < graph->num_ops; i++){
+    GraphOp * op = &graph->ops[i];
+    float * in_array[op->num_inputs];
+    float * out_array[op->num_outputs];
+    for(unsigned int j = 0; j < op->num_inputs; j++){
+      in_array[j] = bufs[op->wires[j]];
+    }
+    for(unsigned int j = 0; j < op->num_outputs; j++){
+      out_array[j] = bufs[op->wires[op->num_inputs + j]];
+    }
+    if(op->unit) {
+      (*op->unit->calc)(op->unit, out_array, in_array, op->args, inNumSamples);
+    } else {
+      graph_sum(out_array[0], in_array, op->num_inputs, inNumSamples);
+    }
+  }
+}
+
+static void graph_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  graph_run((Graph *) sc, out, in, inNumSamples);
+}
+
+static ERL_NIF_TERM graph_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  unsigned int num_inputs, num_outputs, num_scratch, len;
+  ERL_NIF_TERM list, head, tail;
+  const ERL_NIF_TERM * tuple;
+  int arity;
+  unsigned int total = 0, in_len, out_len;
+
+  if (!(enif_get_uint(env, argv[0], &num_inputs) &&
+        enif_get_uint(env, argv[1], &num_outputs) && num_outputs > 0 &&
+        enif_get_uint(env, argv[2], &num_scratch) &&
+        enif_get_list_length(env, argv[3], &len))){
+    return enif_make_badarg(env);
+  }
+  list = argv[3];
+  while (enif_get_list_cell(env, list, &head, &tail)){
+    if(!(enif_get_tuple(env, head, &arity, &tuple) && arity == 4 &&
+         enif_get_list_length(env, tuple[2], &in_len) &&
+         enif_get_list_length(env, tuple[3], &out_len))){
+      return enif_make_badarg(env);
+    }
+    total += in_len + out_len;
+    list = tail;
+  }
+
+  Graph * graph = enif_alloc_resource(sc_graph_type, sizeof(Graph));
+  // Safe for the dtor on any early release
+  sc_unit_init(&graph->sc, 0, 0, 0, NULL);
+  graph->env = enif_alloc_env();
+  graph->num_inputs = num_inputs;
+  graph->num_outputs = num_outputs;
+  graph->num_scratch = num_scratch;
+  graph->num_ops = len;
+  graph->ops = enif_alloc((len > 0 ? len : 1) * sizeof(GraphOp));
+  graph->wires = enif_alloc((total > 0 ? total : 1) * sizeof(unsigned int));
+  graph->bufs = enif_alloc((num_inputs + num_outputs + num_scratch) * sizeof(float *));
+  graph->bufsize = 0;
+  graph->scratch = NULL;
+
+  unsigned int * wires = graph->wires;
+  list = argv[3];
+  for(unsigned int i = 0; enif_get_list_cell(env, list, &head, &tail); i++){
+    if(!get_op(env, head, graph, &graph->ops[i], &wires)){
+      enif_release_resource(graph);
+      return enif_make_badarg(env);
+    }
+    list = tail;
+  }
+  // Every graph output must be written by some op
+  for(unsigned int w = num_inputs; w < num_inputs + num_outputs; w++){
+    int written = 0;
+    for(unsigned int i = 0; i < len && !written; i++){
+      GraphOp * op = &graph->ops[i];
+      for(unsigned int o = 0; o < op->num_outputs; o++){
+        written |= (op->wires[op->num_inputs + o] == w);
+      }
+    }
+    if(!written){
+      enif_release_resource(graph);
+      return enif_make_badarg(env);
+    }
+  }
+  graph->sc.num_inputs = num_inputs;
+  graph->sc.num_outputs = num_outputs;
+  graph->sc.calc = &graph_calc;
+
+  ERL_NIF_TERM term = enif_make_resource(env, graph);
+  enif_release_resource(graph);
+  return term;
+}
+
+static ERL_NIF_TERM graph_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Graph * graph;
+  unsigned int channels;
+  int inNumSamples = 0;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_graph_type,
+                         (void**) &graph)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  // A graph without inputs still takes a binary for the block length
+  unsigned int max_channels = sc_max(graph->num_inputs, 1);
+  float * in_array[max_channels];
+  float * out_array[graph->num_outputs];
+  ERL_NIF_TERM out_term[graph->num_outputs];
+
+  if(!sc_get_channels(env, argv[1], in_array, max_channels, &channels, &inNumSamples)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Input stream not a binary nor a list of binaries of one length",
+                                                 ERL_NIF_LATIN1));
+  }
+  if(channels < graph->num_inputs) {
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Too few input streams",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  if(sc_dirty_needed((size_t) inNumSamples * graph->num_ops)){
+    return enif_schedule_nif(env, "graph_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             graph_next, argc, argv);
+  }
+
+  for(unsigned int o = 0; o < graph->num_outputs; o++){
+    out_array[o] = sc_make_output(env, &graph->sc, inNumSamples * sizeof(float),
+                                  &out_term[o]);
+  }
+  graph_run(graph, out_array, in_array, inNumSamples);
+
+  if (graph->num_outputs == 1){
+    return out_term[0];
+  } else {
+    return enif_make_list_from_array(env, out_term, graph->num_outputs);
+  }
+}
+
+static ERL_NIF_TERM graph_set_args(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Graph * graph;
+  unsigned int index;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_graph_type,
+                         (void**) &graph)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_uint(env, argv[1], &index) || index >= graph->num_ops
+      || graph->ops[index].unit == NULL){
+    return enif_make_badarg(env);
+  }
+  if (!sc_get_args(env, argv[2], graph->ops[index].args)){
+    return enif_make_badarg(env);
+  }
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM unit(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Graph * graph;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_graph_type,
+                         (void**) &graph)){
+    return enif_make_badarg(env);
+  }
+  return sc_unit_handle(env, &graph->sc);
+}
+
+static ERL_NIF_TERM unit_info(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  SCUnit * unit = sc_unit_from_handle(env, argv[0]);
+  if (unit == NULL){
+    return enif_make_badarg(env);
+  }
+  return enif_make_tuple2(env,
+                          enif_make_uint(env, unit->num_inputs),
+                          enif_make_uint(env, unit->num_outputs));
+}
+
+/* ---------------------------------------------------------- */
+static ErlNifFunc nif_funcs[] = {
+  {"graph_ctor", 4, graph_ctor},
+  {"graph_next", 2, graph_next},
+  {"graph_set_args", 3, graph_set_args},
+  {"graph_unit", 1, unit},
+  {"unit_info", 1, unit_info}
+};
+
+static int open_graph_resource_type(ErlNifEnv* env)
+{
+  const char* resource_type = "sc_graph";
+  int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
+  sc_graph_type =
+    sc_open_unit_type(env, resource_type, graph_resource_dtor, flags);
+  return ((sc_graph_type == NULL) ? -1:0);
+}
+
+static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
+{
+  return open_graph_resource_type(caller_env);
+}
+
+static int upgrade(ErlNifEnv* caller_env, void** priv_data, void** old_priv_data,
+		   ERL_NIF_TERM load_info)
+{
+  return open_graph_resource_type(caller_env);
+}
+
+
+ERL_NIF_INIT(Elixir.SC.Graph, nif_funcs, load, NULL, upgrade, NULL);
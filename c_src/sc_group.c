@@ -0,0 +1,450 @@
+#include <erl_nif.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "sc_plug.h"
+
+/* A group renders independent voices in parallel and sums them onto one
+   bus, like a supernova parallel group. Voices are unit handles, i.e.
+   single plugins, chains or graphs. A voice must not share plugins with
+   any other voice of the group as voices run on different threads.
+
+   The library owns a pool of worker threads. For every block the voices
+   are split into one contiguous range per slot (the calling thread plus
+   each worker). A slot pops voices from the front of its own range and,
+   when done, steals from the back of the other ranges. Each slot sums
+   its voices into its own accumulator, the calling thread joins the
+   workers and adds the accumulators into the output binaries.
+*/
+
+static ErlNifResourceType* sc_group_type;
+
+typedef struct {
+  SCUnit * unit;
+  double args[SC_MAX_ARGS];
+  float * in[SC_MAX_CHANNELS];
+} GroupVoice;
+
+typedef struct {
+  _Atomic uint64_t range;   // Voices left, first << 32 | end
+  int used;                 // Accumulator holds at least one voice
+} GroupSlot;
+
+typedef struct {
+  ErlNifEnv * env;          // Holds the unit handles, keeps the units alive
+  unsigned int num_voices;
+  unsigned int channels;    // Output bus channels
+  GroupVoice * voices;
+  unsigned int num_slots;
+  GroupSlot * slots;
+  int bufsize;              // Size of each scratch buffer in samples
+  float * scratch;          // Per slot 2 * SC_MAX_CHANNELS buffers
+  int inNumSamples;
+} Group;
+
+typedef struct {
+  struct GroupPool * pool;
+  unsigned int slot;
+  unsigned long seen;
+  ErlNifTid tid;
+} GroupWorker;
+
+typedef struct GroupPool {
+  unsigned int num_threads;
+  GroupWorker * workers;
+  ErlNifMutex * dispatch;   // One group block at a time
+  ErlNifMutex * lock;       // Protects the fields below
+  ErlNifCond * wake;
+  ErlNifCond * done;
+  Group * job;
+  unsigned long generation;
+  unsigned int busy;
+  int stop;
+} GroupPool;
+
+// ErlNifResourceDtor
+static void group_resource_dtor(ErlNifEnv* env, void * obj){
+  Group * group = (Group *) obj;
+  if(group->env) enif_free_env(group->env);
+  if(group->voices) enif_free(group->voices);
+  if(group->slots) enif_free(group->slots);
+  if(group->scratch) enif_free(group->scratch);
+}
+
+/* ---------------------------------------------------------- */
+
+static inline uint64_t pack_range(uint32_t first, uint32_t end) {
+  return ((uint64_t) first << 32) | end;
+}
+
+static int slot_pop(GroupSlot * slot) {
+  uint64_t r = atomic_load(&slot->range);
+  for(;;){
+    uint32_t first = r >> 32, end = (uint32_t) r;
+    if(first >= end) return -1;
+    if(atomic_compare_exchange_weak(&slot->range, &r, pack_range(first + 1, end)))
+      return first;
+  }
+}
+
+static int slot_steal(GroupSlot * slot) {
+  uint64_t r = atomic_load(&slot->range);
+  for(;;){
+    uint32_t first = r >> 32, end = (uint32_t) r;
+    if(first >= end) return -1;
+    if(atomic_compare_exchange_weak(&slot->range, &r, pack_range(first, end - 1)))
+      return end - 1;
+  }
+}
+
+static void group_work(Group * group, unsigned int s)
+{
+  int n = group->inNumSamples;
+  float * base = group->scratch + s * 2 * SC_MAX_CHANNELS * group->bufsize;
+  float * tmp[SC_MAX_CHANNELS], * acc[SC_MAX_CHANNELS];
+  for(unsigned int c = 0; c < SC_MAX_CHANNELS; c++){
+    tmp[c] = base + c * group->bufsize;
+    acc[c] = base + (SC_MAX_CHANNELS + c) * group->bufsize;
+  }
+
+  int used = 0;
+  for(unsigned int k = 0; k < group->num_slots; ){
+    GroupSlot * victim = &group->slots[(s + k) % group->num_slots];
+    int v = (k == 0) ? slot_pop(victim) : slot_steal(victim);
+    if(v < 0) {
+      k++;
+      continue;
+    }
+    GroupVoice * voice = &group->voices[v];
+    SCUnit * unit = voice->unit;
+    (*unit->calc)(unit, tmp, voice->in, voice->args, n);
+    // A mono voice is added to every bus channel
+    for(unsigned int c = 0; c < group->channels; c++){
+      float * src = tmp[c % unit->num_outputs];
+      float * dst = acc[c];
+      if(used) {
+        for(int i = 0; i < n; i++) dst[i] += src[i];
+      } else {
+        memcpy(dst, src, n * sizeof(float));
+      }
+    }
+    used = 1;
+  }
+  group->slots[s].used = used;
+}
+
+static void* group_worker(void * arg)
+{
+  GroupWorker * w = (GroupWorker *) arg;
+  GroupPool * pool = w->pool;
+
+  enif_mutex_lock(pool->lock);
+  for(;;){
+    while(pool->generation == w->seen && !pool->stop)
+      enif_cond_wait(pool->wake, pool->lock);
+    if(pool->stop) break;
+    w->seen = pool->generation;
+    Group * group = pool->job;
+    enif_mutex_unlock(pool->lock);
+
+    // Groups created before a code upgrade may have fewer slots
+    if(w->slot < group->num_slots) group_work(group, w->slot);
+
+    enif_mutex_lock(pool->lock);
+    if(--pool->busy == 0) enif_cond_signal(pool->done);
+  }
+  enif_mutex_unlock(pool->lock);
+  return NULL;
+}
+
+static void group_run(GroupPool * pool, Group * group)
+{
+  for(unsigned int s = 0; s < group->num_slots; s++){
+    uint32_t first = (uint64_t) s * group->num_voices / group->num_slots;
+    uint32_t end = (uint64_t) (s + 1) * group->num_voices / group->num_slots;
+    atomic_store(&group->slots[s].range, pack_range(first, end));
+    group->slots[s].used = 0;
+  }
+
+  // Fall back to rendering on the calling thread alone when the pool
+  // is busy with another group or there is nothing to share.
+  if(pool->num_threads == 0 || group->num_voices < 2
+     || enif_mutex_trylock(pool->dispatch) != 0) {
+    group_work(group, 0);
+    return;
+  }
+
+  enif_mutex_lock(pool->lock);
+  pool->job = group;
+  pool->generation++;
+  pool->busy = pool->num_threads;
+  enif_cond_broadcast(pool->wake);
+  enif_mutex_unlock(pool->lock);
+
+  group_work(group, 0);
+
+  enif_mutex_lock(pool->lock);
+  while(pool->busy > 0)
+    enif_cond_wait(pool->done, pool->lock);
+  pool->job = NULL;
+  enif_mutex_unlock(pool->lock);
+  enif_mutex_unlock(pool->dispatch);
+}
+
+/* ---------------------------------------------------------- */
+
+static ERL_NIF_TERM group_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  GroupPool * pool = (GroupPool *) enif_priv_data(env);
+  unsigned int len;
+  ERL_NIF_TERM list, head, tail;
+  const ERL_NIF_TERM * voice;
+  int arity;
+
+  if(!enif_get_list_length(env, argv[0], &len) || len == 0){
+    return enif_make_badarg(env);
+  }
+
+  Group * group = enif_alloc_resource(sc_group_type, sizeof(Group));
+  group->env = enif_alloc_env();
+  group->num_voices = len;
+  group->channels = 1;
+  group->voices = enif_alloc(len * sizeof(GroupVoice));
+  group->num_slots = pool->num_threads + 1;
+  group->slots = enif_alloc(group->num_slots * sizeof(GroupSlot));
+  group->bufsize = 0;
+  group->scratch = NULL;
+
+  list = argv[0];
+  for(unsigned int i = 0; enif_get_list_cell(env, list, &head, &tail); i++){
+    GroupVoice * gv = &group->voices[i];
+    if(!(enif_get_tuple(env, head, &arity, &voice) && arity == 2 &&
+         (gv->unit = sc_unit_from_handle(env, voice[0])) != NULL &&
+         gv->unit->num_inputs <= SC_MAX_CHANNELS &&
+         gv->unit->num_outputs > 0 && gv->unit->num_outputs <= SC_MAX_CHANNELS &&
+         sc_get_args(env, voice[1], gv->args))){
+      enif_release_resource(group);
+      return enif_make_badarg(env);
+    }
+    group->channels = sc_max(group->channels, gv->unit->num_outputs);
+    enif_make_copy(group->env, voice[0]);
+    list = tail;
+  }
+
+  ERL_NIF_TERM term = enif_make_resource(env, group);
+  enif_release_resource(group);
+  return term;
+}
+
+static void set_voice_inputs(GroupVoice * voice, float ** in, unsigned int channels)
+{
+  for(unsigned int c = 0; c < voice->unit->num_inputs; c++){
+    voice->in[c] = in[sc_min(c, channels - 1)];
+  }
+}
+
+static ERL_NIF_TERM group_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  GroupPool * pool = (GroupPool *) enif_priv_data(env);
+  Group * group;
+  ERL_NIF_TERM head, tail, out_term[SC_MAX_CHANNELS];
+  float * in[SC_MAX_CHANNELS];
+  unsigned int channels;
+  int inNumSamples = 0;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_group_type,
+                         (void**) &group)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  // A list of lists gives each voice its own input, otherwise all
+  // voices read the same binary or list of channel binaries.
+  if(enif_get_list_cell(env, argv[1], &head, &tail) && enif_is_list(env, head)){
+    unsigned int len;
+    ERL_NIF_TERM list = argv[1];
+    if(!enif_get_list_length(env, list, &len) || len != group->num_voices){
+      return enif_raise_exception(env,
+                                  enif_make_string(env,
+                                                   "One input per voice expected",
+                                                   ERL_NIF_LATIN1));
+    }
+    int voiceSamples = 0;
+    for(unsigned int v = 0; enif_get_list_cell(env, list, &head, &tail); v++){
+      if(!sc_get_channels(env, head, in, SC_MAX_CHANNELS, &channels, &inNumSamples) ||
+         (v > 0 && inNumSamples != voiceSamples)){
+        return enif_raise_exception(env,
+                                    enif_make_string(env,
+                                                     "Input streams not binaries of one length",
+                                                     ERL_NIF_LATIN1));
+      }
+      voiceSamples = inNumSamples;
+      set_voice_inputs(&group->voices[v], in, channels);
+      list = tail;
+    }
+  } else if(sc_get_channels(env, argv[1], in, SC_MAX_CHANNELS, &channels, &inNumSamples)){
+    for(unsigned int v = 0; v < group->num_voices; v++){
+      set_voice_inputs(&group->voices[v], in, channels);
+    }
+  } else {
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "Input stream not a binary nor a list of binaries of one length",
+                                                 ERL_NIF_LATIN1));
+  }
+
+  if(sc_dirty_needed((size_t) inNumSamples * group->num_voices / group->num_slots)){
+    return enif_schedule_nif(env, "group_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             group_next, argc, argv);
+  }
+
+  if(inNumSamples > group->bufsize) {
+    group->bufsize = inNumSamples;
+    group->scratch = enif_realloc(group->scratch,
+                                  group->num_slots * 2 * SC_MAX_CHANNELS
+                                  * group->bufsize * sizeof(float));
+  }
+  group->inNumSamples = inNumSamples;
+
+  group_run(pool, group);
+
+  for(unsigned int c = 0; c < group->channels; c++){
+    float * out = (float *) enif_make_new_binary(env, inNumSamples * sizeof(float),
+                                                 &out_term[c]);
+    memset(out, 0, inNumSamples * sizeof(float));
+    for(unsigned int s = 0; s < group->num_slots; s++){
+      if(!group->slots[s].used) continue;
+      float * acc = group->scratch + (s * 2 + 1) * SC_MAX_CHANNELS * group->bufsize
+        + c * group->bufsize;
+      for(int i = 0; i < inNumSamples; i++) out[i] += acc[i];
+    }
+  }
+
+  if (group->channels == 1){
+    return out_term[0];
+  } else {
+    return enif_make_list_from_array(env, out_term, group->channels);
+  }
+}
+
+static ERL_NIF_TERM group_set_args(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Group * group;
+  unsigned int index;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_group_type,
+                         (void**) &group)){
+    return enif_make_badarg(env);
+  }
+  if (!enif_get_uint(env, argv[1], &index) || index >= group->num_voices){
+    return enif_make_badarg(env);
+  }
+  if (!sc_get_args(env, argv[2], group->voices[index].args)){
+    return enif_make_badarg(env);
+  }
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM group_threads(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  GroupPool * pool = (GroupPool *) enif_priv_data(env);
+  return enif_make_uint(env, pool->num_threads);
+}
+
+/* ---------------------------------------------------------- */
+
+static void stop_pool(GroupPool * pool)
+{
+  enif_mutex_lock(pool->lock);
+  pool->stop = 1;
+  enif_cond_broadcast(pool->wake);
+  enif_mutex_unlock(pool->lock);
+  for(unsigned int i = 0; i < pool->num_threads; i++){
+    enif_thread_join(pool->workers[i].tid, NULL);
+  }
+  enif_cond_destroy(pool->done);
+  enif_cond_destroy(pool->wake);
+  enif_mutex_destroy(pool->lock);
+  enif_mutex_destroy(pool->dispatch);
+  enif_free(pool->workers);
+  enif_free(pool);
+}
+
+// Number of worker threads comes from load_info, 0 means one less
+// than the number of online cores, the calling thread being the last.
+static GroupPool * start_pool(ErlNifEnv* env, ERL_NIF_TERM load_info)
+{
+  unsigned int num_threads = 0;
+  if(!enif_get_uint(env, load_info, &num_threads) || num_threads == 0){
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cores > 1 ? cores - 1 : 0;
+  }
+
+  GroupPool * pool = enif_alloc(sizeof(GroupPool));
+  pool->num_threads = 0;
+  pool->workers = enif_alloc((num_threads > 0 ? num_threads : 1) * sizeof(GroupWorker));
+  pool->dispatch = enif_mutex_create("sc_group_dispatch");
+  pool->lock = enif_mutex_create("sc_group_lock");
+  pool->wake = enif_cond_create("sc_group_wake");
+  pool->done = enif_cond_create("sc_group_done");
+  pool->job = NULL;
+  pool->generation = 0;
+  pool->busy = 0;
+  pool->stop = 0;
+  for(unsigned int i = 0; i < num_threads; i++){
+    GroupWorker * w = &pool->workers[i];
+    w->pool = pool;
+    w->slot = i + 1;
+    w->seen = 0;
+    if(enif_thread_create("sc_group_worker", &w->tid, group_worker, w, NULL) != 0)
+      break;
+    pool->num_threads++;
+  }
+  return pool;
+}
+
+static ErlNifFunc nif_funcs[] = {
+  {"group_ctor", 1, group_ctor},
+  {"group_next", 2, group_next},
+  {"group_set_args", 3, group_set_args},
+  {"group_threads", 0, group_threads}
+};
+
+static int open_group_resource_type(ErlNifEnv* env)
+{
+  const char* mod = "Elixir.SC.Group";
+  const char* resource_type = "sc_group";
+  int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
+  sc_group_type =
+    enif_open_resource_type(env, mod, resource_type,
+                            group_resource_dtor, flags, NULL);
+  return ((sc_group_type == NULL) ? -1:0);
+}
+
+static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
+{
+  if(open_group_resource_type(caller_env) != 0) return -1;
+  *priv_data = start_pool(caller_env, load_info);
+  return 0;
+}
+
+static int upgrade(ErlNifEnv* caller_env, void** priv_data, void** old_priv_data,
+		   ERL_NIF_TERM load_info)
+{
+  if(open_group_resource_type(caller_env) != 0) return -1;
+  *priv_data = start_pool(caller_env, load_info);
+  return 0;
+}
+
+static void unload(ErlNifEnv* caller_env, void* priv_data)
+{
+  stop_pool((GroupPool *) priv_data);
+}
+
+
+ERL_NIF_INIT(Elixir.SC.Group, nif_funcs, load, NULL, upgrade, unload);
@@ -49,3 +49,1005 @@ static inline float cubicinterp(float x, float y0, float y1, float y2, float y3)
 #define sc_min(a, b) (((a) < (b)) ? (a) : (b))
 const double log001 = log(0.001);
 const double sqrt2 = sqrt(2.);
+
+/*  Memory accounting.
+
+    Each plugin library counts the live instances and bytes of each
+    of its plugin types in a static SCMemType table. A constructor
+    builds the resource, then charges its bytes to the type through the
+    SCMemTag of the resource. When the charge would take the type past
+    its budget it releases the resource again and returns
+    {error, budget_exceeded}. Bytes allocated later, e.g. the GVerb
+    lines on its first call, are added without checking the budget.
+    The tag gives the bytes back from the resource destructor.
+*/
+#include <stdatomic.h>
+
+typedef struct SCMemType {
+  const char * name;            // Plugin type atom
+  _Atomic long long instances;
+  _Atomic long long bytes;
+  _Atomic long long budget;     // Max bytes of the type, 0 for none
+} SCMemType;
+
+typedef struct SCMemTag {
+  SCMemType * type;             // NULL when not charged
+  size_t bytes;
+} SCMemTag;
+
+static inline int sc_mem_charge(SCMemTag * tag, SCMemType * type, size_t bytes) {
+  long long budget = atomic_load_explicit(&type->budget, memory_order_relaxed);
+  long long prev = atomic_fetch_add_explicit(&type->bytes, bytes, memory_order_relaxed);
+  if(budget > 0 && prev + (long long) bytes > budget) {
+    atomic_fetch_sub_explicit(&type->bytes, bytes, memory_order_relaxed);
+    return 0;
+  }
+  atomic_fetch_add_explicit(&type->instances, 1, memory_order_relaxed);
+  tag->type = type;
+  tag->bytes = bytes;
+  return 1;
+}
+
+static inline void sc_mem_grow(SCMemTag * tag, size_t bytes) {
+  if(tag->type == NULL) return;
+  atomic_fetch_add_explicit(&tag->type->bytes, bytes, memory_order_relaxed);
+  tag->bytes += bytes;
+}
+
+static inline void sc_mem_release(SCMemTag * tag) {
+  if(tag->type == NULL) return;
+  atomic_fetch_sub_explicit(&tag->type->bytes, tag->bytes, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&tag->type->instances, 1, memory_order_relaxed);
+  tag->type = NULL;
+}
+
+static inline ERL_NIF_TERM sc_budget_exceeded(ErlNifEnv* env) {
+  return enif_make_tuple2(env, enif_make_atom(env, "error"),
+                          enif_make_atom(env, "budget_exceeded"));
+}
+
+static inline SCMemType * sc_mem_find(SCMemType * types, unsigned int n, const char * name) {
+  for(unsigned int i = 0; i < n; i++) {
+    if(strcmp(types[i].name, name) == 0) return &types[i];
+  }
+  return NULL;
+}
+
+// #{Type => #{instances, bytes, budget}} of the n types
+static inline ERL_NIF_TERM sc_mem_stats(ErlNifEnv* env, SCMemType * types, unsigned int n) {
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  ERL_NIF_TERM keys[] = {
+    enif_make_atom(env, "instances"), enif_make_atom(env, "bytes"),
+    enif_make_atom(env, "budget")
+  };
+  for(unsigned int i = 0; i < n; i++) {
+    long long budget = atomic_load_explicit(&types[i].budget, memory_order_relaxed);
+    ERL_NIF_TERM values[] = {
+      enif_make_int64(env, atomic_load_explicit(&types[i].instances, memory_order_relaxed)),
+      enif_make_int64(env, atomic_load_explicit(&types[i].bytes, memory_order_relaxed)),
+      budget > 0 ? enif_make_int64(env, budget) : enif_make_atom(env, "infinity")
+    };
+    ERL_NIF_TERM type;
+    enif_make_map_from_arrays(env, keys, values, 3, &type);
+    enif_make_map_put(env, map, enif_make_atom(env, types[i].name), type, &map);
+  }
+  return map;
+}
+
+// memory_budget(Type, Bytes | infinity), error when the library has
+// no such type
+static inline ERL_NIF_TERM sc_mem_budget(ErlNifEnv* env, SCMemType * types, unsigned int n,
+                                         const ERL_NIF_TERM argv[]) {
+  char name[16];
+  ErlNifSInt64 budget;
+  SCMemType * type;
+  if(!enif_get_atom(env, argv[0], name, sizeof(name), ERL_NIF_LATIN1)) {
+    return enif_make_badarg(env);
+  }
+  if(enif_is_identical(argv[1], enif_make_atom(env, "infinity"))) {
+    budget = 0;
+  } else if(!enif_get_int64(env, argv[1], &budget) || budget <= 0) {
+    return enif_make_badarg(env);
+  }
+  if((type = sc_mem_find(types, n, name)) == NULL) {
+    return enif_make_atom(env, "error");
+  }
+  atomic_store_explicit(&type->budget, budget, memory_order_relaxed);
+  return enif_make_atom(env, "ok");
+}
+
+/*  Unit handles.
+
+    Every plugin resource starts with an SCUnit head. The handle of a
+    unit is its resource term. Resource types of units are opened with
+    sc_open_unit_type, which gives them a dyncall callback handing out
+    the head, and another NIF library, e.g. sc_chain, gets the head of
+    a handle with enif_dynamic_resource_call (OTP 24) against the unit
+    types in sc_unit_types. The VM checks that the term is a resource
+    of that type, a handle cannot be built or copied from Erlang. The
+    term keeps the owning resource alive for as long as it is
+    referenced.
+*/
+#define SC_UNIT_MAGIC 0x53435547
+#define SC_MAX_CHANNELS 2
+#define SC_MAX_ARGS 16
+
+struct SCBind;
+struct SCRing;
+
+typedef struct SCUnit {
+  unsigned int magic;
+  unsigned int num_inputs, num_outputs, num_args;
+  void (*calc)(struct SCUnit *, float ** out, float ** in, double * args, int inNumSamples);
+  struct SCBind * _Atomic binds;  // NULL or num_args control bus bindings, see sc_bus_args
+  struct SCBus ** held;   // Buses ever bound, kept alive until the unit goes
+  unsigned int num_held;
+  const char * const * names;   // num_args parameter names, see sc_set_params
+  double params[SC_MAX_ARGS];   // Sticky parameters used by the process NIFs
+  struct SCRing * ring;   // NULL or output blocks, see sc_make_output
+  SCMemTag mem;           // Memory accounting, see sc_mem_charge
+} SCUnit;
+
+static inline void sc_unit_init(SCUnit * sc, unsigned int num_inputs,
+                                unsigned int num_outputs, unsigned int num_args,
+                                void (*calc)(SCUnit *, float **, float **, double *, int)) {
+  sc->magic = SC_UNIT_MAGIC;
+  sc->num_inputs = num_inputs;
+  sc->num_outputs = num_outputs;
+  sc->num_args = num_args;
+  sc->calc = calc;
+  atomic_init(&sc->binds, NULL);
+  sc->held = NULL;
+  sc->num_held = 0;
+  sc->names = NULL;
+  memset(sc->params, 0, sizeof(sc->params));
+  sc->ring = NULL;
+  sc->mem.type = NULL;
+}
+
+static inline ERL_NIF_TERM sc_unit_handle(ErlNifEnv* env, SCUnit * sc) {
+  return enif_make_resource(env, sc);
+}
+
+// ErlNifResourceDynCall of unit types, call_data is an SCUnit **
+static inline void sc_unit_dyncall(ErlNifEnv* env, void * obj, void * call_data) {
+  *(SCUnit **) call_data = (SCUnit *) obj;
+}
+
+static inline ErlNifResourceType * sc_open_unit_type(ErlNifEnv* env, const char * name,
+                                                     ErlNifResourceDtor * dtor,
+                                                     ErlNifResourceFlags flags) {
+  ErlNifResourceTypeInit init = {
+    .dtor = dtor, .stop = NULL, .down = NULL, .members = 4, .dyncall = &sc_unit_dyncall
+  };
+  return enif_init_resource_type(env, name, &init, flags, NULL);
+}
+
+// Module and resource type of the libraries handing out unit handles
+static const char * const sc_unit_types[][2] = {
+  {"Elixir.SC.Filter", "sc_filter"},
+  {"Elixir.SC.Reverb", "sc_reverb"},
+  {"Elixir.SC.Reverb.AnalogEcho", "analog_echo"},
+  {"Elixir.SC.Chain", "sc_chain"},
+  {"Elixir.SC.Graph", "sc_graph"}
+};
+
+static inline SCUnit * sc_unit_from_handle(ErlNifEnv* env, ERL_NIF_TERM term) {
+  SCUnit * sc = NULL;
+  if(!enif_is_ref(env, term)) {
+    return NULL;
+  }
+  for(unsigned int i = 0; i < sizeof(sc_unit_types) / sizeof(sc_unit_types[0]); i++) {
+    if(enif_dynamic_resource_call(env, enif_make_atom(env, sc_unit_types[i][0]),
+                                  enif_make_atom(env, sc_unit_types[i][1]),
+                                  term, &sc) == 0) {
+      return (sc != NULL && sc->magic == SC_UNIT_MAGIC) ? sc : NULL;
+    }
+  }
+  return NULL;
+}
+
+/*  Control buses.
+
+    A control bus (sc_bus.c) is a resource holding an array of floats
+    updated atomically from any process. Any parameter slot of a unit
+    can be bound to a bus index, the calc function then reads the slot
+    from the bus at the start of every call instead of from args.
+    Units may be running on another thread (SC.Ahead, SC.Group, a
+    dirty scheduler) while they are bound, rebound or unbound, so a
+    binding is read with atomic loads and a bus once bound to a unit is
+    kept alive in held until the unit goes, not when it is unbound.
+    Units call sc_unit_release from their resource destructor.
+*/
+
+#define SC_BUS_MAGIC 0x53434253
+
+typedef struct SCBus {
+  unsigned int magic;
+  unsigned int size;
+  _Atomic float values[];
+} SCBus;
+
+typedef struct SCBind {
+  SCBus * _Atomic bus;    // NULL when the slot is not bound
+  _Atomic unsigned int index;
+} SCBind;
+
+static inline void sc_bus_args(SCUnit * sc, double * args) {
+  SCBind * binds = atomic_load_explicit(&sc->binds, memory_order_acquire);
+  if(binds == NULL) return;
+  for(unsigned int i = 0; i < sc->num_args; i++) {
+    SCBus * bus = atomic_load_explicit(&binds[i].bus, memory_order_acquire);
+    if(bus == NULL) continue;
+    // A rebind racing this call may pair the index with the old bus
+    unsigned int index = atomic_load_explicit(&binds[i].index, memory_order_relaxed);
+    if(index < bus->size) args[i] = atomic_load_explicit(&bus->values[index],
+                                                         memory_order_relaxed);
+  }
+}
+
+// Also frees the output ring, blocks keep the unit alive so none is
+// referenced any more when the unit goes.
+static inline void sc_unit_release(SCUnit * sc) {
+  sc_mem_release(&sc->mem);
+  if(sc->ring) {
+    enif_free(sc->ring);
+    sc->ring = NULL;
+  }
+  for(unsigned int i = 0; i < sc->num_held; i++) {
+    enif_release_resource(sc->held[i]);
+  }
+  if(sc->held) enif_free(sc->held);
+  sc->held = NULL;
+  sc->num_held = 0;
+  SCBind * binds = atomic_load(&sc->binds);
+  if(binds) enif_free(binds);
+  atomic_store(&sc->binds, NULL);
+}
+
+/*  SIMD lanes.
+
+    GCC/clang vector extensions. With -mavx an sc_v4d is one AVX
+    register, without it the compiler splits it into SSE2 pairs.
+*/
+#define SC_LANES 4
+
+typedef double sc_v4d __attribute__((vector_size(4 * sizeof(double))));
+typedef long long sc_v4di __attribute__((vector_size(4 * sizeof(long long))));
+
+// Four float lanes, one SSE register
+typedef float sc_v4f __attribute__((vector_size(4 * sizeof(float))));
+typedef int sc_v4i __attribute__((vector_size(4 * sizeof(int))));
+
+// Eight float lanes, one AVX register
+typedef float sc_v8f __attribute__((vector_size(8 * sizeof(float))));
+typedef int sc_v8i __attribute__((vector_size(8 * sizeof(int))));
+
+// Lane wise a > b ? x : y. A macro, vectors passed by value to a
+// function change the ABI when built without -mavx.
+#define sc_v4d_select_gt(a, b, x, y)                                    \
+  ((sc_v4d) ((((sc_v4di) (x)) & ((a) > (b))) | (((sc_v4di) (y)) & ~((a) > (b)))))
+
+// Pointer rounded up to the vector alignment
+static inline void * sc_align(void * p) {
+  return (void *) (((size_t) p + sizeof(sc_v4d) - 1) & ~(sizeof(sc_v4d) - 1));
+}
+
+#define SC_CACHE_LINE 64
+
+// Pointer rounded up to a cache line
+static inline void * sc_align_cache(void * p) {
+  return (void *) (((size_t) p + SC_CACHE_LINE - 1) & ~(size_t) (SC_CACHE_LINE - 1));
+}
+
+/*  Delay memory.
+
+    Delay lines of reverbs and echoes are taken from a pool of mmap'd
+    regions instead of the VM heap when huge pages are enabled (the
+    :huge_pages application environment, passed as load_info). A
+    region is first mapped with MAP_HUGETLB, which needs pages
+    reserved by the admin, then as normal pages aligned to
+    SC_HUGE_PAGE with madvise(MADV_HUGEPAGE) for transparent huge
+    pages. With neither, or when huge pages are off, blocks come from
+    enif_alloc.
+
+    Blocks are rounded up to power of two size classes, header
+    included, and carved from the current region. A freed block goes
+    to the free list of its class and is reused by any request of that
+    class. When a new region is mapped the rest of the current one is
+    split into blocks on the free lists. A region is unmapped once all
+    its blocks are free, the current one is kept and carved again.
+    Blocks larger than half a region get a region of their own, in
+    SC_HUGE_PAGE multiples, unmapped when freed. Each library
+    including this header has its own pool and counters.
+*/
+#include <sys/mman.h>
+
+#define SC_HUGE_PAGE (2UL << 20)
+#define SC_DELAY_MIN_SHIFT 7    // Smallest class, 128 bytes
+#define SC_DELAY_MAX_SHIFT 20   // Largest class carved from a shared region
+#define SC_DELAY_CLASSES (SC_DELAY_MAX_SHIFT - SC_DELAY_MIN_SHIFT + 1)
+
+typedef struct SCDelayRegion {
+  size_t bytes;                 // Mapped bytes
+  size_t live;                  // Blocks in use
+  int huge;                     // Backed by huge pages
+} SCDelayRegion;                // Padded to SC_CACHE_LINE at the region start
+
+typedef struct SCDelayBlock {
+  size_t bytes;                 // Usable bytes after the header
+  struct SCDelayBlock * next;   // Free list
+  SCDelayRegion * region;       // NULL from enif_alloc
+  int shift;                    // Size class, 0 for an own region
+  int huge;                     // Region backed by huge pages
+} SCDelayBlock;                 // Padded to SC_CACHE_LINE in front of the block
+
+typedef struct SCDelayStats {
+  size_t instances;       // Live blocks
+  size_t huge_instances;  // Live blocks backed by huge pages
+  size_t regions;         // Regions mapped
+  size_t region_bytes;
+  size_t huge_bytes;      // Region bytes backed by huge pages
+} SCDelayStats;
+
+static int sc_delay_huge = 0;
+static atomic_flag sc_delay_lock = ATOMIC_FLAG_INIT;
+static SCDelayRegion * sc_delay_region = NULL;   // Current region
+static char * sc_delay_next = NULL;              // Free part of the current region
+static char * sc_delay_end = NULL;
+static SCDelayBlock * sc_delay_free_lists[SC_DELAY_CLASSES];
+static SCDelayStats sc_delay_stats;
+
+static inline void sc_delay_lock_take(void) {
+  while(atomic_flag_test_and_set_explicit(&sc_delay_lock, memory_order_acquire));
+}
+
+static inline void sc_delay_lock_give(void) {
+  atomic_flag_clear_explicit(&sc_delay_lock, memory_order_release);
+}
+
+// Map bytes, a multiple of SC_HUGE_PAGE, NULL on failure
+static inline char * sc_delay_map(size_t bytes, int * huge) {
+  char * p;
+#ifdef MAP_HUGETLB
+  p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if(p != MAP_FAILED) {
+    *huge = 1;
+    return p;
+  }
+#endif
+  // One page more to align the region to a huge page
+  p = mmap(NULL, bytes + SC_HUGE_PAGE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(p == MAP_FAILED) return NULL;
+  char * a = (char *) (((size_t) p + SC_HUGE_PAGE - 1) & ~(SC_HUGE_PAGE - 1));
+  if(a > p) munmap(p, a - p);
+  munmap(a + bytes, p + SC_HUGE_PAGE - a);
+#ifdef MADV_HUGEPAGE
+  *huge = (madvise(a, bytes, MADV_HUGEPAGE) == 0);
+#else
+  *huge = 0;
+#endif
+  return a;
+}
+
+// A new region of bytes with its header, NULL on failure. Lock held.
+static inline SCDelayRegion * sc_delay_region_new(size_t bytes) {
+  int huge;
+  SCDelayRegion * r = (SCDelayRegion *) sc_delay_map(bytes, &huge);
+  if(r == NULL) return NULL;
+  r->bytes = bytes;
+  r->live = 0;
+  r->huge = huge;
+  sc_delay_stats.regions++;
+  sc_delay_stats.region_bytes += bytes;
+  if(huge) sc_delay_stats.huge_bytes += bytes;
+  return r;
+}
+
+// Lock held
+static inline void sc_delay_region_unmap(SCDelayRegion * r) {
+  sc_delay_stats.regions--;
+  sc_delay_stats.region_bytes -= r->bytes;
+  if(r->huge) sc_delay_stats.huge_bytes -= r->bytes;
+  munmap(r, r->bytes);
+}
+
+// A block of class shift at p in region r. Lock held.
+static inline SCDelayBlock * sc_delay_block(char * p, SCDelayRegion * r, int shift) {
+  SCDelayBlock * b = (SCDelayBlock *) p;
+  b->bytes = ((size_t) 1 << shift) - SC_CACHE_LINE;
+  b->region = r;
+  b->shift = shift;
+  b->huge = r->huge;
+  return b;
+}
+
+// Split the rest of the current region into free blocks. Lock held.
+static inline void sc_delay_split_rest(void) {
+  size_t rest;
+  while((rest = sc_delay_end - sc_delay_next) >= ((size_t) 1 << SC_DELAY_MIN_SHIFT)) {
+    int shift = sc_min(63 - __builtin_clzl(rest), SC_DELAY_MAX_SHIFT);
+    SCDelayBlock * b = sc_delay_block(sc_delay_next, sc_delay_region, shift);
+    b->next = sc_delay_free_lists[shift - SC_DELAY_MIN_SHIFT];
+    sc_delay_free_lists[shift - SC_DELAY_MIN_SHIFT] = b;
+    sc_delay_next += (size_t) 1 << shift;
+  }
+}
+
+// Drop the free blocks of region r from the free lists. Lock held.
+static inline void sc_delay_purge(SCDelayRegion * r) {
+  for(int c = 0; c < SC_DELAY_CLASSES; c++) {
+    for(SCDelayBlock ** f = &sc_delay_free_lists[c]; *f; ) {
+      if((*f)->region == r) *f = (*f)->next;
+      else f = &(*f)->next;
+    }
+  }
+}
+
+// A block of class shift from the free lists or the current region,
+// NULL when no region can be mapped. Lock held.
+static inline SCDelayBlock * sc_delay_carve(int shift) {
+  SCDelayBlock ** f = &sc_delay_free_lists[shift - SC_DELAY_MIN_SHIFT];
+  SCDelayBlock * b = *f;
+  if(b) {
+    *f = b->next;
+  } else {
+    size_t size = (size_t) 1 << shift;
+    if((size_t) (sc_delay_end - sc_delay_next) < size) {
+      SCDelayRegion * r = sc_delay_region_new(SC_HUGE_PAGE);
+      if(r == NULL) return NULL;
+      if(sc_delay_region) sc_delay_split_rest();
+      sc_delay_region = r;
+      sc_delay_next = (char *) r + SC_CACHE_LINE;
+      sc_delay_end = (char *) r + r->bytes;
+    }
+    b = sc_delay_block(sc_delay_next, sc_delay_region, shift);
+    sc_delay_next += size;
+  }
+  b->region->live++;
+  return b;
+}
+
+// A block in a region of its own, NULL on failure. Lock held.
+static inline SCDelayBlock * sc_delay_own(size_t bytes) {
+  size_t size = (2 * SC_CACHE_LINE + bytes + SC_HUGE_PAGE - 1) & ~(SC_HUGE_PAGE - 1);
+  SCDelayRegion * r = sc_delay_region_new(size);
+  if(r == NULL) return NULL;
+  r->live = 1;
+  SCDelayBlock * b = (SCDelayBlock *) ((char *) r + SC_CACHE_LINE);
+  b->bytes = size - 2 * SC_CACHE_LINE;
+  b->region = r;
+  b->shift = 0;
+  b->huge = r->huge;
+  return b;
+}
+
+// bytes of delay memory, cache line aligned when from a region, not
+// cleared. Free with sc_delay_free.
+static inline void * sc_delay_alloc(size_t bytes) {
+  SCDelayBlock * b = NULL;
+  bytes = (bytes + SC_CACHE_LINE - 1) & ~(size_t) (SC_CACHE_LINE - 1);
+  sc_delay_lock_take();
+  if(sc_delay_huge) {
+    size_t need = SC_CACHE_LINE + bytes;
+    if(need <= ((size_t) 1 << SC_DELAY_MAX_SHIFT)) {
+      int shift = sc_max(64 - __builtin_clzl(need - 1), SC_DELAY_MIN_SHIFT);
+      b = sc_delay_carve(shift);
+    } else {
+      b = sc_delay_own(bytes);
+    }
+  }
+  if(b == NULL) {
+    b = enif_alloc(SC_CACHE_LINE + bytes);
+    b->bytes = bytes;
+    b->region = NULL;
+    b->shift = 0;
+    b->huge = 0;
+  }
+  sc_delay_stats.instances++;
+  if(b->huge) sc_delay_stats.huge_instances++;
+  sc_delay_lock_give();
+  return (char *) b + SC_CACHE_LINE;
+}
+
+static inline void sc_delay_free(void * p) {
+  SCDelayBlock * b = (SCDelayBlock *) ((char *) p - SC_CACHE_LINE);
+  SCDelayRegion * r = b->region;
+  sc_delay_lock_take();
+  sc_delay_stats.instances--;
+  if(b->huge) sc_delay_stats.huge_instances--;
+  if(r && b->shift) {
+    b->next = sc_delay_free_lists[b->shift - SC_DELAY_MIN_SHIFT];
+    sc_delay_free_lists[b->shift - SC_DELAY_MIN_SHIFT] = b;
+  }
+  if(r && --r->live == 0) {
+    if(b->shift) sc_delay_purge(r);
+    if(r == sc_delay_region) {
+      sc_delay_next = (char *) r + SC_CACHE_LINE;
+    } else {
+      sc_delay_region_unmap(r);
+    }
+  }
+  sc_delay_lock_give();
+  if(r == NULL) enif_free(b);
+}
+
+// Enable the pool from load_info, 1 for huge pages
+static inline void sc_delay_load(ErlNifEnv* env, ERL_NIF_TERM load_info) {
+  int huge;
+  if(enif_get_int(env, load_info, &huge)) sc_delay_huge = (huge != 0);
+}
+
+// The counters as a map
+static inline ERL_NIF_TERM sc_delay_stats_term(ErlNifEnv* env) {
+  SCDelayStats st;
+  sc_delay_lock_take();
+  st = sc_delay_stats;
+  sc_delay_lock_give();
+  ERL_NIF_TERM keys[] = {
+    enif_make_atom(env, "instances"), enif_make_atom(env, "huge_instances"),
+    enif_make_atom(env, "regions"), enif_make_atom(env, "region_bytes"),
+    enif_make_atom(env, "huge_bytes")
+  };
+  ERL_NIF_TERM values[] = {
+    enif_make_uint64(env, st.instances), enif_make_uint64(env, st.huge_instances),
+    enif_make_uint64(env, st.regions), enif_make_uint64(env, st.region_bytes),
+    enif_make_uint64(env, st.huge_bytes)
+  };
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, values, 5, &map);
+  return map;
+}
+
+/*  Delay storage.
+
+    Delay lines may hold their samples as float16 or as int16 scaled
+    to +-SC_I16_RANGE instead of float32, halving the bytes a reverb or
+    echo moves per sample. float16 keeps a relative precision of 2^-11
+    at any level, int16 a fixed step and saturates. Kernels read and
+    write lines through sc_load and sc_store with the storage a compile
+    time constant, so each storage gets its own kernel without branches
+    in the loop.
+    float16 uses F16C when built for it (-mf16c or -march=native),
+    else a bit exact software conversion, several times slower.
+*/
+#include <stdint.h>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+#define SC_STORE_F32 0
+#define SC_STORE_F16 1
+#define SC_STORE_I16 2
+
+#ifndef SC_I16_RANGE
+#define SC_I16_RANGE 4.f
+#endif
+
+#define sc_always_inline inline __attribute__((always_inline))
+
+// Storage from the atoms float32, float16 and int16
+static inline int sc_get_storage(ErlNifEnv* env, ERL_NIF_TERM term, int * storage) {
+  char name[8];
+  if(!enif_get_atom(env, term, name, sizeof(name), ERL_NIF_LATIN1)) return 0;
+  if(strcmp(name, "float32") == 0) *storage = SC_STORE_F32;
+  else if(strcmp(name, "float16") == 0) *storage = SC_STORE_F16;
+  else if(strcmp(name, "int16") == 0) *storage = SC_STORE_I16;
+  else return 0;
+  return 1;
+}
+
+static inline size_t sc_storage_size(int storage) {
+  return (storage == SC_STORE_F32) ? sizeof(float) : sizeof(uint16_t);
+}
+
+// Round to nearest even, after F. Giesen's float_to_half_fast3_rtne
+static inline uint16_t sc_f32_to_f16(float f) {
+#ifdef __F16C__
+  return _cvtss_sh(f, 0);
+#else
+  union { float f; uint32_t u; } v = { f };
+  union { uint32_t u; float f; } denorm_magic = { ((127 - 15) + (23 - 10) + 1) << 23 };
+  uint32_t sign = v.u & 0x80000000u;
+  uint16_t o;
+  v.u ^= sign;
+  if(v.u >= (127u + 16) << 23) {
+    o = (v.u > 255u << 23) ? 0x7e00 : 0x7c00;  // NaN or Inf
+  } else if(v.u < 113u << 23) {
+    v.f += denorm_magic.f;                     // Subnormal half or zero
+    o = (uint16_t) (v.u - denorm_magic.u);
+  } else {
+    uint32_t mant_odd = (v.u >> 13) & 1;
+    v.u += ((uint32_t) (15 - 127) << 23) + 0xfff;
+    v.u += mant_odd;
+    o = (uint16_t) (v.u >> 13);
+  }
+  return o | (uint16_t) (sign >> 16);
+#endif
+}
+
+static inline float sc_f16_to_f32(uint16_t h) {
+#ifdef __F16C__
+  return _cvtsh_ss(h);
+#else
+  union { uint32_t u; float f; } o, magic = { 113u << 23 };
+  const uint32_t shifted_exp = 0x7c00u << 13;
+  o.u = (h & 0x7fffu) << 13;
+  uint32_t exp = shifted_exp & o.u;
+  o.u += (uint32_t) (127 - 15) << 23;
+  if(exp == shifted_exp) {
+    o.u += (uint32_t) (128 - 16) << 23;   // Inf or NaN
+  } else if(exp == 0) {
+    o.u += 1 << 23;                        // Subnormal
+    o.f -= magic.f;
+  }
+  o.u |= (uint32_t) (h & 0x8000u) << 16;
+  return o.f;
+#endif
+}
+
+static sc_always_inline float sc_load(const void * line, int i, const int storage) {
+  switch(storage) {
+  case SC_STORE_F16:
+    return sc_f16_to_f32(((const uint16_t *) line)[i]);
+  case SC_STORE_I16:
+    return ((const int16_t *) line)[i] * (SC_I16_RANGE / 32767.f);
+  default:
+    return ((const float *) line)[i];
+  }
+}
+
+static sc_always_inline void sc_store(void * line, int i, float x, const int storage) {
+  switch(storage) {
+  case SC_STORE_F16:
+    ((uint16_t *) line)[i] = sc_f32_to_f16(x);
+    break;
+  case SC_STORE_I16:
+    x *= 32767.f / SC_I16_RANGE;
+    x = (x > 32767.f) ? 32767.f : ((x < -32767.f) ? -32767.f : x);
+    ((int16_t *) line)[i] = (int16_t) (x + ((x < 0.f) ? -0.5f : 0.5f));
+    break;
+  default:
+    ((float *) line)[i] = x;
+  }
+}
+
+/*  Output block rings.
+
+    A unit may own a ring of up to SC_RING_MAX aligned output blocks
+    (set up by sc_buffer.c). An output binary is then a resource binary
+    on a small block resource pointing into the ring instead of a new
+    refc binary, the block goes back to the ring from the block
+    destructor when the BEAM drops the last reference. Each block keeps
+    the unit alive. When all blocks are taken, or the output is longer
+    than a block, the output falls back to enif_make_new_binary.
+*/
+#define SC_RING_MAX 64
+
+typedef struct SCRing {
+  ErlNifResourceType * block_type;  // Opened by the library setting up the ring
+  unsigned int depth;
+  size_t block_size;                // Bytes per block, a multiple of the alignment
+  _Atomic unsigned long long free;  // Bit i set when block i is free
+  float * blocks;                   // depth blocks, aligned
+} SCRing;
+
+typedef struct SCBlock {
+  SCUnit * unit;
+  unsigned int index;
+} SCBlock;
+
+static inline float * sc_make_output(ErlNifEnv* env, SCUnit * sc, size_t bytes,
+                                     ERL_NIF_TERM * term) {
+  SCRing * ring = sc->ring;
+  if(ring && bytes <= ring->block_size) {
+    unsigned long long free = atomic_load_explicit(&ring->free, memory_order_acquire);
+    while(free) {
+      unsigned int i = __builtin_ctzll(free);
+      if(atomic_compare_exchange_weak_explicit(&ring->free, &free, free & ~(1ULL << i),
+                                               memory_order_acquire, memory_order_acquire)) {
+        SCBlock * block = enif_alloc_resource(ring->block_type, sizeof(SCBlock));
+        float * data = ring->blocks + i * (ring->block_size / sizeof(float));
+        block->unit = sc;
+        block->index = i;
+        enif_keep_resource(sc);
+        *term = enif_make_resource_binary(env, block, data, bytes);
+        enif_release_resource(block);
+        return data;
+      }
+    }
+  }
+  return (float *) enif_make_new_binary(env, bytes, term);
+}
+
+// ErlNifResourceDtor of the block type
+static inline void sc_block_dtor(ErlNifEnv* env, void * obj) {
+  SCBlock * block = (SCBlock *) obj;
+  atomic_fetch_or_explicit(&block->unit->ring->free, 1ULL << block->index,
+                           memory_order_release);
+  enif_release_resource(block->unit);
+}
+
+/*  Dirty scheduling.
+
+    A call rendering more than SC_DIRTY_SAMPLES samples (times stages
+    or voices) would block a normal scheduler far beyond 1 ms, e.g. a
+    10 s buffer processed offline. Such a call is rescheduled with the
+    same arguments on a dirty CPU scheduler. The calling process waits
+    for the result, the unit state carries on exactly as if the call
+    had run where it was made.
+*/
+#define SC_DIRTY_SAMPLES 16384
+
+static inline int sc_dirty_needed(size_t samples) {
+  return samples > SC_DIRTY_SAMPLES && enif_thread_type() == ERL_NIF_THR_NORMAL_SCHEDULER;
+}
+
+/*  Sub-blocking.
+
+    Parameter changes are interpolated over one control period, the
+    period_size given to the constructor. A longer binary is rendered
+    period by period so it sounds as if the unit was called once per
+    period, only the first period ramps to new parameter values.
+*/
+typedef void (*SCBlockFun)(SCUnit *, float ** out, float ** in, double * args, int inNumSamples);
+
+static inline void sc_subblocks(SCUnit * sc, SCBlockFun block, float ** out, float ** in,
+                                double * args, int inNumSamples, int period) {
+  if(period < 1 || inNumSamples <= period) {
+    (*block)(sc, out, in, args, inNumSamples);
+    return;
+  }
+  float * o[SC_MAX_CHANNELS];
+  float * i[SC_MAX_CHANNELS];
+  for(int offset = 0; offset < inNumSamples; offset += period) {
+    for(unsigned int c = 0; c < sc->num_outputs; c++) o[c] = out[c] + offset;
+    for(unsigned int c = 0; c < sc->num_inputs; c++) i[c] = in[c] + offset;
+    (*block)(sc, o, i, args, sc_min(period, inNumSamples - offset));
+  }
+}
+
+/*  Parameter events.
+
+    An event sets control parameter index (an index into the args the
+    unit handle is run with, see the unit/1 callbacks) to value from
+    sample offset on. The block is split at the event offsets and each
+    segment is run through the unit calc function, so a change lands
+    on its exact sample and is smoothed by the ramping of the unit just
+    like a change between two calls.
+
+    Events come as a list of {offset, index, value} tuples or as a
+    packed binary of native endian <<offset:32, index:32, value:64/float>>
+    records, in offset order.
+*/
+typedef struct SCEvent {
+  int offset;
+  unsigned int index;
+  double value;
+} SCEvent;
+
+// Parse events for a block of inNumSamples into an enif_alloc:ed
+// array, *events is NULL when there are none. Returns 0 on a bad event.
+static inline int sc_get_events(ErlNifEnv* env, ERL_NIF_TERM term, SCUnit * sc,
+                                int inNumSamples, SCEvent ** events,
+                                unsigned int * num_events) {
+  ErlNifBinary bin;
+  *events = NULL;
+  *num_events = 0;
+  if(enif_inspect_binary(env, term, &bin)) {
+    if(bin.size % sizeof(SCEvent) != 0) return 0;
+    *num_events = bin.size / sizeof(SCEvent);
+    if(*num_events == 0) return 1;
+    *events = enif_alloc(bin.size);
+    memcpy(*events, bin.data, bin.size);
+  } else {
+    ERL_NIF_TERM list = term, head, tail;
+    const ERL_NIF_TERM * tuple;
+    int arity;
+    unsigned int len;
+    if(!enif_get_list_length(env, term, &len)) return 0;
+    if(len == 0) return 1;
+    *events = enif_alloc(len * sizeof(SCEvent));
+    for(unsigned int e = 0; enif_get_list_cell(env, list, &head, &tail); e++) {
+      SCEvent * ev = &(*events)[e];
+      if(!(enif_get_tuple(env, head, &arity, &tuple) && arity == 3 &&
+           enif_get_int(env, tuple[0], &ev->offset) &&
+           enif_get_uint(env, tuple[1], &ev->index) &&
+           enif_get_double(env, tuple[2], &ev->value))) {
+        enif_free(*events);
+        *events = NULL;
+        return 0;
+      }
+      list = tail;
+    }
+    *num_events = len;
+  }
+  for(unsigned int e = 0; e < *num_events; e++) {
+    SCEvent * ev = &(*events)[e];
+    if(ev->offset < 0 || ev->offset >= inNumSamples || ev->index >= sc->num_args ||
+       (e > 0 && ev->offset < (ev - 1)->offset)) {
+      enif_free(*events);
+      *events = NULL;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static inline void sc_calc_events(SCUnit * sc, float ** out, float ** in, double * args,
+                                  int inNumSamples, const SCEvent * events,
+                                  unsigned int num_events) {
+  float * o[SC_MAX_CHANNELS];
+  float * i[SC_MAX_CHANNELS];
+  unsigned int e = 0;
+  int offset = 0;
+  while(offset < inNumSamples) {
+    for(; e < num_events && events[e].offset <= offset; e++) {
+      args[events[e].index] = events[e].value;
+    }
+    int end = (e < num_events) ? events[e].offset : inNumSamples;
+    for(unsigned int c = 0; c < sc->num_outputs; c++) o[c] = out[c] + offset;
+    for(unsigned int c = 0; c < sc->num_inputs; c++) i[c] = in[c] + offset;
+    (*sc->calc)(sc, o, i, args, end - offset);
+    offset = end;
+  }
+}
+
+static inline ERL_NIF_TERM sc_raise(ErlNifEnv* env, const char * reason) {
+  return enif_raise_exception(env, enif_make_string(env, reason, ERL_NIF_LATIN1));
+}
+
+// A list of at most SC_MAX_ARGS floats into args, zero padded
+static inline int sc_get_args(ErlNifEnv* env, ERL_NIF_TERM list, double * args) {
+  ERL_NIF_TERM head, tail;
+  unsigned int i = 0;
+  memset(args, 0, SC_MAX_ARGS * sizeof(double));
+  while(enif_get_list_cell(env, list, &head, &tail)) {
+    if(i == SC_MAX_ARGS || !enif_get_double(env, head, &args[i])) {
+      return 0;
+    }
+    list = tail;
+    i++;
+  }
+  return 1;
+}
+
+// Frames, a binary or a list of 1 to max channel binaries of one
+// length, into in. The units read each channel for inNumSamples.
+static inline int sc_get_channels(ErlNifEnv* env, ERL_NIF_TERM term, float ** in,
+                                  unsigned int max, unsigned int * channels,
+                                  int * inNumSamples) {
+  ErlNifBinary in_bin;
+  ERL_NIF_TERM head, tail;
+
+  *channels = 0;
+  if(enif_inspect_binary(env, term, &in_bin)) {
+    *inNumSamples = in_bin.size / sizeof(float);
+    in[(*channels)++] = (float *) in_bin.data;
+    return max > 0;
+  }
+  while(enif_get_list_cell(env, term, &head, &tail)) {
+    if(*channels == max || !enif_inspect_binary(env, head, &in_bin)) {
+      return 0;
+    }
+    if(*channels > 0 && (int) (in_bin.size / sizeof(float)) != *inNumSamples) {
+      return 0;
+    }
+    *inNumSamples = in_bin.size / sizeof(float);
+    in[(*channels)++] = (float *) in_bin.data;
+    term = tail;
+  }
+  return *channels > 0;
+}
+
+/*  Run the unit on the frames argv[1], a binary or a list of channel
+    binaries, a unit taking more inputs gets the last channel repeated.
+    Events are taken from argv[3] when with_events. Long calls hop to a
+    dirty scheduler by rescheduling fp with the same arguments.
+*/
+static inline ERL_NIF_TERM sc_run(ErlNifEnv* env, SCUnit * sc, const char * name,
+                                  ERL_NIF_TERM (*fp)(ErlNifEnv*, int, const ERL_NIF_TERM []),
+                                  int argc, const ERL_NIF_TERM argv[], double * args,
+                                  int with_events) {
+  ERL_NIF_TERM out_term[SC_MAX_CHANNELS];
+  float * in_array[SC_MAX_CHANNELS];
+  float * out_array[SC_MAX_CHANNELS];
+  unsigned int channels;
+  int inNumSamples = 0;
+
+  if(!sc_get_channels(env, argv[1], in_array, SC_MAX_CHANNELS, &channels, &inNumSamples)) {
+    return sc_raise(env, "Input stream not a binary nor a list of binaries of one length");
+  }
+  for(unsigned int c = channels; c < sc->num_inputs; c++) {
+    in_array[c] = in_array[channels - 1];
+  }
+
+  if(sc_dirty_needed(inNumSamples)) {
+    return enif_schedule_nif(env, name, ERL_NIF_DIRTY_JOB_CPU_BOUND, fp, argc, argv);
+  }
+
+  SCEvent * events = NULL;
+  unsigned int num_events = 0;
+  if(with_events &&
+     !sc_get_events(env, argv[3], sc, inNumSamples, &events, &num_events)) {
+    return sc_raise(env, "Events not {offset, index, value} within the block in offset order");
+  }
+
+  for(unsigned int c = 0; c < sc->num_outputs; c++) {
+    out_array[c] = sc_make_output(env, sc, inNumSamples * sizeof(float), &out_term[c]);
+  }
+  sc_calc_events(sc, out_array, in_array, args, inNumSamples, events, num_events);
+  if(events) enif_free(events);
+
+  if(sc->num_outputs == 1) {
+    return out_term[0];
+  } else {
+    return enif_make_list_from_array(env, out_term, sc->num_outputs);
+  }
+}
+
+/*  Body of the next_events NIFs, argv is {ref, frames, args, events}.
+    Args are the parameter values at the start of the block.
+*/
+static inline ERL_NIF_TERM sc_next_events(ErlNifEnv* env, SCUnit * sc, const char * name,
+                                          ERL_NIF_TERM (*fp)(ErlNifEnv*, int, const ERL_NIF_TERM []),
+                                          int argc, const ERL_NIF_TERM argv[]) {
+  double args[SC_MAX_ARGS];
+  if(!sc_get_args(env, argv[2], args)) {
+    return sc_raise(env, "Args not a list of floats");
+  }
+  return sc_run(env, sc, name, fp, argc, argv, args, 1);
+}
+
+/*  Sticky parameters.
+
+    A unit keeps a copy of its parameters, initialised to the defaults
+    given to sc_unit_params and changed by name with set_params. The
+    process NIFs run the unit with them, so a period only carries the
+    audio binary.
+*/
+static inline void sc_unit_params(SCUnit * sc, const char * const * names,
+                                  const double * defaults) {
+  sc->names = names;
+  memcpy(sc->params, defaults, sc->num_args * sizeof(double));
+}
+
+// Body of the set_params NIFs, argv is {ref, [{name, value}]}
+static inline ERL_NIF_TERM sc_set_params(ErlNifEnv* env, SCUnit * sc, const ERL_NIF_TERM argv[]) {
+  double params[SC_MAX_ARGS];
+  ERL_NIF_TERM list = argv[1], head, tail;
+  const ERL_NIF_TERM * tuple;
+  int arity;
+  char name[32];
+  unsigned int i;
+
+  // All or nothing, a bad pair leaves the parameters untouched
+  memcpy(params, sc->params, sizeof(params));
+  while(enif_get_list_cell(env, list, &head, &tail)) {
+    if(!(enif_get_tuple(env, head, &arity, &tuple) && arity == 2 &&
+         enif_get_atom(env, tuple[0], name, sizeof(name), ERL_NIF_LATIN1))) {
+      return sc_raise(env, "Params not a keyword list");
+    }
+    for(i = 0; sc->names && i < sc->num_args && strcmp(name, sc->names[i]); i++);
+    if(sc->names == NULL || i == sc->num_args) {
+      return sc_raise(env, "Unknown parameter");
+    }
+    if(!enif_get_double(env, tuple[1], &params[i])) {
+      return sc_raise(env, "Parameter value not a float");
+    }
+    list = tail;
+  }
+  memcpy(sc->params, params, sizeof(params));
+  return enif_make_atom(env, "ok");
+}
+
+// Body of the process NIFs, argv is {ref, frames}
+static inline ERL_NIF_TERM sc_process(ErlNifEnv* env, SCUnit * sc, const char * name,
+                                      ERL_NIF_TERM (*fp)(ErlNifEnv*, int, const ERL_NIF_TERM []),
+                                      int argc, const ERL_NIF_TERM argv[]) {
+  double args[SC_MAX_ARGS];
+  memcpy(args, sc->params, sizeof(args));
+  return sc_run(env, sc, name, fp, argc, argv, args, 0);
+}
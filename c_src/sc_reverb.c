@@ -24,174 +24,79 @@
 
 static ErlNifResourceType* sc_reverb_type;
 
-typedef struct FreeVerb {
-  int iota0;
-  int iota1;
-  int iota2;
-  int iota3;
-  int iota4;
-  int iota5;
-  int iota6;
-  int iota7;
-  int iota8;
-  int iota9;
-  int iota10;
-  int iota11;
-
-  float R0_1;
-  float R1_1;
-  float R2_1;
-  float R3_1;
-  float R0_0;
-  float R1_0;
-  float R2_0;
-  float R3_0;
-  float R4_0;
-  float R5_0;
-  float R6_0;
-  float R7_0;
-  float R8_0;
-  float R9_0;
-  float R10_0;
-  float R11_0;
-  float R12_0;
-  float R13_0;
-  float R14_0;
-  float R15_0;
-  float R16_0;
-  float R17_0;
-  float R18_0;
-  float R19_0;
-
-  float dline0[225];
-  float dline1[341];
-  float dline2[441];
-  float dline3[556];
-  float dline4[1617];
-  float dline5[1557];
-  float dline6[1491];
-  float dline7[1422];
-  float dline8[1277];
-  float dline9[1116];
-  float dline10[1188];
-  float dline11[1356];
+/*  FreeVerb delay lines. The line lengths are tuned for 44.1 kHz and
+    scaled to the rate of the unit. All lines live in one arena after
+    the unit struct, each starting on a cache line and padded to whole
+    cache lines, so a reverb takes as few lines and pages as possible.
+*/
+#define FV_MAX_LINES 24
+
+static const int freeverb_lens[FV_MAX_LINES] = {
+  225, 341, 441, 556, 1617, 1557, 1491, 1422, 1277, 1116, 1188, 1356,
+  // FreeVerb2 right channel, stereo spread 23
+  248, 364, 464, 579, 1640, 1580, 1514, 1445, 1300, 1139, 1211, 1379
+};
+
+#define FV_ALLPASSES 4
+#define FV_BLOCK 128
+#define FV_COMBS 8
 
+typedef struct FVLines {
+  void * dline[FV_MAX_LINES];  // Samples in the storage of the reverb
+  int len[FV_MAX_LINES];
+  void * arena;         // All lines
+  size_t arena_size;    // Bytes
+  int block;            // Samples of a block pass, see FreeVerb_block_run
+} FVLines;
+
+typedef struct FreeVerb {
+  FVLines lines;
+  // Allpasses on lines 0 to 3
+  int ap_iota[FV_ALLPASSES];
+  float ap_last[FV_ALLPASSES];  // Last sample read
+  float ap_out[FV_ALLPASSES];
+  // Combs on lines 4 to 11, comb k is lane k of FreeVerb_simd_run
+  int comb_iota[FV_COMBS];
+  float comb_out[FV_COMBS];     // Last sample read
+  float comb_filt[FV_COMBS];    // Damping lowpass
 } FreeVerb;
 
 // FreeVerb2
 typedef struct FreeVerb2 {
-  int iota0;
-  int iota1;
-  int iota2;
-  int iota3;
-  int iota4;
-  int iota5;
-  int iota6;
-  int iota7;
-  int iota8;
-  int iota9;
-  int iota10;
-  int iota11;
-  int iota12;
-  int iota13;
-  int iota14;
-  int iota15;
-  int iota16;
-  int iota17;
-  int iota18;
-  int iota19;
-  int iota20;
-  int iota21;
-  int iota22;
-  int iota23;
-  float R0_1;
-  float R1_1;
-  float R2_1;
-  float R3_1;
-  float R0_0;
-  float R1_0;
-  float R2_0;
-  float R3_0;
-  float R4_0;
-  float R5_0;
-  float R6_0;
-  float R7_0;
-  float R8_0;
-  float R9_0;
-  float R10_0;
-  float R11_0;
-  float R12_0;
-  float R13_0;
-  float R14_0;
-  float R15_0;
-  float R16_0;
-  float R17_0;
-  float R18_0;
-  float R19_0;
-  float R20_0;
-  float R21_0;
-  float R22_0;
-  float R23_0;
-  float R24_0;
-  float R25_0;
-  float R26_0;
-  float R27_0;
-  float R28_0;
-  float R29_0;
-  float R30_0;
-  float R31_0;
-  float R32_0;
-  float R33_0;
-  float R34_0;
-  float R35_0;
-  float R36_0;
-  float R37_0;
-  float R38_0;
-  float R39_0;
-  float R20_1;
-  float R21_1;
-  float R22_1;
-  float R23_1;
-  float dline0[225];
-  float dline1[341];
-  float dline2[441];
-  float dline3[556];
-  float dline4[1617];
-  float dline5[1557];
-  float dline6[1491];
-  float dline7[1422];
-  float dline8[1277];
-  float dline9[1116];
-  float dline10[1188];
-  float dline11[1356];
-  float dline12[248];
-  float dline13[364];
-  float dline14[464];
-  float dline15[579];
-  float dline16[1640];
-  float dline17[1580];
-  float dline18[1514];
-  float dline19[1445];
-  float dline20[1300];
-  float dline21[1139];
-  float dline22[1211];
-  float dline23[1379];
+  FVLines lines;
+  // Allpasses on lines 0 to 3 (left) and 12 to 15 (right)
+  int ap_iota[2 * FV_ALLPASSES];
+  float ap_last[2 * FV_ALLPASSES];
+  float ap_out[2 * FV_ALLPASSES];
+  // Combs on lines 4 to 11 (left) and 16 to 23 (right), comb k is lane
+  // k of FreeVerb2_simd_run
+  int comb_iota[2 * FV_COMBS];
+  float comb_out[2 * FV_COMBS];
+  float comb_filt[2 * FV_COMBS];
 } FreeVerb2;
 
 /*  GVerb work */
 #define FDNORDER 4
-
+// Above it the last left diffuser gets a size <= 0
+#define GVERB_MAX_SPREAD 160.f
+
+/*  Delay lines and diffusers are rings of a power of two size in one
+    cache aligned arena after the unit, indexed with masks. A ring reads
+    n samples back for any n up to its size, so the FDN and tap lines
+    follow room size changes within maxroomsize.
+*/
 typedef struct {
-  int size;
-  int idx;
-  float* buf;
+  unsigned int mask;  // Ring size - 1
+  unsigned int idx;
+  void* buf;          // Samples in the storage of the reverb
 } g_fixeddelay;
 
 typedef struct {
-  int size;
+  int size;           // Delay in samples
+  unsigned int mask;
   float coef;
-  int idx;
-  float* buf;
+  unsigned int idx;
+  void* buf;
 } g_diffuser;
 
 typedef struct {
@@ -204,16 +109,16 @@ typedef struct GVerb {
   float roomsize, revtime, damping, spread, inputbandwidth, drylevel, earlylevel, taillevel;
   float maxroomsize;
   float maxdelay, largestdelay;
-  g_damper* inputdamper;
-  g_fixeddelay* fdndels[FDNORDER];
+  g_damper inputdamper;
+  g_fixeddelay fdndels[FDNORDER];
   float fdngains[FDNORDER];
   int fdnlens[FDNORDER];
-  g_damper* fdndamps[FDNORDER];
+  g_damper fdndamps[FDNORDER];
   double alpha;
   float u[FDNORDER], f[FDNORDER], d[FDNORDER];
-  g_diffuser* ldifs[FDNORDER];
-  g_diffuser* rdifs[FDNORDER];
-  g_fixeddelay* tapdelay;
+  g_diffuser ldifs[FDNORDER];
+  g_diffuser rdifs[FDNORDER];
+  g_fixeddelay tapdelay;
   int taps[FDNORDER];
   float tapgains[FDNORDER];
   float earlylevelslope, taillevelslope, drylevelslope;
@@ -223,6 +128,8 @@ typedef struct GVerb {
   // grab values and use in the sample loop
   float rate;
   float period_size;
+  void * arena;       // All rings
+  size_t arena_size;  // Bytes
 } GVerb;
 
 typedef union {
@@ -232,85 +139,63 @@ typedef union {
 } SubUnit;
 
 typedef struct Reverb {
+  SCUnit sc;
   double rate;
   double period_size;
   SubUnit unit;
+  void * mem;   // Allocation holding the sub unit
+  int storage;  // Delay line samples, SC_STORE_F32, F16 or I16
   void (*first)(struct Reverb *, double *);
+  void (*reset)(struct Reverb *, double *);  // Clears the state, run as first
   void (*next)(struct Reverb *, float**, float**, double*, int);
   void (*dtor)(struct Reverb *);
 } Reverb;
 
 
+// Allocate a FreeVerb or FreeVerb2 of size bytes with its num_lines
+// delay lines in the storage of the reverb, the lines are cleared by
+// the Ctor.
+static void * FreeVerb_Alloc(Reverb* rev, size_t size, int num_lines) {
+  int len[FV_MAX_LINES];
+  size_t line_size[FV_MAX_LINES];
+  size_t head = (size + SC_CACHE_LINE - 1) & ~(SC_CACHE_LINE - 1);
+  size_t arena_size = 0;
+  for (int i = 0; i < num_lines; i++) {
+    len[i] = sc_max(1, (int) (freeverb_lens[i] * rev->rate / 44100. + 0.5));
+    // One extra sample so vector loads at the last index stay inside
+    line_size[i] = ((len[i] + 1) * sc_storage_size(rev->storage) + SC_CACHE_LINE - 1)
+      & ~(SC_CACHE_LINE - 1);
+    arena_size += line_size[i];
+  }
+  rev->mem = sc_delay_alloc(head + arena_size + SC_CACHE_LINE);
+  char * unit = sc_align_cache(rev->mem);
+  FVLines * lines = (FVLines *) unit;  // First member of both units
+  lines->arena = unit + head;
+  lines->arena_size = arena_size;
+  lines->block = FV_BLOCK;
+  char * line = lines->arena;
+  for (int i = 0; i < num_lines; i++) {
+    lines->dline[i] = line;
+    lines->len[i] = len[i];
+    lines->block = sc_min(lines->block, len[i]);
+    line += line_size[i];
+  }
+  return unit;
+}
+
 static void FreeVerb_Ctor(Reverb* rev, double * args) {
   FreeVerb * unit = rev->unit.fv;
-  unit->iota0 = 0;
-  unit->iota1 = 0;
-  unit->iota2 = 0;
-  unit->iota3 = 0;
-  unit->iota4 = 0;
-  unit->iota5 = 0;
-  unit->iota6 = 0;
-  unit->iota7 = 0;
-  unit->iota8 = 0;
-  unit->iota9 = 0;
-  unit->iota10 = 0;
-  unit->iota11 = 0;
-
-  unit->R0_0 = 0.0;
-  unit->R1_0 = 0.0;
-  unit->R2_0 = 0.0;
-  unit->R3_0 = 0.0;
-  unit->R4_0 = 0.0;
-  unit->R5_0 = 0.0;
-  unit->R6_0 = 0.0;
-  unit->R7_0 = 0.0;
-  unit->R8_0 = 0.0;
-  unit->R9_0 = 0.0;
-  unit->R10_0 = 0.0;
-  unit->R11_0 = 0.0;
-  unit->R12_0 = 0.0;
-  unit->R13_0 = 0.0;
-  unit->R14_0 = 0.0;
-  unit->R15_0 = 0.0;
-  unit->R16_0 = 0.0;
-  unit->R17_0 = 0.0;
-  unit->R18_0 = 0.0;
-  unit->R19_0 = 0.0;
-
-  unit->R0_1 = 0.0;
-  unit->R1_1 = 0.0;
-  unit->R2_1 = 0.0;
-  unit->R3_1 = 0.0;
-
-  for (int i = 0; i < 225; i++)
-    unit->dline0[i] = 0.0;
-  for (int i = 0; i < 341; i++)
-    unit->dline1[i] = 0.0;
-  for (int i = 0; i < 441; i++)
-    unit->dline2[i] = 0.0;
-  for (int i = 0; i < 556; i++)
-    unit->dline3[i] = 0.0;
-  for (int i = 0; i < 1617; i++)
-    unit->dline4[i] = 0.0;
-  for (int i = 0; i < 1557; i++)
-    unit->dline5[i] = 0.0;
-  for (int i = 0; i < 1491; i++)
-    unit->dline6[i] = 0.0;
-  for (int i = 0; i < 1422; i++)
-    unit->dline7[i] = 0.0;
-  for (int i = 0; i < 1277; i++)
-    unit->dline8[i] = 0.0;
-  for (int i = 0; i < 1116; i++)
-    unit->dline9[i] = 0.0;
-  for (int i = 0; i < 1188; i++)
-    unit->dline10[i] = 0.0;
-  for (int i = 0; i < 1356; i++)
-    unit->dline11[i] = 0.0;
-
-}
-
-static void FreeVerb_next(Reverb * rev, float** output, float** input ,
-                          double* args, int inNumSamples) {
+  memset(unit->ap_iota, 0, sizeof(unit->ap_iota));
+  memset(unit->ap_last, 0, sizeof(unit->ap_last));
+  memset(unit->ap_out, 0, sizeof(unit->ap_out));
+  memset(unit->comb_iota, 0, sizeof(unit->comb_iota));
+  memset(unit->comb_out, 0, sizeof(unit->comb_out));
+  memset(unit->comb_filt, 0, sizeof(unit->comb_filt));
+  memset(unit->lines.arena, 0, unit->lines.arena_size);
+}
+
+static sc_always_inline void FreeVerb_run(Reverb * rev, float** output, float** input,
+                                         double* args, int inNumSamples, const int storage) {
 
   float * output0 = output[0];
   float * input0 = input[0];
@@ -337,330 +222,384 @@ static void FreeVerb_next(Reverb * rev, float** output, float** input ,
   float ftemp6 = (0.400000f * damp);
   float ftemp7 = (1 - ftemp6);
 
-  int iota0 = unit->iota0;
-  int iota1 = unit->iota1;
-  int iota2 = unit->iota2;
-  int iota3 = unit->iota3;
-  int iota4 = unit->iota4;
-  int iota5 = unit->iota5;
-  int iota6 = unit->iota6;
-  int iota7 = unit->iota7;
-  int iota8 = unit->iota8;
-  int iota9 = unit->iota9;
-  int iota10 = unit->iota10;
-  int iota11 = unit->iota11;
-
-  float R0_1 = unit->R0_1;
-  float R1_1 = unit->R1_1;
-  float R2_1 = unit->R2_1;
-  float R3_1 = unit->R3_1;
-
-  float R0_0 = unit->R0_0;
-  float R1_0 = unit->R1_0;
-  float R2_0 = unit->R2_0;
-  float R3_0 = unit->R3_0;
-  float R4_0 = unit->R4_0;
-  float R5_0 = unit->R5_0;
-  float R6_0 = unit->R6_0;
-  float R7_0 = unit->R7_0;
-  float R8_0 = unit->R8_0;
-  float R9_0 = unit->R9_0;
-  float R10_0 = unit->R10_0;
-  float R11_0 = unit->R11_0;
-  float R12_0 = unit->R12_0;
-  float R13_0 = unit->R13_0;
-  float R14_0 = unit->R14_0;
-  float R15_0 = unit->R15_0;
-  float R16_0 = unit->R16_0;
-  float R17_0 = unit->R17_0;
-  float R18_0 = unit->R18_0;
-  float R19_0 = unit->R19_0;
-
-  float* dline0 = unit->dline0;
-  float* dline1 = unit->dline1;
-  float* dline2 = unit->dline2;
-  float* dline3 = unit->dline3;
-  float* dline4 = unit->dline4;
-  float* dline5 = unit->dline5;
-  float* dline6 = unit->dline6;
-  float* dline7 = unit->dline7;
-  float* dline8 = unit->dline8;
-  float* dline9 = unit->dline9;
-  float* dline10 = unit->dline10;
-  float* dline11 = unit->dline11;
+  int iota0 = unit->ap_iota[0];
+  int iota1 = unit->ap_iota[1];
+  int iota2 = unit->ap_iota[2];
+  int iota3 = unit->ap_iota[3];
+  int iota4 = unit->comb_iota[0];
+  int iota5 = unit->comb_iota[1];
+  int iota6 = unit->comb_iota[2];
+  int iota7 = unit->comb_iota[3];
+  int iota8 = unit->comb_iota[4];
+  int iota9 = unit->comb_iota[5];
+  int iota10 = unit->comb_iota[6];
+  int iota11 = unit->comb_iota[7];
+
+  float R0_1 = unit->ap_out[0];
+  float R1_1 = unit->ap_out[1];
+  float R2_1 = unit->ap_out[2];
+  float R3_1 = unit->ap_out[3];
+
+  float R0_0 = unit->ap_last[0];
+  float R1_0 = unit->ap_last[1];
+  float R2_0 = unit->ap_last[2];
+  float R3_0 = unit->ap_last[3];
+  float R4_0 = unit->comb_out[0];
+  float R5_0 = unit->comb_filt[0];
+  float R6_0 = unit->comb_out[1];
+  float R7_0 = unit->comb_filt[1];
+  float R8_0 = unit->comb_out[2];
+  float R9_0 = unit->comb_filt[2];
+  float R10_0 = unit->comb_out[3];
+  float R11_0 = unit->comb_filt[3];
+  float R12_0 = unit->comb_out[4];
+  float R13_0 = unit->comb_filt[4];
+  float R14_0 = unit->comb_out[5];
+  float R15_0 = unit->comb_filt[5];
+  float R16_0 = unit->comb_out[6];
+  float R17_0 = unit->comb_filt[6];
+  float R18_0 = unit->comb_out[7];
+  float R19_0 = unit->comb_filt[7];
+
+  void* dline0 = unit->lines.dline[0];
+  int len0 = unit->lines.len[0];
+  void* dline1 = unit->lines.dline[1];
+  int len1 = unit->lines.len[1];
+  void* dline2 = unit->lines.dline[2];
+  int len2 = unit->lines.len[2];
+  void* dline3 = unit->lines.dline[3];
+  int len3 = unit->lines.len[3];
+  void* dline4 = unit->lines.dline[4];
+  int len4 = unit->lines.len[4];
+  void* dline5 = unit->lines.dline[5];
+  int len5 = unit->lines.len[5];
+  void* dline6 = unit->lines.dline[6];
+  int len6 = unit->lines.len[6];
+  void* dline7 = unit->lines.dline[7];
+  int len7 = unit->lines.len[7];
+  void* dline8 = unit->lines.dline[8];
+  int len8 = unit->lines.len[8];
+  void* dline9 = unit->lines.dline[9];
+  int len9 = unit->lines.len[9];
+  void* dline10 = unit->lines.dline[10];
+  int len10 = unit->lines.len[10];
+  void* dline11 = unit->lines.dline[11];
+  int len11 = unit->lines.len[11];
 
   for (int i = 0; i < inNumSamples; i++) {
     float ftemp2 = input0[i];
     float ftemp4 = (1.500000e-02f * ftemp2);
 
 
-    if (++iota0 == 225)
+    if (++iota0 == len0)
       iota0 = 0;
-    float T0 = dline0[iota0];
+    float T0 = sc_load(dline0, iota0, storage);
 
-    if (++iota1 == 341)
+    if (++iota1 == len1)
       iota1 = 0;
-    float T1 = dline1[iota1];
+    float T1 = sc_load(dline1, iota1, storage);
 
-    if (++iota2 == 441)
+    if (++iota2 == len2)
       iota2 = 0;
-    float T2 = dline2[iota2];
+    float T2 = sc_load(dline2, iota2, storage);
 
-    if (++iota3 == 556)
+    if (++iota3 == len3)
       iota3 = 0;
-    float T3 = dline3[iota3];
+    float T3 = sc_load(dline3, iota3, storage);
 
 
-    if (++iota4 == 1617)
+    if (++iota4 == len4)
       iota4 = 0;
-    float T4 = dline4[iota4];
+    float T4 = sc_load(dline4, iota4, storage);
     R5_0 = ((ftemp7 * R4_0) + (ftemp6 * R5_0));
-    dline4[iota4] = (ftemp4 + (ftemp5 * R5_0));
+    sc_store(dline4, iota4, (ftemp4 + (ftemp5 * R5_0)), storage);
     R4_0 = T4;
 
-    if (++iota5 == 1557)
+    if (++iota5 == len5)
       iota5 = 0;
-    float T5 = dline5[iota5];
+    float T5 = sc_load(dline5, iota5, storage);
     R7_0 = ((ftemp7 * R6_0) + (ftemp6 * R7_0));
-    dline5[iota5] = (ftemp4 + (ftemp5 * R7_0));
+    sc_store(dline5, iota5, (ftemp4 + (ftemp5 * R7_0)), storage);
     R6_0 = T5;
 
-    if (++iota6 == 1491)
+    if (++iota6 == len6)
       iota6 = 0;
-    float T6 = dline6[iota6];
+    float T6 = sc_load(dline6, iota6, storage);
     R9_0 = ((ftemp7 * R8_0) + (ftemp6 * R9_0));
-    dline6[iota6] = (ftemp4 + (ftemp5 * R9_0));
+    sc_store(dline6, iota6, (ftemp4 + (ftemp5 * R9_0)), storage);
     R8_0 = T6;
 
-    if (++iota7 == 1422)
+    if (++iota7 == len7)
       iota7 = 0;
-    float T7 = dline7[iota7];
+    float T7 = sc_load(dline7, iota7, storage);
     R11_0 = ((ftemp7 * R10_0) + (ftemp6 * R11_0));
-    dline7[iota7] = (ftemp4 + (ftemp5 * R11_0));
+    sc_store(dline7, iota7, (ftemp4 + (ftemp5 * R11_0)), storage);
     R10_0 = T7;
 
-    if (++iota8 == 1277)
+    if (++iota8 == len8)
       iota8 = 0;
-    float T8 = dline8[iota8];
+    float T8 = sc_load(dline8, iota8, storage);
     R13_0 = ((ftemp7 * R12_0) + (ftemp6 * R13_0));
-    dline8[iota8] = (ftemp4 + (ftemp5 * R13_0));
+    sc_store(dline8, iota8, (ftemp4 + (ftemp5 * R13_0)), storage);
     R12_0 = T8;
 
-    if (++iota9 == 1116)
+    if (++iota9 == len9)
       iota9 = 0;
-    float T9 = dline9[iota9];
+    float T9 = sc_load(dline9, iota9, storage);
     R15_0 = ((ftemp7 * R14_0) + (ftemp6 * R15_0));
-    dline9[iota9] = (ftemp4 + (ftemp5 * R15_0));
+    sc_store(dline9, iota9, (ftemp4 + (ftemp5 * R15_0)), storage);
     R14_0 = T9;
 
-    if (++iota10 == 1188)
+    if (++iota10 == len10)
       iota10 = 0;
-    float T10 = dline10[iota10];
+    float T10 = sc_load(dline10, iota10, storage);
     R17_0 = ((ftemp7 * R16_0) + (ftemp6 * R17_0));
-    dline10[iota10] = (ftemp4 + (ftemp5 * R17_0));
+    sc_store(dline10, iota10, (ftemp4 + (ftemp5 * R17_0)), storage);
     R16_0 = T10;
 
-    if (++iota11 == 1356)
+    if (++iota11 == len11)
       iota11 = 0;
-    float T11 = dline11[iota11];
+    float T11 = sc_load(dline11, iota11, storage);
     R19_0 = ((ftemp7 * R18_0) + (ftemp6 * R19_0));
-    dline11[iota11] = (ftemp4 + (ftemp5 * R19_0));
+    sc_store(dline11, iota11, (ftemp4 + (ftemp5 * R19_0)), storage);
     R18_0 = T11;
 
     float ftemp8 = (R16_0 + R18_0);
 
-    dline3[iota3] = ((((0.500000f * R3_0) + R4_0) + (R6_0 + R8_0)) + ((R10_0 + R12_0) + (R14_0 + ftemp8)));
+    sc_store(dline3, iota3, ((((0.500000f * R3_0) + R4_0) + (R6_0 + R8_0)) + ((R10_0 + R12_0) + (R14_0 + ftemp8))), storage);
     R3_0 = T3;
 
     R3_1 = (R3_0 - (((R4_0 + R6_0) + (R8_0 + R10_0)) + ((R12_0 + R14_0) + ftemp8)));
-    dline2[iota2] = ((0.500000f * R2_0) + R3_1);
+    sc_store(dline2, iota2, ((0.500000f * R2_0) + R3_1), storage);
     R2_0 = T2;
 
     R2_1 = (R2_0 - R3_1);
-    dline1[iota1] = ((0.500000f * R1_0) + R2_1);
+    sc_store(dline1, iota1, ((0.500000f * R1_0) + R2_1), storage);
     R1_0 = T1;
 
     R1_1 = (R1_0 - R2_1);
-    dline0[iota0] = ((0.500000f * R0_0) + R1_1);
+    sc_store(dline0, iota0, ((0.500000f * R0_0) + R1_1), storage);
     R0_0 = T0;
 
     R0_1 = (R0_0 - R1_1);
     output0[i] = ((ftemp1 * ftemp2) + (ftemp0 * R0_1));
   }
 
-  unit->iota0 = iota0;
-  unit->iota1 = iota1;
-  unit->iota2 = iota2;
-  unit->iota3 = iota3;
-  unit->iota4 = iota4;
-  unit->iota5 = iota5;
-  unit->iota6 = iota6;
-  unit->iota7 = iota7;
-  unit->iota8 = iota8;
-  unit->iota9 = iota9;
-  unit->iota10 = iota10;
-  unit->iota11 = iota11;
-
-  unit->R0_1 = R0_1;
-  unit->R1_1 = R1_1;
-  unit->R2_1 = R2_1;
-  unit->R3_1 = R3_1;
-
-  unit->R0_0 = R0_0;
-  unit->R1_0 = R1_0;
-  unit->R2_0 = R2_0;
-  unit->R3_0 = R3_0;
-  unit->R4_0 = R4_0;
-  unit->R5_0 = R5_0;
-  unit->R6_0 = R6_0;
-  unit->R7_0 = R7_0;
-  unit->R8_0 = R8_0;
-  unit->R9_0 = R9_0;
-  unit->R10_0 = R10_0;
-  unit->R11_0 = R11_0;
-  unit->R12_0 = R12_0;
-  unit->R13_0 = R13_0;
-  unit->R14_0 = R14_0;
-  unit->R15_0 = R15_0;
-  unit->R16_0 = R16_0;
-  unit->R17_0 = R17_0;
-  unit->R18_0 = R18_0;
-  unit->R19_0 = R19_0;
+  unit->ap_iota[0] = iota0;
+  unit->ap_iota[1] = iota1;
+  unit->ap_iota[2] = iota2;
+  unit->ap_iota[3] = iota3;
+  unit->comb_iota[0] = iota4;
+  unit->comb_iota[1] = iota5;
+  unit->comb_iota[2] = iota6;
+  unit->comb_iota[3] = iota7;
+  unit->comb_iota[4] = iota8;
+  unit->comb_iota[5] = iota9;
+  unit->comb_iota[6] = iota10;
+  unit->comb_iota[7] = iota11;
+
+  unit->ap_out[0] = R0_1;
+  unit->ap_out[1] = R1_1;
+  unit->ap_out[2] = R2_1;
+  unit->ap_out[3] = R3_1;
+
+  unit->ap_last[0] = R0_0;
+  unit->ap_last[1] = R1_0;
+  unit->ap_last[2] = R2_0;
+  unit->ap_last[3] = R3_0;
+  unit->comb_out[0] = R4_0;
+  unit->comb_filt[0] = R5_0;
+  unit->comb_out[1] = R6_0;
+  unit->comb_filt[1] = R7_0;
+  unit->comb_out[2] = R8_0;
+  unit->comb_filt[2] = R9_0;
+  unit->comb_out[3] = R10_0;
+  unit->comb_filt[3] = R11_0;
+  unit->comb_out[4] = R12_0;
+  unit->comb_filt[4] = R13_0;
+  unit->comb_out[5] = R14_0;
+  unit->comb_filt[5] = R15_0;
+  unit->comb_out[6] = R16_0;
+  unit->comb_filt[6] = R17_0;
+  unit->comb_out[7] = R18_0;
+  unit->comb_filt[7] = R19_0;
+}
+
+// Parameter clamped to 0..1
+static inline float fv_unit(double x) {
+  float f = (float) x;
+  if (f > 1.)
+    f = 1.;
+  if (f < 0.)
+    f = 0.;
+  return f;
+}
+
+/*  FreeVerb with the eight combs in the lanes of an sc_v8f. The combs
+    are independent within a sample, only their reads and writes go to
+    separate lines, lane by lane. The allpasses stay scalar and sum the
+    comb outputs in the order of FreeVerb_run, the output is the same.
+
+    With -mavx and float32 lines it runs some 5% faster than the scalar
+    kernel. Without AVX, or with float16 and int16 lines where the
+    conversions are done lane by lane, it is slower, see get_kernel and
+    the block kernel.
+*/
+static sc_always_inline void FreeVerb_simd_run(Reverb * rev, float** output, float** input,
+                                              double* args, int inNumSamples, const int storage) {
+  float * output0 = output[0];
+  float * input0 = input[0];
+  FreeVerb * unit = rev->unit.fv;
+  float mix = fv_unit(args[0]);
+  float dry = (1 - mix);
+  float feedback = (0.700000f + (0.280000f * fv_unit(args[1])));
+  float damp = (0.400000f * fv_unit(args[2]));
+  float damp1 = (1 - damp);
+
+  int iota0 = unit->ap_iota[0];
+  int iota1 = unit->ap_iota[1];
+  int iota2 = unit->ap_iota[2];
+  int iota3 = unit->ap_iota[3];
+  float R0_1 = unit->ap_out[0];
+  float R1_1 = unit->ap_out[1];
+  float R2_1 = unit->ap_out[2];
+  float R3_1 = unit->ap_out[3];
+  float R0_0 = unit->ap_last[0];
+  float R1_0 = unit->ap_last[1];
+  float R2_0 = unit->ap_last[2];
+  float R3_0 = unit->ap_last[3];
+  void* dline0 = unit->lines.dline[0];
+  int len0 = unit->lines.len[0];
+  void* dline1 = unit->lines.dline[1];
+  int len1 = unit->lines.len[1];
+  void* dline2 = unit->lines.dline[2];
+  int len2 = unit->lines.len[2];
+  void* dline3 = unit->lines.dline[3];
+  int len3 = unit->lines.len[3];
+
+  void * const * comb_line = &unit->lines.dline[4];
+  sc_v8i idx, len;
+  sc_v8f out, filt;
+  memcpy(&idx, unit->comb_iota, sizeof(idx));
+  memcpy(&len, &unit->lines.len[4], sizeof(len));
+  memcpy(&out, unit->comb_out, sizeof(out));
+  memcpy(&filt, unit->comb_filt, sizeof(filt));
+
+  for (int i = 0; i < inNumSamples; i++) {
+    float ftemp2 = input0[i];
+    float ftemp4 = (1.500000e-02f * ftemp2);
+
+    if (++iota0 == len0)
+      iota0 = 0;
+    float T0 = sc_load(dline0, iota0, storage);
+    if (++iota1 == len1)
+      iota1 = 0;
+    float T1 = sc_load(dline1, iota1, storage);
+    if (++iota2 == len2)
+      iota2 = 0;
+    float T2 = sc_load(dline2, iota2, storage);
+    if (++iota3 == len3)
+      iota3 = 0;
+    float T3 = sc_load(dline3, iota3, storage);
+
+    idx += 1;
+    idx &= (idx != len);
+    sc_v8f T;
+    for (int k = 0; k < FV_COMBS; k++)
+      T[k] = sc_load(comb_line[k], idx[k], storage);
+    filt = (damp1 * out) + (damp * filt);
+    sc_v8f in = ftemp4 + (feedback * filt);
+    for (int k = 0; k < FV_COMBS; k++)
+      sc_store(comb_line[k], idx[k], in[k], storage);
+    out = T;
+
+    float ftemp8 = (out[6] + out[7]);
+    sc_store(dline3, iota3, ((((0.500000f * R3_0) + out[0]) + (out[1] + out[2])) + ((out[3] + out[4]) + (out[5] + ftemp8))), storage);
+    R3_0 = T3;
+    R3_1 = (R3_0 - (((out[0] + out[1]) + (out[2] + out[3])) + ((out[4] + out[5]) + ftemp8)));
+    sc_store(dline2, iota2, ((0.500000f * R2_0) + R3_1), storage);
+    R2_0 = T2;
+    R2_1 = (R2_0 - R3_1);
+    sc_store(dline1, iota1, ((0.500000f * R1_0) + R2_1), storage);
+    R1_0 = T1;
+    R1_1 = (R1_0 - R2_1);
+    sc_store(dline0, iota0, ((0.500000f * R0_0) + R1_1), storage);
+    R0_0 = T0;
+    R0_1 = (R0_0 - R1_1);
+    output0[i] = ((dry * ftemp2) + (mix * R0_1));
+  }
+
+  unit->ap_iota[0] = iota0;
+  unit->ap_iota[1] = iota1;
+  unit->ap_iota[2] = iota2;
+  unit->ap_iota[3] = iota3;
+  unit->ap_out[0] = R0_1;
+  unit->ap_out[1] = R1_1;
+  unit->ap_out[2] = R2_1;
+  unit->ap_out[3] = R3_1;
+  unit->ap_last[0] = R0_0;
+  unit->ap_last[1] = R1_0;
+  unit->ap_last[2] = R2_0;
+  unit->ap_last[3] = R3_0;
+  memcpy(unit->comb_iota, &idx, sizeof(idx));
+  memcpy(unit->comb_out, &out, sizeof(out));
+  memcpy(unit->comb_filt, &filt, sizeof(filt));
+}
+
+// One kernel per storage, see sc_load
+static void FreeVerb_next(Reverb* rev, float** output, float** input,
+                          double* args, int inNumSamples) {
+  FreeVerb_run(rev, output, input, args, inNumSamples, SC_STORE_F32);
+}
+
+static void FreeVerb_next_f16(Reverb* rev, float** output, float** input,
+                              double* args, int inNumSamples) {
+  FreeVerb_run(rev, output, input, args, inNumSamples, SC_STORE_F16);
+}
+
+static void FreeVerb_next_i16(Reverb* rev, float** output, float** input,
+                              double* args, int inNumSamples) {
+  FreeVerb_run(rev, output, input, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const freeverb_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &FreeVerb_next, &FreeVerb_next_f16, &FreeVerb_next_i16
+};
+
+static void FreeVerb_simd_next(Reverb* rev, float** output, float** input,
+                               double* args, int inNumSamples) {
+  FreeVerb_simd_run(rev, output, input, args, inNumSamples, SC_STORE_F32);
 }
 
+static void FreeVerb_simd_next_f16(Reverb* rev, float** output, float** input,
+                                   double* args, int inNumSamples) {
+  FreeVerb_simd_run(rev, output, input, args, inNumSamples, SC_STORE_F16);
+}
+
+static void FreeVerb_simd_next_i16(Reverb* rev, float** output, float** input,
+                                   double* args, int inNumSamples) {
+  FreeVerb_simd_run(rev, output, input, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const freeverb_simd_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &FreeVerb_simd_next, &FreeVerb_simd_next_f16, &FreeVerb_simd_next_i16
+};
+
 
 
 static void FreeVerb2_Ctor(Reverb* rev, double * args) {
   FreeVerb2 * unit = rev->unit.fv2;
-
-  unit->iota0 = 0;
-  unit->iota1 = 0;
-  unit->iota2 = 0;
-  unit->iota3 = 0;
-  unit->iota4 = 0;
-  unit->iota5 = 0;
-  unit->iota6 = 0;
-  unit->iota7 = 0;
-  unit->iota8 = 0;
-  unit->iota9 = 0;
-  unit->iota10 = 0;
-  unit->iota11 = 0;
-  unit->iota12 = 0;
-  unit->iota13 = 0;
-  unit->iota14 = 0;
-  unit->iota15 = 0;
-  unit->iota16 = 0;
-  unit->iota17 = 0;
-  unit->iota18 = 0;
-  unit->iota19 = 0;
-  unit->iota20 = 0;
-  unit->iota21 = 0;
-  unit->iota22 = 0;
-  unit->iota23 = 0;
-
-  unit->R0_0 = 0.0;
-  unit->R1_0 = 0.0;
-  unit->R2_0 = 0.0;
-  unit->R3_0 = 0.0;
-  unit->R4_0 = 0.0;
-  unit->R5_0 = 0.0;
-  unit->R6_0 = 0.0;
-  unit->R7_0 = 0.0;
-  unit->R8_0 = 0.0;
-  unit->R9_0 = 0.0;
-  unit->R10_0 = 0.0;
-  unit->R11_0 = 0.0;
-  unit->R12_0 = 0.0;
-  unit->R13_0 = 0.0;
-  unit->R14_0 = 0.0;
-  unit->R15_0 = 0.0;
-  unit->R16_0 = 0.0;
-  unit->R17_0 = 0.0;
-  unit->R18_0 = 0.0;
-  unit->R19_0 = 0.0;
-  unit->R20_0 = 0.0;
-  unit->R21_0 = 0.0;
-  unit->R22_0 = 0.0;
-  unit->R23_0 = 0.0;
-  unit->R24_0 = 0.0;
-  unit->R25_0 = 0.0;
-  unit->R26_0 = 0.0;
-  unit->R27_0 = 0.0;
-  unit->R28_0 = 0.0;
-  unit->R29_0 = 0.0;
-  unit->R30_0 = 0.0;
-  unit->R31_0 = 0.0;
-  unit->R32_0 = 0.0;
-  unit->R33_0 = 0.0;
-  unit->R34_0 = 0.0;
-  unit->R35_0 = 0.0;
-  unit->R36_0 = 0.0;
-  unit->R37_0 = 0.0;
-  unit->R38_0 = 0.0;
-  unit->R39_0 = 0.0;
-
-  unit->R0_1 = 0.0;
-  unit->R1_1 = 0.0;
-  unit->R2_1 = 0.0;
-  unit->R3_1 = 0.0;
-
-  unit->R23_1 = 0.0;
-  unit->R22_1 = 0.0;
-  unit->R21_1 = 0.0;
-  unit->R20_1 = 0.0;
-
-  for (int i = 0; i < 225; i++)
-    unit->dline0[i] = 0.0;
-  for (int i = 0; i < 341; i++)
-    unit->dline1[i] = 0.0;
-  for (int i = 0; i < 441; i++)
-    unit->dline2[i] = 0.0;
-  for (int i = 0; i < 556; i++)
-    unit->dline3[i] = 0.0;
-  for (int i = 0; i < 1617; i++)
-    unit->dline4[i] = 0.0;
-  for (int i = 0; i < 1557; i++)
-    unit->dline5[i] = 0.0;
-  for (int i = 0; i < 1491; i++)
-    unit->dline6[i] = 0.0;
-  for (int i = 0; i < 1422; i++)
-    unit->dline7[i] = 0.0;
-  for (int i = 0; i < 1277; i++)
-    unit->dline8[i] = 0.0;
-  for (int i = 0; i < 1116; i++)
-    unit->dline9[i] = 0.0;
-  for (int i = 0; i < 1188; i++)
-    unit->dline10[i] = 0.0;
-  for (int i = 0; i < 1356; i++)
-    unit->dline11[i] = 0.0;
-  for (int i = 0; i < 248; i++)
-    unit->dline12[i] = 0.0;
-  for (int i = 0; i < 364; i++)
-    unit->dline13[i] = 0.0;
-  for (int i = 0; i < 464; i++)
-    unit->dline14[i] = 0.0;
-  for (int i = 0; i < 579; i++)
-    unit->dline15[i] = 0.0;
-  for (int i = 0; i < 1640; i++)
-    unit->dline16[i] = 0.0;
-  for (int i = 0; i < 1580; i++)
-    unit->dline17[i] = 0.0;
-  for (int i = 0; i < 1514; i++)
-    unit->dline18[i] = 0.0;
-  for (int i = 0; i < 1445; i++)
-    unit->dline19[i] = 0.0;
-  for (int i = 0; i < 1300; i++)
-    unit->dline20[i] = 0.0;
-  for (int i = 0; i < 1139; i++)
-    unit->dline21[i] = 0.0;
-  for (int i = 0; i < 1211; i++)
-    unit->dline22[i] = 0.0;
-  for (int i = 0; i < 1379; i++)
-    unit->dline23[i] = 0.0;
+  memset(unit->ap_iota, 0, sizeof(unit->ap_iota));
+  memset(unit->ap_last, 0, sizeof(unit->ap_last));
+  memset(unit->ap_out, 0, sizeof(unit->ap_out));
+  memset(unit->comb_iota, 0, sizeof(unit->comb_iota));
+  memset(unit->comb_out, 0, sizeof(unit->comb_out));
+  memset(unit->comb_filt, 0, sizeof(unit->comb_filt));
+  memset(unit->lines.arena, 0, unit->lines.arena_size);
 }
 
-static void FreeVerb2_next(Reverb* rev, float** output, float** input,
-                           double* args, int inNumSamples) {
+static sc_always_inline void FreeVerb2_run(Reverb* rev, float** output, float** input,
+                                          double* args, int inNumSamples, const int storage) {
   FreeVerb2 * unit = rev->unit.fv2;
   float* input0 = input[0];
   float* input1 = input[1];
@@ -689,340 +628,794 @@ static void FreeVerb2_next(Reverb* rev, float** output, float** input,
   float ftemp6 = (0.400000f * damp);
   float ftemp7 = (1 - ftemp6);
 
-  float R0_0 = unit->R0_0;
-  float R1_0 = unit->R1_0;
-  float R2_0 = unit->R2_0;
-  float R3_0 = unit->R3_0;
-  float R4_0 = unit->R4_0;
-  float R5_0 = unit->R5_0;
-  float R6_0 = unit->R6_0;
-  float R7_0 = unit->R7_0;
-  float R8_0 = unit->R8_0;
-  float R9_0 = unit->R9_0;
-  float R10_0 = unit->R10_0;
-  float R11_0 = unit->R11_0;
-  float R12_0 = unit->R12_0;
-  float R13_0 = unit->R13_0;
-  float R14_0 = unit->R14_0;
-  float R15_0 = unit->R15_0;
-  float R16_0 = unit->R16_0;
-  float R17_0 = unit->R17_0;
-  float R18_0 = unit->R18_0;
-  float R19_0 = unit->R19_0;
-  float R20_0 = unit->R20_0;
-  float R21_0 = unit->R21_0;
-  float R22_0 = unit->R22_0;
-  float R23_0 = unit->R23_0;
-  float R24_0 = unit->R24_0;
-  float R25_0 = unit->R25_0;
-  float R26_0 = unit->R26_0;
-  float R27_0 = unit->R27_0;
-  float R28_0 = unit->R28_0;
-  float R29_0 = unit->R29_0;
-  float R30_0 = unit->R30_0;
-  float R31_0 = unit->R31_0;
-  float R32_0 = unit->R32_0;
-  float R33_0 = unit->R33_0;
-  float R34_0 = unit->R34_0;
-  float R35_0 = unit->R35_0;
-  float R36_0 = unit->R36_0;
-  float R37_0 = unit->R37_0;
-  float R38_0 = unit->R38_0;
-  float R39_0 = unit->R39_0;
-
-  float R0_1 = unit->R0_1;
-  float R1_1 = unit->R1_1;
-  float R2_1 = unit->R2_1;
-  float R3_1 = unit->R3_1;
-
-  float R23_1 = unit->R23_1;
-  float R22_1 = unit->R22_1;
-  float R21_1 = unit->R21_1;
-  float R20_1 = unit->R20_1;
-
-  int iota0 = unit->iota0;
-  int iota1 = unit->iota1;
-  int iota2 = unit->iota2;
-  int iota3 = unit->iota3;
-  int iota4 = unit->iota4;
-  int iota5 = unit->iota5;
-  int iota6 = unit->iota6;
-  int iota7 = unit->iota7;
-  int iota8 = unit->iota8;
-  int iota9 = unit->iota9;
-  int iota10 = unit->iota10;
-  int iota11 = unit->iota11;
-  int iota12 = unit->iota12;
-  int iota13 = unit->iota13;
-  int iota14 = unit->iota14;
-  int iota15 = unit->iota15;
-  int iota16 = unit->iota16;
-  int iota17 = unit->iota17;
-  int iota18 = unit->iota18;
-  int iota19 = unit->iota19;
-  int iota20 = unit->iota20;
-  int iota21 = unit->iota21;
-  int iota22 = unit->iota22;
-  int iota23 = unit->iota23;
-
-  float* dline0 = unit->dline0;
-  float* dline1 = unit->dline1;
-  float* dline2 = unit->dline2;
-  float* dline3 = unit->dline3;
-  float* dline4 = unit->dline4;
-  float* dline5 = unit->dline5;
-  float* dline6 = unit->dline6;
-  float* dline7 = unit->dline7;
-  float* dline8 = unit->dline8;
-  float* dline9 = unit->dline9;
-  float* dline10 = unit->dline10;
-  float* dline11 = unit->dline11;
-  float* dline12 = unit->dline12;
-  float* dline13 = unit->dline13;
-  float* dline14 = unit->dline14;
-  float* dline15 = unit->dline15;
-  float* dline16 = unit->dline16;
-  float* dline17 = unit->dline17;
-  float* dline18 = unit->dline18;
-  float* dline19 = unit->dline19;
-  float* dline20 = unit->dline20;
-  float* dline21 = unit->dline21;
-  float* dline22 = unit->dline22;
-  float* dline23 = unit->dline23;
+  float R0_0 = unit->ap_last[0];
+  float R1_0 = unit->ap_last[1];
+  float R2_0 = unit->ap_last[2];
+  float R3_0 = unit->ap_last[3];
+  float R4_0 = unit->comb_out[0];
+  float R5_0 = unit->comb_filt[0];
+  float R6_0 = unit->comb_out[1];
+  float R7_0 = unit->comb_filt[1];
+  float R8_0 = unit->comb_out[2];
+  float R9_0 = unit->comb_filt[2];
+  float R10_0 = unit->comb_out[3];
+  float R11_0 = unit->comb_filt[3];
+  float R12_0 = unit->comb_out[4];
+  float R13_0 = unit->comb_filt[4];
+  float R14_0 = unit->comb_out[5];
+  float R15_0 = unit->comb_filt[5];
+  float R16_0 = unit->comb_out[6];
+  float R17_0 = unit->comb_filt[6];
+  float R18_0 = unit->comb_out[7];
+  float R19_0 = unit->comb_filt[7];
+  float R20_0 = unit->ap_last[4];
+  float R21_0 = unit->ap_last[5];
+  float R22_0 = unit->ap_last[6];
+  float R23_0 = unit->ap_last[7];
+  float R24_0 = unit->comb_out[8];
+  float R25_0 = unit->comb_filt[8];
+  float R26_0 = unit->comb_out[9];
+  float R27_0 = unit->comb_filt[9];
+  float R28_0 = unit->comb_out[10];
+  float R29_0 = unit->comb_filt[10];
+  float R30_0 = unit->comb_out[11];
+  float R31_0 = unit->comb_filt[11];
+  float R32_0 = unit->comb_out[12];
+  float R33_0 = unit->comb_filt[12];
+  float R34_0 = unit->comb_out[13];
+  float R35_0 = unit->comb_filt[13];
+  float R36_0 = unit->comb_out[14];
+  float R37_0 = unit->comb_filt[14];
+  float R38_0 = unit->comb_out[15];
+  float R39_0 = unit->comb_filt[15];
+
+  float R0_1 = unit->ap_out[0];
+  float R1_1 = unit->ap_out[1];
+  float R2_1 = unit->ap_out[2];
+  float R3_1 = unit->ap_out[3];
+
+  float R23_1 = unit->ap_out[7];
+  float R22_1 = unit->ap_out[6];
+  float R21_1 = unit->ap_out[5];
+  float R20_1 = unit->ap_out[4];
+
+  int iota0 = unit->ap_iota[0];
+  int iota1 = unit->ap_iota[1];
+  int iota2 = unit->ap_iota[2];
+  int iota3 = unit->ap_iota[3];
+  int iota4 = unit->comb_iota[0];
+  int iota5 = unit->comb_iota[1];
+  int iota6 = unit->comb_iota[2];
+  int iota7 = unit->comb_iota[3];
+  int iota8 = unit->comb_iota[4];
+  int iota9 = unit->comb_iota[5];
+  int iota10 = unit->comb_iota[6];
+  int iota11 = unit->comb_iota[7];
+  int iota12 = unit->ap_iota[4];
+  int iota13 = unit->ap_iota[5];
+  int iota14 = unit->ap_iota[6];
+  int iota15 = unit->ap_iota[7];
+  int iota16 = unit->comb_iota[8];
+  int iota17 = unit->comb_iota[9];
+  int iota18 = unit->comb_iota[10];
+  int iota19 = unit->comb_iota[11];
+  int iota20 = unit->comb_iota[12];
+  int iota21 = unit->comb_iota[13];
+  int iota22 = unit->comb_iota[14];
+  int iota23 = unit->comb_iota[15];
+
+  void* dline0 = unit->lines.dline[0];
+  int len0 = unit->lines.len[0];
+  void* dline1 = unit->lines.dline[1];
+  int len1 = unit->lines.len[1];
+  void* dline2 = unit->lines.dline[2];
+  int len2 = unit->lines.len[2];
+  void* dline3 = unit->lines.dline[3];
+  int len3 = unit->lines.len[3];
+  void* dline4 = unit->lines.dline[4];
+  int len4 = unit->lines.len[4];
+  void* dline5 = unit->lines.dline[5];
+  int len5 = unit->lines.len[5];
+  void* dline6 = unit->lines.dline[6];
+  int len6 = unit->lines.len[6];
+  void* dline7 = unit->lines.dline[7];
+  int len7 = unit->lines.len[7];
+  void* dline8 = unit->lines.dline[8];
+  int len8 = unit->lines.len[8];
+  void* dline9 = unit->lines.dline[9];
+  int len9 = unit->lines.len[9];
+  void* dline10 = unit->lines.dline[10];
+  int len10 = unit->lines.len[10];
+  void* dline11 = unit->lines.dline[11];
+  int len11 = unit->lines.len[11];
+  void* dline12 = unit->lines.dline[12];
+  int len12 = unit->lines.len[12];
+  void* dline13 = unit->lines.dline[13];
+  int len13 = unit->lines.len[13];
+  void* dline14 = unit->lines.dline[14];
+  int len14 = unit->lines.len[14];
+  void* dline15 = unit->lines.dline[15];
+  int len15 = unit->lines.len[15];
+  void* dline16 = unit->lines.dline[16];
+  int len16 = unit->lines.len[16];
+  void* dline17 = unit->lines.dline[17];
+  int len17 = unit->lines.len[17];
+  void* dline18 = unit->lines.dline[18];
+  int len18 = unit->lines.len[18];
+  void* dline19 = unit->lines.dline[19];
+  int len19 = unit->lines.len[19];
+  void* dline20 = unit->lines.dline[20];
+  int len20 = unit->lines.len[20];
+  void* dline21 = unit->lines.dline[21];
+  int len21 = unit->lines.len[21];
+  void* dline22 = unit->lines.dline[22];
+  int len22 = unit->lines.len[22];
+  void* dline23 = unit->lines.dline[23];
+  int len23 = unit->lines.len[23];
 
   for (int i = 0; i < inNumSamples; i++) {
     float ftemp2 = input0[i];
-    if (++iota0 == 225)
+    if (++iota0 == len0)
       iota0 = 0;
-    float T0 = dline0[iota0];
-    if (++iota1 == 341)
+    float T0 = sc_load(dline0, iota0, storage);
+    if (++iota1 == len1)
       iota1 = 0;
-    float T1 = dline1[iota1];
-    if (++iota2 == 441)
+    float T1 = sc_load(dline1, iota1, storage);
+    if (++iota2 == len2)
       iota2 = 0;
-    float T2 = dline2[iota2];
-    if (++iota3 == 556)
+    float T2 = sc_load(dline2, iota2, storage);
+    if (++iota3 == len3)
       iota3 = 0;
-    float T3 = dline3[iota3];
-    if (++iota4 == 1617)
+    float T3 = sc_load(dline3, iota3, storage);
+    if (++iota4 == len4)
       iota4 = 0;
-    float T4 = dline4[iota4];
+    float T4 = sc_load(dline4, iota4, storage);
     float ftemp3 = input1[i];
     float ftemp4 = (1.500000e-02f * (ftemp2 + ftemp3));
     R5_0 = ((ftemp7 * R4_0) + (ftemp6 * R5_0));
-    dline4[iota4] = (ftemp4 + (ftemp5 * R5_0));
+    sc_store(dline4, iota4, (ftemp4 + (ftemp5 * R5_0)), storage);
     R4_0 = T4;
-    if (++iota5 == 1557)
+    if (++iota5 == len5)
       iota5 = 0;
-    float T5 = dline5[iota5];
+    float T5 = sc_load(dline5, iota5, storage);
     R7_0 = ((ftemp7 * R6_0) + (ftemp6 * R7_0));
-    dline5[iota5] = (ftemp4 + (ftemp5 * R7_0));
+    sc_store(dline5, iota5, (ftemp4 + (ftemp5 * R7_0)), storage);
     R6_0 = T5;
-    if (++iota6 == 1491)
+    if (++iota6 == len6)
       iota6 = 0;
-    float T6 = dline6[iota6];
+    float T6 = sc_load(dline6, iota6, storage);
     R9_0 = ((ftemp7 * R8_0) + (ftemp6 * R9_0));
-    dline6[iota6] = (ftemp4 + (ftemp5 * R9_0));
+    sc_store(dline6, iota6, (ftemp4 + (ftemp5 * R9_0)), storage);
     R8_0 = T6;
-    if (++iota7 == 1422)
+    if (++iota7 == len7)
       iota7 = 0;
-    float T7 = dline7[iota7];
+    float T7 = sc_load(dline7, iota7, storage);
     R11_0 = ((ftemp7 * R10_0) + (ftemp6 * R11_0));
-    dline7[iota7] = (ftemp4 + (ftemp5 * R11_0));
+    sc_store(dline7, iota7, (ftemp4 + (ftemp5 * R11_0)), storage);
     R10_0 = T7;
-    if (++iota8 == 1277)
+    if (++iota8 == len8)
       iota8 = 0;
-    float T8 = dline8[iota8];
+    float T8 = sc_load(dline8, iota8, storage);
     R13_0 = ((ftemp7 * R12_0) + (ftemp6 * R13_0));
-    dline8[iota8] = (ftemp4 + (ftemp5 * R13_0));
+    sc_store(dline8, iota8, (ftemp4 + (ftemp5 * R13_0)), storage);
     R12_0 = T8;
-    if (++iota9 == 1116)
+    if (++iota9 == len9)
       iota9 = 0;
-    float T9 = dline9[iota9];
+    float T9 = sc_load(dline9, iota9, storage);
     R15_0 = ((ftemp7 * R14_0) + (ftemp6 * R15_0));
-    dline9[iota9] = (ftemp4 + (ftemp5 * R15_0));
+    sc_store(dline9, iota9, (ftemp4 + (ftemp5 * R15_0)), storage);
     R14_0 = T9;
-    if (++iota10 == 1188)
+    if (++iota10 == len10)
       iota10 = 0;
-    float T10 = dline10[iota10];
+    float T10 = sc_load(dline10, iota10, storage);
     R17_0 = ((ftemp7 * R16_0) + (ftemp6 * R17_0));
-    dline10[iota10] = (ftemp4 + (ftemp5 * R17_0));
+    sc_store(dline10, iota10, (ftemp4 + (ftemp5 * R17_0)), storage);
     R16_0 = T10;
-    if (++iota11 == 1356)
+    if (++iota11 == len11)
       iota11 = 0;
-    float T11 = dline11[iota11];
+    float T11 = sc_load(dline11, iota11, storage);
     R19_0 = ((ftemp7 * R18_0) + (ftemp6 * R19_0));
-    dline11[iota11] = (ftemp4 + (ftemp5 * R19_0));
+    sc_store(dline11, iota11, (ftemp4 + (ftemp5 * R19_0)), storage);
     R18_0 = T11;
     float ftemp8 = (R16_0 + R18_0);
-    dline3[iota3] = ((((0.500000f * R3_0) + R4_0) + (R6_0 + R8_0)) + ((R10_0 + R12_0) + (R14_0 + ftemp8)));
+    sc_store(dline3, iota3, ((((0.500000f * R3_0) + R4_0) + (R6_0 + R8_0)) + ((R10_0 + R12_0) + (R14_0 + ftemp8))), storage);
     R3_0 = T3;
     R3_1 = (R3_0 - (((R4_0 + R6_0) + (R8_0 + R10_0)) + ((R12_0 + R14_0) + ftemp8)));
-    dline2[iota2] = ((0.500000f * R2_0) + R3_1);
+    sc_store(dline2, iota2, ((0.500000f * R2_0) + R3_1), storage);
     R2_0 = T2;
     R2_1 = (R2_0 - R3_1);
-    dline1[iota1] = ((0.500000f * R1_0) + R2_1);
+    sc_store(dline1, iota1, ((0.500000f * R1_0) + R2_1), storage);
     R1_0 = T1;
     R1_1 = (R1_0 - R2_1);
-    dline0[iota0] = ((0.500000f * R0_0) + R1_1);
+    sc_store(dline0, iota0, ((0.500000f * R0_0) + R1_1), storage);
     R0_0 = T0;
     R0_1 = (R0_0 - R1_1);
     output0[i] = ((ftemp1 * ftemp2) + (ftemp0 * R0_1));
 
     // right chn
-    if (++iota12 == 248)
+    if (++iota12 == len12)
       iota12 = 0;
-    float T12 = dline12[iota12];
-    if (++iota13 == 364)
+    float T12 = sc_load(dline12, iota12, storage);
+    if (++iota13 == len13)
       iota13 = 0;
-    float T13 = dline13[iota13];
-    if (++iota14 == 464)
+    float T13 = sc_load(dline13, iota13, storage);
+    if (++iota14 == len14)
       iota14 = 0;
-    float T14 = dline14[iota14];
-    if (++iota15 == 579)
+    float T14 = sc_load(dline14, iota14, storage);
+    if (++iota15 == len15)
       iota15 = 0;
-    float T15 = dline15[iota15];
-    if (++iota16 == 1640)
+    float T15 = sc_load(dline15, iota15, storage);
+    if (++iota16 == len16)
       iota16 = 0;
-    float T16 = dline16[iota16];
+    float T16 = sc_load(dline16, iota16, storage);
     R25_0 = ((ftemp7 * R24_0) + (ftemp6 * R25_0));
-    dline16[iota16] = (ftemp4 + (ftemp5 * R25_0));
+    sc_store(dline16, iota16, (ftemp4 + (ftemp5 * R25_0)), storage);
     R24_0 = T16;
-    if (++iota17 == 1580)
+    if (++iota17 == len17)
       iota17 = 0;
-    float T17 = dline17[iota17];
+    float T17 = sc_load(dline17, iota17, storage);
     R27_0 = ((ftemp7 * R26_0) + (ftemp6 * R27_0));
-    dline17[iota17] = (ftemp4 + (ftemp5 * R27_0));
+    sc_store(dline17, iota17, (ftemp4 + (ftemp5 * R27_0)), storage);
     R26_0 = T17;
-    if (++iota18 == 1514)
+    if (++iota18 == len18)
       iota18 = 0;
-    float T18 = dline18[iota18];
+    float T18 = sc_load(dline18, iota18, storage);
     R29_0 = ((ftemp7 * R28_0) + (ftemp6 * R29_0));
-    dline18[iota18] = (ftemp4 + (ftemp5 * R29_0));
+    sc_store(dline18, iota18, (ftemp4 + (ftemp5 * R29_0)), storage);
     R28_0 = T18;
-    if (++iota19 == 1445)
+    if (++iota19 == len19)
       iota19 = 0;
-    float T19 = dline19[iota19];
+    float T19 = sc_load(dline19, iota19, storage);
     R31_0 = ((ftemp7 * R30_0) + (ftemp6 * R31_0));
-    dline19[iota19] = (ftemp4 + (ftemp5 * R31_0));
+    sc_store(dline19, iota19, (ftemp4 + (ftemp5 * R31_0)), storage);
     R30_0 = T19;
-    if (++iota20 == 1300)
+    if (++iota20 == len20)
       iota20 = 0;
-    float T20 = dline20[iota20];
+    float T20 = sc_load(dline20, iota20, storage);
     R33_0 = ((ftemp7 * R32_0) + (ftemp6 * R33_0));
-    dline20[iota20] = (ftemp4 + (ftemp5 * R33_0));
+    sc_store(dline20, iota20, (ftemp4 + (ftemp5 * R33_0)), storage);
     R32_0 = T20;
-    if (++iota21 == 1139)
+    if (++iota21 == len21)
       iota21 = 0;
-    float T21 = dline21[iota21];
+    float T21 = sc_load(dline21, iota21, storage);
     R35_0 = ((ftemp7 * R34_0) + (ftemp6 * R35_0));
-    dline21[iota21] = (ftemp4 + (ftemp5 * R35_0));
+    sc_store(dline21, iota21, (ftemp4 + (ftemp5 * R35_0)), storage);
     R34_0 = T21;
-    if (++iota22 == 1211)
+    if (++iota22 == len22)
       iota22 = 0;
-    float T22 = dline22[iota22];
+    float T22 = sc_load(dline22, iota22, storage);
     R37_0 = ((ftemp7 * R36_0) + (ftemp6 * R37_0));
-    dline22[iota22] = (ftemp4 + (ftemp5 * R37_0));
+    sc_store(dline22, iota22, (ftemp4 + (ftemp5 * R37_0)), storage);
     R36_0 = T22;
-    if (++iota23 == 1379)
+    if (++iota23 == len23)
       iota23 = 0;
-    float T23 = dline23[iota23];
+    float T23 = sc_load(dline23, iota23, storage);
     R39_0 = ((ftemp7 * R38_0) + (ftemp6 * R39_0));
-    dline23[iota23] = (ftemp4 + (ftemp5 * R39_0));
+    sc_store(dline23, iota23, (ftemp4 + (ftemp5 * R39_0)), storage);
     R38_0 = T23;
     float ftemp9 = (R36_0 + R38_0);
-    dline15[iota15] = ((((0.500000f * R23_0) + R24_0) + (R26_0 + R28_0)) + ((R30_0 + R32_0) + (R34_0 + ftemp9)));
+    sc_store(dline15, iota15, ((((0.500000f * R23_0) + R24_0) + (R26_0 + R28_0)) + ((R30_0 + R32_0) + (R34_0 + ftemp9))), storage);
     R23_0 = T15;
     R23_1 = (R23_0 - (((R24_0 + R26_0) + (R28_0 + R30_0)) + ((R32_0 + R34_0) + ftemp9)));
-    dline14[iota14] = ((0.500000f * R22_0) + R23_1);
+    sc_store(dline14, iota14, ((0.500000f * R22_0) + R23_1), storage);
     R22_0 = T14;
     R22_1 = (R22_0 - R23_1);
-    dline13[iota13] = ((0.500000f * R21_0) + R22_1);
+    sc_store(dline13, iota13, ((0.500000f * R21_0) + R22_1), storage);
     R21_0 = T13;
     R21_1 = (R21_0 - R22_1);
-    dline12[iota12] = ((0.500000f * R20_0) + R21_1);
+    sc_store(dline12, iota12, ((0.500000f * R20_0) + R21_1), storage);
     R20_0 = T12;
     R20_1 = (R20_0 - R21_1);
     output1[i] = ((ftemp1 * ftemp3) + (ftemp0 * R20_1));
   }
 
-  unit->iota0 = iota0;
-  unit->iota1 = iota1;
-  unit->iota2 = iota2;
-  unit->iota3 = iota3;
-  unit->iota4 = iota4;
-  unit->iota5 = iota5;
-  unit->iota6 = iota6;
-  unit->iota7 = iota7;
-  unit->iota8 = iota8;
-  unit->iota9 = iota9;
-  unit->iota10 = iota10;
-  unit->iota11 = iota11;
-  unit->iota12 = iota12;
-  unit->iota13 = iota13;
-  unit->iota14 = iota14;
-  unit->iota15 = iota15;
-  unit->iota16 = iota16;
-  unit->iota17 = iota17;
-  unit->iota18 = iota18;
-  unit->iota19 = iota19;
-  unit->iota20 = iota20;
-  unit->iota21 = iota21;
-  unit->iota22 = iota22;
-  unit->iota23 = iota23;
-
-  unit->R0_1 = R0_1;
-  unit->R1_1 = R1_1;
-  unit->R2_1 = R2_1;
-  unit->R3_1 = R3_1;
-
-  unit->R20_1 = R20_1;
-  unit->R21_1 = R21_1;
-  unit->R22_1 = R22_1;
-  unit->R23_1 = R23_1;
-
-  unit->R0_0 = R0_0;
-  unit->R1_0 = R1_0;
-  unit->R2_0 = R2_0;
-  unit->R3_0 = R3_0;
-  unit->R4_0 = R4_0;
-  unit->R5_0 = R5_0;
-  unit->R6_0 = R6_0;
-  unit->R7_0 = R7_0;
-  unit->R8_0 = R8_0;
-  unit->R9_0 = R9_0;
-  unit->R10_0 = R10_0;
-  unit->R11_0 = R11_0;
-  unit->R12_0 = R12_0;
-  unit->R13_0 = R13_0;
-  unit->R14_0 = R14_0;
-  unit->R15_0 = R15_0;
-  unit->R16_0 = R16_0;
-  unit->R17_0 = R17_0;
-  unit->R18_0 = R18_0;
-  unit->R19_0 = R19_0;
-  unit->R20_0 = R20_0;
-  unit->R21_0 = R21_0;
-  unit->R22_0 = R22_0;
-  unit->R23_0 = R23_0;
-  unit->R24_0 = R24_0;
-  unit->R25_0 = R25_0;
-  unit->R26_0 = R26_0;
-  unit->R27_0 = R27_0;
-  unit->R28_0 = R28_0;
-  unit->R29_0 = R29_0;
-  unit->R30_0 = R30_0;
-  unit->R31_0 = R31_0;
-  unit->R32_0 = R32_0;
-  unit->R33_0 = R33_0;
-  unit->R34_0 = R34_0;
-  unit->R35_0 = R35_0;
-  unit->R36_0 = R36_0;
-  unit->R37_0 = R37_0;
-  unit->R38_0 = R38_0;
-  unit->R39_0 = R39_0;
+  unit->ap_iota[0] = iota0;
+  unit->ap_iota[1] = iota1;
+  unit->ap_iota[2] = iota2;
+  unit->ap_iota[3] = iota3;
+  unit->comb_iota[0] = iota4;
+  unit->comb_iota[1] = iota5;
+  unit->comb_iota[2] = iota6;
+  unit->comb_iota[3] = iota7;
+  unit->comb_iota[4] = iota8;
+  unit->comb_iota[5] = iota9;
+  unit->comb_iota[6] = iota10;
+  unit->comb_iota[7] = iota11;
+  unit->ap_iota[4] = iota12;
+  unit->ap_iota[5] = iota13;
+  unit->ap_iota[6] = iota14;
+  unit->ap_iota[7] = iota15;
+  unit->comb_iota[8] = iota16;
+  unit->comb_iota[9] = iota17;
+  unit->comb_iota[10] = iota18;
+  unit->comb_iota[11] = iota19;
+  unit->comb_iota[12] = iota20;
+  unit->comb_iota[13] = iota21;
+  unit->comb_iota[14] = iota22;
+  unit->comb_iota[15] = iota23;
+
+  unit->ap_out[0] = R0_1;
+  unit->ap_out[1] = R1_1;
+  unit->ap_out[2] = R2_1;
+  unit->ap_out[3] = R3_1;
+
+  unit->ap_out[4] = R20_1;
+  unit->ap_out[5] = R21_1;
+  unit->ap_out[6] = R22_1;
+  unit->ap_out[7] = R23_1;
+
+  unit->ap_last[0] = R0_0;
+  unit->ap_last[1] = R1_0;
+  unit->ap_last[2] = R2_0;
+  unit->ap_last[3] = R3_0;
+  unit->comb_out[0] = R4_0;
+  unit->comb_filt[0] = R5_0;
+  unit->comb_out[1] = R6_0;
+  unit->comb_filt[1] = R7_0;
+  unit->comb_out[2] = R8_0;
+  unit->comb_filt[2] = R9_0;
+  unit->comb_out[3] = R10_0;
+  unit->comb_filt[3] = R11_0;
+  unit->comb_out[4] = R12_0;
+  unit->comb_filt[4] = R13_0;
+  unit->comb_out[5] = R14_0;
+  unit->comb_filt[5] = R15_0;
+  unit->comb_out[6] = R16_0;
+  unit->comb_filt[6] = R17_0;
+  unit->comb_out[7] = R18_0;
+  unit->comb_filt[7] = R19_0;
+  unit->ap_last[4] = R20_0;
+  unit->ap_last[5] = R21_0;
+  unit->ap_last[6] = R22_0;
+  unit->ap_last[7] = R23_0;
+  unit->comb_out[8] = R24_0;
+  unit->comb_filt[8] = R25_0;
+  unit->comb_out[9] = R26_0;
+  unit->comb_filt[9] = R27_0;
+  unit->comb_out[10] = R28_0;
+  unit->comb_filt[10] = R29_0;
+  unit->comb_out[11] = R30_0;
+  unit->comb_filt[11] = R31_0;
+  unit->comb_out[12] = R32_0;
+  unit->comb_filt[12] = R33_0;
+  unit->comb_out[13] = R34_0;
+  unit->comb_filt[13] = R35_0;
+  unit->comb_out[14] = R36_0;
+  unit->comb_filt[14] = R37_0;
+  unit->comb_out[15] = R38_0;
+  unit->comb_filt[15] = R39_0;
+}
+
+/*  FreeVerb2 with the sixteen combs of both channels in two sc_v8f,
+    left and right, sharing the coefficients and the input sum. The
+    allpasses stay scalar, as in FreeVerb_simd_run the output is the
+    same as FreeVerb2_run's. 15 to 20% faster with float32 lines and
+    AVX, the lane by lane reads and writes of the separate lines bound
+    the gain.
+*/
+static sc_always_inline void FreeVerb2_simd_run(Reverb* rev, float** output, float** input,
+                                               double* args, int inNumSamples, const int storage) {
+  FreeVerb2 * unit = rev->unit.fv2;
+  float* input0 = input[0];
+  float* input1 = input[1];
+  float* output0 = output[0];
+  float* output1 = output[1];
+  float mix = fv_unit(args[0]);
+  float dry = (1 - mix);
+  float feedback = (0.700000f + (0.280000f * fv_unit(args[1])));
+  float damp = (0.400000f * fv_unit(args[2]));
+  float damp1 = (1 - damp);
+
+  int iota0 = unit->ap_iota[0];
+  int iota1 = unit->ap_iota[1];
+  int iota2 = unit->ap_iota[2];
+  int iota3 = unit->ap_iota[3];
+  int iota12 = unit->ap_iota[4];
+  int iota13 = unit->ap_iota[5];
+  int iota14 = unit->ap_iota[6];
+  int iota15 = unit->ap_iota[7];
+  float R0_1 = unit->ap_out[0];
+  float R1_1 = unit->ap_out[1];
+  float R2_1 = unit->ap_out[2];
+  float R3_1 = unit->ap_out[3];
+  float R0_0 = unit->ap_last[0];
+  float R1_0 = unit->ap_last[1];
+  float R2_0 = unit->ap_last[2];
+  float R3_0 = unit->ap_last[3];
+  float R20_1 = unit->ap_out[4];
+  float R21_1 = unit->ap_out[5];
+  float R22_1 = unit->ap_out[6];
+  float R23_1 = unit->ap_out[7];
+  float R20_0 = unit->ap_last[4];
+  float R21_0 = unit->ap_last[5];
+  float R22_0 = unit->ap_last[6];
+  float R23_0 = unit->ap_last[7];
+  void** dline = unit->lines.dline;
+  int* len = unit->lines.len;
+
+  void * const * left_line = &dline[4];
+  void * const * right_line = &dline[16];
+  sc_v8i left_idx, right_idx, left_len, right_len;
+  sc_v8f left_out, right_out, left_filt, right_filt;
+  memcpy(&left_idx, unit->comb_iota, sizeof(left_idx));
+  memcpy(&right_idx, unit->comb_iota + FV_COMBS, sizeof(right_idx));
+  memcpy(&left_len, &len[4], sizeof(left_len));
+  memcpy(&right_len, &len[16], sizeof(right_len));
+  memcpy(&left_out, unit->comb_out, sizeof(left_out));
+  memcpy(&right_out, unit->comb_out + FV_COMBS, sizeof(right_out));
+  memcpy(&left_filt, unit->comb_filt, sizeof(left_filt));
+  memcpy(&right_filt, unit->comb_filt + FV_COMBS, sizeof(right_filt));
+
+  for (int i = 0; i < inNumSamples; i++) {
+    float ftemp2 = input0[i];
+    float ftemp3 = input1[i];
+    float ftemp4 = (1.500000e-02f * (ftemp2 + ftemp3));
+
+    left_idx += 1;
+    left_idx &= (left_idx != left_len);
+    sc_v8f T;
+    for (int k = 0; k < FV_COMBS; k++)
+      T[k] = sc_load(left_line[k], left_idx[k], storage);
+    left_filt = (damp1 * left_out) + (damp * left_filt);
+    sc_v8f in = ftemp4 + (feedback * left_filt);
+    for (int k = 0; k < FV_COMBS; k++)
+      sc_store(left_line[k], left_idx[k], in[k], storage);
+    left_out = T;
+
+    right_idx += 1;
+    right_idx &= (right_idx != right_len);
+    for (int k = 0; k < FV_COMBS; k++)
+      T[k] = sc_load(right_line[k], right_idx[k], storage);
+    right_filt = (damp1 * right_out) + (damp * right_filt);
+    in = ftemp4 + (feedback * right_filt);
+    for (int k = 0; k < FV_COMBS; k++)
+      sc_store(right_line[k], right_idx[k], in[k], storage);
+    right_out = T;
+
+    if (++iota0 == len[0])
+      iota0 = 0;
+    float T0 = sc_load(dline[0], iota0, storage);
+    if (++iota1 == len[1])
+      iota1 = 0;
+    float T1 = sc_load(dline[1], iota1, storage);
+    if (++iota2 == len[2])
+      iota2 = 0;
+    float T2 = sc_load(dline[2], iota2, storage);
+    if (++iota3 == len[3])
+      iota3 = 0;
+    float T3 = sc_load(dline[3], iota3, storage);
+    float ftemp8 = (left_out[6] + left_out[7]);
+    sc_store(dline[3], iota3, ((((0.500000f * R3_0) + left_out[0]) + (left_out[1] + left_out[2])) + ((left_out[3] + left_out[4]) + (left_out[5] + ftemp8))), storage);
+    R3_0 = T3;
+    R3_1 = (R3_0 - (((left_out[0] + left_out[1]) + (left_out[2] + left_out[3])) + ((left_out[4] + left_out[5]) + ftemp8)));
+    sc_store(dline[2], iota2, ((0.500000f * R2_0) + R3_1), storage);
+    R2_0 = T2;
+    R2_1 = (R2_0 - R3_1);
+    sc_store(dline[1], iota1, ((0.500000f * R1_0) + R2_1), storage);
+    R1_0 = T1;
+    R1_1 = (R1_0 - R2_1);
+    sc_store(dline[0], iota0, ((0.500000f * R0_0) + R1_1), storage);
+    R0_0 = T0;
+    R0_1 = (R0_0 - R1_1);
+    output0[i] = ((dry * ftemp2) + (mix * R0_1));
+
+    // right chn
+    if (++iota12 == len[12])
+      iota12 = 0;
+    float T12 = sc_load(dline[12], iota12, storage);
+    if (++iota13 == len[13])
+      iota13 = 0;
+    float T13 = sc_load(dline[13], iota13, storage);
+    if (++iota14 == len[14])
+      iota14 = 0;
+    float T14 = sc_load(dline[14], iota14, storage);
+    if (++iota15 == len[15])
+      iota15 = 0;
+    float T15 = sc_load(dline[15], iota15, storage);
+    float ftemp9 = (right_out[6] + right_out[7]);
+    sc_store(dline[15], iota15, ((((0.500000f * R23_0) + right_out[0]) + (right_out[1] + right_out[2])) + ((right_out[3] + right_out[4]) + (right_out[5] + ftemp9))), storage);
+    R23_0 = T15;
+    R23_1 = (R23_0 - (((right_out[0] + right_out[1]) + (right_out[2] + right_out[3])) + ((right_out[4] + right_out[5]) + ftemp9)));
+    sc_store(dline[14], iota14, ((0.500000f * R22_0) + R23_1), storage);
+    R22_0 = T14;
+    R22_1 = (R22_0 - R23_1);
+    sc_store(dline[13], iota13, ((0.500000f * R21_0) + R22_1), storage);
+    R21_0 = T13;
+    R21_1 = (R21_0 - R22_1);
+    sc_store(dline[12], iota12, ((0.500000f * R20_0) + R21_1), storage);
+    R20_0 = T12;
+    R20_1 = (R20_0 - R21_1);
+    output1[i] = ((dry * ftemp3) + (mix * R20_1));
+  }
+
+  unit->ap_iota[0] = iota0;
+  unit->ap_iota[1] = iota1;
+  unit->ap_iota[2] = iota2;
+  unit->ap_iota[3] = iota3;
+  unit->ap_iota[4] = iota12;
+  unit->ap_iota[5] = iota13;
+  unit->ap_iota[6] = iota14;
+  unit->ap_iota[7] = iota15;
+  unit->ap_out[0] = R0_1;
+  unit->ap_out[1] = R1_1;
+  unit->ap_out[2] = R2_1;
+  unit->ap_out[3] = R3_1;
+  unit->ap_last[0] = R0_0;
+  unit->ap_last[1] = R1_0;
+  unit->ap_last[2] = R2_0;
+  unit->ap_last[3] = R3_0;
+  unit->ap_out[4] = R20_1;
+  unit->ap_out[5] = R21_1;
+  unit->ap_out[6] = R22_1;
+  unit->ap_out[7] = R23_1;
+  unit->ap_last[4] = R20_0;
+  unit->ap_last[5] = R21_0;
+  unit->ap_last[6] = R22_0;
+  unit->ap_last[7] = R23_0;
+  memcpy(unit->comb_iota, &left_idx, sizeof(left_idx));
+  memcpy(unit->comb_iota + FV_COMBS, &right_idx, sizeof(right_idx));
+  memcpy(unit->comb_out, &left_out, sizeof(left_out));
+  memcpy(unit->comb_out + FV_COMBS, &right_out, sizeof(right_out));
+  memcpy(unit->comb_filt, &left_filt, sizeof(left_filt));
+  memcpy(unit->comb_filt + FV_COMBS, &right_filt, sizeof(right_filt));
+}
+
+// One kernel per storage, see sc_load
+static void FreeVerb2_next(Reverb* rev, float** output, float** input,
+                           double* args, int inNumSamples) {
+  FreeVerb2_run(rev, output, input, args, inNumSamples, SC_STORE_F32);
+}
+
+static void FreeVerb2_next_f16(Reverb* rev, float** output, float** input,
+                               double* args, int inNumSamples) {
+  FreeVerb2_run(rev, output, input, args, inNumSamples, SC_STORE_F16);
+}
+
+static void FreeVerb2_next_i16(Reverb* rev, float** output, float** input,
+                               double* args, int inNumSamples) {
+  FreeVerb2_run(rev, output, input, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const freeverb2_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &FreeVerb2_next, &FreeVerb2_next_f16, &FreeVerb2_next_i16
+};
+
+static void FreeVerb2_simd_next(Reverb* rev, float** output, float** input,
+                                double* args, int inNumSamples) {
+  FreeVerb2_simd_run(rev, output, input, args, inNumSamples, SC_STORE_F32);
+}
+
+static void FreeVerb2_simd_next_f16(Reverb* rev, float** output, float** input,
+                                    double* args, int inNumSamples) {
+  FreeVerb2_simd_run(rev, output, input, args, inNumSamples, SC_STORE_F16);
+}
+
+static void FreeVerb2_simd_next_i16(Reverb* rev, float** output, float** input,
+                                    double* args, int inNumSamples) {
+  FreeVerb2_simd_run(rev, output, input, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const freeverb2_simd_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &FreeVerb2_simd_next, &FreeVerb2_simd_next_f16, &FreeVerb2_simd_next_i16
+};
+
+/*  Block FreeVerb. Every line is longer than a block pass, so within a
+    pass a line reads only samples written before it. Each line is run
+    over the whole pass before the next: its segment is read at once,
+    the new samples computed and the segment written at once, a line
+    streams through L1 once per pass instead of interleaving with the
+    other lines every sample. The eight comb lowpasses run through the
+    pass in the lanes of an sc_v8f. The comb sums are added in the
+    order of FreeVerb_run, the output is the same.
+
+    Lines in float16 and int16 convert a segment at a time, there the
+    block kernel is faster than the scalar one, 20% with -mavx and some
+    2x with F16C and AVX2. With float32 lines and -mavx it is on par at
+    small periods and slower at large ones, see get_kernel.
+*/
+
+typedef struct {
+  void * const * dline;     // 4 allpass lines, then 8 comb lines
+  const int * len;
+  int * ap_iota;
+  float * ap_last;
+  float * ap_out;
+  int * comb_iota;
+  float * comb_out;
+  float * comb_filt;
+} FVNet;
+
+// The n samples of a line after iota, wrapping at len, to x[i * stride]
+static sc_always_inline void fv_read(const void * line, int len, int iota, float * x, int stride,
+                                     int n, const int storage) {
+  int start = (iota + 1 == len) ? 0 : iota + 1;
+  int n1 = sc_min(n, len - start);
+  for (int i = 0; i < n1; i++)
+    x[i * stride] = sc_load(line, start + i, storage);
+  for (int i = n1; i < n; i++)
+    x[i * stride] = sc_load(line, i - n1, storage);
+}
+
+// Write the n samples after iota from x[i * stride], returns the new iota
+static sc_always_inline int fv_write(void * line, int len, int iota, const float * x, int stride,
+                                     int n, const int storage) {
+  int start = (iota + 1 == len) ? 0 : iota + 1;
+  int n1 = sc_min(n, len - start);
+  for (int i = 0; i < n1; i++)
+    sc_store(line, start + i, x[i * stride], storage);
+  for (int i = n1; i < n; i++)
+    sc_store(line, i - n1, x[i * stride], storage);
+  return (n > n1) ? n - n1 - 1 : start + n - 1;
+}
+
+// The combs over the pass in the lanes of an sc_v8f, what they read to
+// read, a row per sample
+static sc_always_inline void fv_comb_block(FVNet * net, const float * in,
+                                           sc_v8f * read, int n, float damp1,
+                                           float damp, float feedback, const int storage) {
+  sc_v8f w[FV_BLOCK];
+  sc_v8f out, filt;
+  for (int k = 0; k < FV_COMBS; k++) {
+    fv_read(net->dline[FV_ALLPASSES + k], net->len[FV_ALLPASSES + k],
+            net->comb_iota[k], (float *) read + k, FV_COMBS, n, storage);
+  }
+  memcpy(&out, net->comb_out, sizeof(out));
+  memcpy(&filt, net->comb_filt, sizeof(filt));
+  for (int i = 0; i < n; i++) {
+    filt = ((damp1 * out) + (damp * filt));
+    w[i] = (in[i] + (feedback * filt));
+    out = read[i];
+  }
+  for (int k = 0; k < FV_COMBS; k++) {
+    net->comb_iota[k] = fv_write(net->dline[FV_ALLPASSES + k], net->len[FV_ALLPASSES + k],
+                                 net->comb_iota[k], (float *) w + k, FV_COMBS, n, storage);
+  }
+  memcpy(net->comb_out, &out, sizeof(out));
+  memcpy(net->comb_filt, &filt, sizeof(filt));
+}
+
+// Allpass k over the pass, x from the previous allpass in, to the next out
+static sc_always_inline void fv_allpass_block(FVNet * net, int k, float * x, int n,
+                                              const int storage) {
+  float T[FV_BLOCK + 1], w[FV_BLOCK];
+  T[0] = net->ap_last[k];
+  fv_read(net->dline[k], net->len[k], net->ap_iota[k], T + 1, 1, n, storage);
+  for (int i = 0; i < n; i++) {
+    w[i] = ((0.500000f * T[i]) + x[i]);
+    x[i] = (T[i + 1] - x[i]);
+  }
+  net->ap_iota[k] = fv_write(net->dline[k], net->len[k], net->ap_iota[k], w, 1, n, storage);
+  net->ap_last[k] = T[n];
+  net->ap_out[k] = x[n - 1];
+}
+
+// One network over a pass of n samples, in the comb input, x the output
+// of the last allpass
+static sc_always_inline void fv_net_block(FVNet * net, const float * in, float * x, int n,
+                                          float damp1, float damp, float feedback,
+                                          const int storage) {
+  sc_v8f read[FV_BLOCK];
+  fv_comb_block(net, in, read, n, damp1, damp, feedback, storage);
+
+  // The first allpass adds its input to the comb sum
+  float T[FV_BLOCK + 1], w[FV_BLOCK];
+  T[0] = net->ap_last[3];
+  fv_read(net->dline[3], net->len[3], net->ap_iota[3], T + 1, 1, n, storage);
+  for (int i = 0; i < n; i++) {
+    float ftemp8 = (read[i][6] + read[i][7]);
+    w[i] = ((((0.500000f * T[i]) + read[i][0]) + (read[i][1] + read[i][2])) + ((read[i][3] + read[i][4]) + (read[i][5] + ftemp8)));
+    x[i] = (T[i + 1] - (((read[i][0] + read[i][1]) + (read[i][2] + read[i][3])) + ((read[i][4] + read[i][5]) + ftemp8)));
+  }
+  net->ap_iota[3] = fv_write(net->dline[3], net->len[3], net->ap_iota[3], w, 1, n, storage);
+  net->ap_last[3] = T[n];
+  net->ap_out[3] = x[n - 1];
+  fv_allpass_block(net, 2, x, n, storage);
+  fv_allpass_block(net, 1, x, n, storage);
+  fv_allpass_block(net, 0, x, n, storage);
+}
+
+static FVNet fv_net(FVLines * lines, int channel, int * ap_iota, float * ap_last, float * ap_out,
+                    int * comb_iota, float * comb_out, float * comb_filt) {
+  int l = channel * (FV_ALLPASSES + FV_COMBS);
+  return (FVNet) {
+    &lines->dline[l], &lines->len[l],
+    ap_iota + channel * FV_ALLPASSES, ap_last + channel * FV_ALLPASSES,
+    ap_out + channel * FV_ALLPASSES,
+    comb_iota + channel * FV_COMBS, comb_out + channel * FV_COMBS,
+    comb_filt + channel * FV_COMBS
+  };
+}
+
+static sc_always_inline void FreeVerb_block_run(Reverb * rev, float** output, float** input,
+                                               double* args, int inNumSamples, const int storage) {
+  FreeVerb * unit = rev->unit.fv;
+  float mix = fv_unit(args[0]);
+  float dry = (1 - mix);
+  float feedback = (0.700000f + (0.280000f * fv_unit(args[1])));
+  float damp = (0.400000f * fv_unit(args[2]));
+  float damp1 = (1 - damp);
+  FVNet net = fv_net(&unit->lines, 0, unit->ap_iota, unit->ap_last, unit->ap_out,
+                     unit->comb_iota, unit->comb_out, unit->comb_filt);
+  float in[FV_BLOCK], x[FV_BLOCK];
+
+  for (int done = 0; done < inNumSamples; done += unit->lines.block) {
+    int n = sc_min(inNumSamples - done, unit->lines.block);
+    float * input0 = input[0] + done;
+    float * output0 = output[0] + done;
+    for (int i = 0; i < n; i++)
+      in[i] = (1.500000e-02f * input0[i]);
+    fv_net_block(&net, in, x, n, damp1, damp, feedback, storage);
+    for (int i = 0; i < n; i++)
+      output0[i] = ((dry * input0[i]) + (mix * x[i]));
+  }
+}
+
+static sc_always_inline void FreeVerb2_block_run(Reverb * rev, float** output, float** input,
+                                                double* args, int inNumSamples, const int storage) {
+  FreeVerb2 * unit = rev->unit.fv2;
+  float mix = fv_unit(args[0]);
+  float dry = (1 - mix);
+  float feedback = (0.700000f + (0.280000f * fv_unit(args[1])));
+  float damp = (0.400000f * fv_unit(args[2]));
+  float damp1 = (1 - damp);
+  FVNet net[2];
+  for (int c = 0; c < 2; c++)
+    net[c] = fv_net(&unit->lines, c, unit->ap_iota, unit->ap_last, unit->ap_out,
+                    unit->comb_iota, unit->comb_out, unit->comb_filt);
+  float in[FV_BLOCK], x[FV_BLOCK];
+
+  for (int done = 0; done < inNumSamples; done += unit->lines.block) {
+    int n = sc_min(inNumSamples - done, unit->lines.block);
+    for (int i = 0; i < n; i++)
+      in[i] = (1.500000e-02f * (input[0][done + i] + input[1][done + i]));
+    for (int c = 0; c < 2; c++) {
+      float * input0 = input[c] + done;
+      float * output0 = output[c] + done;
+      fv_net_block(&net[c], in, x, n, damp1, damp, feedback, storage);
+      for (int i = 0; i < n; i++)
+        output0[i] = ((dry * input0[i]) + (mix * x[i]));
+    }
+  }
+}
+
+static void FreeVerb_block_next(Reverb* rev, float** output, float** input,
+                                double* args, int inNumSamples) {
+  FreeVerb_block_run(rev, output, input, args, inNumSamples, SC_STORE_F32);
+}
+
+static void FreeVerb_block_next_f16(Reverb* rev, float** output, float** input,
+                                    double* args, int inNumSamples) {
+  FreeVerb_block_run(rev, output, input, args, inNumSamples, SC_STORE_F16);
+}
+
+static void FreeVerb_block_next_i16(Reverb* rev, float** output, float** input,
+                                    double* args, int inNumSamples) {
+  FreeVerb_block_run(rev, output, input, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const freeverb_block_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &FreeVerb_block_next, &FreeVerb_block_next_f16, &FreeVerb_block_next_i16
+};
+
+static void FreeVerb2_block_next(Reverb* rev, float** output, float** input,
+                                 double* args, int inNumSamples) {
+  FreeVerb2_block_run(rev, output, input, args, inNumSamples, SC_STORE_F32);
 }
 
+static void FreeVerb2_block_next_f16(Reverb* rev, float** output, float** input,
+                                     double* args, int inNumSamples) {
+  FreeVerb2_block_run(rev, output, input, args, inNumSamples, SC_STORE_F16);
+}
+
+static void FreeVerb2_block_next_i16(Reverb* rev, float** output, float** input,
+                                     double* args, int inNumSamples) {
+  FreeVerb2_block_run(rev, output, input, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const freeverb2_block_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &FreeVerb2_block_next, &FreeVerb2_block_next_f16, &FreeVerb2_block_next_i16
+};
+
 
 #define TRUE 1
 #define FALSE 0
@@ -1082,66 +1475,59 @@ static inline int f_round(float f) {
   return p.i - 0x4b400000;
 }
 
-static g_damper* make_damper(GVerb* unit, float damping) {
-  g_damper* p;
-  p = (g_damper*)enif_alloc(sizeof(g_damper));
+static void init_damper(g_damper* p, float damping) {
   p->damping = damping;
   p->delay = 0.f;
-  return (p);
 }
 
-static void free_damper(GVerb* unit, g_damper* p) { enif_free(p); };
+// Smallest power of two >= n, at most 2^31
+static unsigned int g_pow2(unsigned int n) {
+  unsigned int size = 1;
+  while (size < n && size < (1U << 31)) size <<= 1;
+  return (size);
+}
 
-static g_diffuser* make_diffuser(GVerb* unit, int size, float coef) {
-  g_diffuser* p;
-  p = (g_diffuser*)enif_alloc(sizeof(g_diffuser));
+static void init_diffuser(g_diffuser* p, int size, float coef) {
+  // At least one sample, see GVERB_MAX_SPREAD
+  size = sc_max(size, 1);
   p->size = size;
+  p->mask = g_pow2(size) - 1;
   p->coef = coef;
   p->idx = 0;
-  p->buf = (float*)enif_alloc(size * sizeof(float));
-  for(int i = 0; i < size; i++) p->buf[i] = 0.f;
-  return (p);
 }
 
-static void free_diffuser(GVerb* unit, g_diffuser* p) {
-  enif_free(p->buf);
-  enif_free(p);
+// Bytes of a ring in the arena, rings start on cache lines
+static size_t g_ring_bytes(unsigned int mask, int storage) {
+  return (((mask + 1) * sc_storage_size(storage) + SC_CACHE_LINE - 1) & ~(SC_CACHE_LINE - 1));
 }
 
-static g_fixeddelay* make_fixeddelay(GVerb* unit, int size, int maxsize) {
-  g_fixeddelay* p;
-  p = (g_fixeddelay*)enif_alloc(sizeof(g_fixeddelay));
-  p->size = size;
+// A ring reading up to maxsize samples back
+static void init_fixeddelay(g_fixeddelay* p, int maxsize) {
+  p->mask = g_pow2(maxsize) - 1;
   p->idx = 0;
-  p->buf = (float*)enif_alloc(maxsize * sizeof(float));
-  for(int i = 0; i < maxsize; i++) p->buf[i] = 0.f;
-  return (p);
 }
 
-static void free_fixeddelay(GVerb* unit, g_fixeddelay* p) {
-  enif_free(p->buf);
-  enif_free(p);
-}
-
-static inline float diffuser_do(GVerb* unit, g_diffuser* p, float x) {
+static sc_always_inline float diffuser_do(GVerb* unit, g_diffuser* p, float x,
+                                          const int storage) {
   float y, w;
-  w = x - p->buf[p->idx] * p->coef;
+  float delayed = sc_load(p->buf, (p->idx - p->size) & p->mask, storage);
+  w = x - delayed * p->coef;
   w = flush_to_zero(w);
-  y = p->buf[p->idx] + w * p->coef;
-  p->buf[p->idx] = zapgremlins(w);
-  p->idx = (p->idx + 1) % p->size;
+  y = delayed + w * p->coef;
+  sc_store(p->buf, p->idx, zapgremlins(w), storage);
+  p->idx = (p->idx + 1) & p->mask;
   return (y);
 }
 
-static inline float fixeddelay_read(GVerb* unit, g_fixeddelay* p, int n) {
-  int i;
-  i = (p->idx - n + p->size) % p->size;
-  return (p->buf[i]);
+static sc_always_inline float fixeddelay_read(GVerb* unit, g_fixeddelay* p, int n,
+                                              const int storage) {
+  return (sc_load(p->buf, (p->idx - n) & p->mask, storage));
 }
 
-static inline void fixeddelay_write(GVerb* unit, g_fixeddelay* p, float x) {
-  p->buf[p->idx] = zapgremlins(x);
-  p->idx = (p->idx + 1) % p->size;
+static sc_always_inline void fixeddelay_write(GVerb* unit, g_fixeddelay* p, float x,
+                                              const int storage) {
+  sc_store(p->buf, p->idx, zapgremlins(x), storage);
+  p->idx = (p->idx + 1) & p->mask;
 }
 
 static inline void damper_set(GVerb* unit, g_damper* p, float damping) { p->damping = damping; }
@@ -1222,13 +1608,13 @@ static inline void gverb_set_damping(GVerb* unit, float a) {
 
   unit->damping = a;
   for (i = 0; i < FDNORDER; i++) {
-    damper_set(unit, unit->fdndamps[i], unit->damping);
+    damper_set(unit, &unit->fdndamps[i], unit->damping);
   }
 }
 
 static inline void gverb_set_inputbandwidth(GVerb* unit, float a) {
   unit->inputbandwidth = a;
-  damper_set(unit, unit->inputdamper, 1.0 - unit->inputbandwidth);
+  damper_set(unit, &unit->inputdamper, 1.0 - unit->inputbandwidth);
 }
 
 static inline float gverb_set_earlylevel(GVerb* unit, float a) {
@@ -1252,15 +1638,19 @@ static inline float gverb_set_drylevel(GVerb* unit, float a) {
   return (olddry);
 }
 
+// Sizes the rings from maxroomsize and the rate, then allocates the
+// unit and its arena in one block.
 static void GVerb_Ctor(Reverb * rev, double * args) {
-  GVerb * unit = rev->unit.gv;
+  GVerb gv;
+  GVerb * unit = &gv;
+  memset(unit, 0, sizeof(GVerb));
   unit->rate = (float) rev->rate;
   unit->period_size = (float) rev->period_size;
   float roomsize = unit->roomsize = args[0];
   float revtime = unit->revtime = args[1];
   float damping = unit->damping = args[2];
   float inputbandwidth = unit->inputbandwidth = 0.; // IN0(4);
-  float spread = unit->spread = args[4]; // IN0(5);
+  float spread = unit->spread = sc_min(sc_max(args[4], 0.f), GVERB_MAX_SPREAD); // IN0(5);
   unit->drylevel = 0.; // IN0(6);
   unit->earlylevel = 0.; // IN0(7);
   unit->taillevel = 0.; // IN0(8);
@@ -1271,7 +1661,7 @@ static void GVerb_Ctor(Reverb * rev, double * args) {
   float largestdelay = unit->largestdelay = unit->rate * roomsize / 340.f;
 
   // make the inputdamper
-  unit->inputdamper = make_damper(unit, 1. - inputbandwidth);
+  init_damper(&unit->inputdamper, 1. - inputbandwidth);
 
   // float ga = powf(10.f, -60.f/20.f);
   float ga = 0.001f;
@@ -1289,8 +1679,8 @@ static void GVerb_Ctor(Reverb * rev, double * args) {
   }
   // make the fixeddelay lines and dampers
   for (int i = 0; i < FDNORDER; i++) {
-    unit->fdndels[i] = make_fixeddelay(unit, (int)unit->fdnlens[i], (int)maxdelay + 1000);
-    unit->fdndamps[i] = make_damper(unit, damping); // damping is the same as fdndamping in source
+    init_fixeddelay(&unit->fdndels[i], (int)maxdelay + 1000);
+    init_damper(&unit->fdndamps[i], damping); // damping is the same as fdndamping in source
   }
 
   // diffuser section
@@ -1309,10 +1699,10 @@ static void GVerb_Ctor(Reverb * rev, double * args) {
   int dd = d - c;
   int e = 1341 - d;
 
-  unit->ldifs[0] = make_diffuser(unit, f_round(diffscale * b), 0.75);
-  unit->ldifs[1] = make_diffuser(unit, f_round(diffscale * cc), 0.75);
-  unit->ldifs[2] = make_diffuser(unit, f_round(diffscale * dd), 0.625);
-  unit->ldifs[3] = make_diffuser(unit, f_round(diffscale * e), 0.625);
+  init_diffuser(&unit->ldifs[0], f_round(diffscale * b), 0.75);
+  init_diffuser(&unit->ldifs[1], f_round(diffscale * cc), 0.75);
+  init_diffuser(&unit->ldifs[2], f_round(diffscale * dd), 0.625);
+  init_diffuser(&unit->ldifs[3], f_round(diffscale * e), 0.625);
   b = 210;
   r = -0.568366;
   a = (int)(spread1 * r);
@@ -1324,10 +1714,10 @@ static void GVerb_Ctor(Reverb * rev, double * args) {
   dd = d - c;
   e = 1341 - d;
 
-  unit->rdifs[0] = make_diffuser(unit, f_round(diffscale * b), 0.75);
-  unit->rdifs[1] = make_diffuser(unit, f_round(diffscale * cc), 0.75);
-  unit->rdifs[2] = make_diffuser(unit, f_round(diffscale * dd), 0.625);
-  unit->rdifs[3] = make_diffuser(unit, f_round(diffscale * e), 0.625);
+  init_diffuser(&unit->rdifs[0], f_round(diffscale * b), 0.75);
+  init_diffuser(&unit->rdifs[1], f_round(diffscale * cc), 0.75);
+  init_diffuser(&unit->rdifs[2], f_round(diffscale * dd), 0.625);
+  init_diffuser(&unit->rdifs[3], f_round(diffscale * e), 0.625);
 
   unit->taps[0] = 5 + (int)(0.410 * largestdelay);
   unit->taps[1] = 5 + (int)(0.300 * largestdelay);
@@ -1338,7 +1728,33 @@ static void GVerb_Ctor(Reverb * rev, double * args) {
     unit->tapgains[i] = pow(alpha, (double)unit->taps[i]);
   }
 
-  unit->tapdelay = make_fixeddelay(unit, 44000, 44000);
+  // The longest tap at maxroomsize
+  init_fixeddelay(&unit->tapdelay, 5 + (int)(0.410 * maxdelay) + 1);
+
+  size_t head = (sizeof(GVerb) + SC_CACHE_LINE - 1) & ~(SC_CACHE_LINE - 1);
+  size_t arena_size = g_ring_bytes(unit->tapdelay.mask, rev->storage);
+  for (int i = 0; i < FDNORDER; i++) {
+    arena_size += g_ring_bytes(unit->fdndels[i].mask, rev->storage)
+      + g_ring_bytes(unit->ldifs[i].mask, rev->storage)
+      + g_ring_bytes(unit->rdifs[i].mask, rev->storage);
+  }
+  rev->mem = sc_delay_alloc(head + arena_size + SC_CACHE_LINE);
+  sc_mem_grow(&rev->sc.mem, head + arena_size + SC_CACHE_LINE);
+  unit = rev->unit.gv = sc_align_cache(rev->mem);
+  *unit = gv;
+  unit->arena = (char *) unit + head;
+  unit->arena_size = arena_size;
+  memset(unit->arena, 0, arena_size);
+  char * buf = unit->arena;
+  for (int i = 0; i < FDNORDER; i++) {
+    unit->fdndels[i].buf = buf;
+    buf += g_ring_bytes(unit->fdndels[i].mask, rev->storage);
+    unit->ldifs[i].buf = buf;
+    buf += g_ring_bytes(unit->ldifs[i].mask, rev->storage);
+    unit->rdifs[i].buf = buf;
+    buf += g_ring_bytes(unit->rdifs[i].mask, rev->storage);
+  }
+  unit->tapdelay.buf = buf;
 
   // init the slope values
   unit->earlylevelslope = unit->drylevelslope = unit->taillevelslope = 0.f;
@@ -1350,20 +1766,25 @@ static void GVerb_Ctor(Reverb * rev, double * args) {
   /* ClearUnitOutputs(unit, 1); */
 }
 
-static void GVerb_Dtor(Reverb* rev) {
+// Clear the delay lines and filter states, keeping the allocations.
+// Levels restart from 0 and ramp in as for a new unit.
+static void GVerb_Reset(Reverb* rev, double * args) {
   GVerb * unit = rev->unit.gv;
-  free_damper(unit, unit->inputdamper);
-  free_fixeddelay(unit, unit->tapdelay);
-
+  unit->inputbandwidth = unit->drylevel = unit->earlylevel = unit->taillevel = 0.f;
+  unit->inputdamper.delay = 0.f;
+  memset(unit->arena, 0, unit->arena_size);
   for (int i = 0; i < FDNORDER; i++) {
-    free_fixeddelay(unit, unit->fdndels[i]);
-    free_damper(unit, unit->fdndamps[i]);
-    free_diffuser(unit, unit->ldifs[i]);
-    free_diffuser(unit, unit->rdifs[i]);
+    unit->fdndels[i].idx = 0;
+    unit->fdndamps[i].delay = 0.f;
+    unit->ldifs[i].idx = 0;
+    unit->rdifs[i].idx = 0;
+    unit->u[i] = unit->f[i] = unit->d[i] = 0.f;
   }
+  unit->tapdelay.idx = 0;
 }
 
-static void GVerb_next(Reverb* rev, float** out, float** in_array, double* args, int inNumSamples) {
+static sc_always_inline void GVerb_run(Reverb* rev, float** out, float** in_array, double* args,
+                                      int inNumSamples, const int storage) {
   GVerb * unit = rev->unit.gv;
   float* in = in_array[0];
   float* outl = out[0];
@@ -1379,17 +1800,17 @@ static void GVerb_next(Reverb* rev, float** out, float** in_array, double* args,
   float earlylevelslope, taillevelslope, drylevelslope;
   float* fdngainslopes;
   float* tapgainslopes;
-  g_diffuser** ldifs = unit->ldifs;
-  g_diffuser** rdifs = unit->rdifs;
+  g_diffuser* ldifs = unit->ldifs;
+  g_diffuser* rdifs = unit->rdifs;
   float* u = unit->u;
   float* f = unit->f;
   float* d = unit->d;
-  g_damper* inputdamper = unit->inputdamper;
+  g_damper* inputdamper = &unit->inputdamper;
   float* tapgains = unit->tapgains;
-  g_fixeddelay* tapdelay = unit->tapdelay;
+  g_fixeddelay* tapdelay = &unit->tapdelay;
   int* taps = unit->taps;
-  g_damper** fdndamps = unit->fdndamps;
-  g_fixeddelay** fdndels = unit->fdndels;
+  g_damper* fdndamps = unit->fdndamps;
+  g_fixeddelay* fdndels = unit->fdndels;
   float* fdngains = unit->fdngains;
   int* fdnlens = unit->fdnlens;
 
@@ -1423,16 +1844,16 @@ static void GVerb_next(Reverb* rev, float** out, float** in_array, double* args,
     sign = 1.f;
 
     float z = damper_do(unit, inputdamper, x);
-    z = diffuser_do(unit, ldifs[0], z);
+    z = diffuser_do(unit, &ldifs[0], z, storage);
 
     for (int j = 0; j < FDNORDER; j++) {
-      u[j] = tapgains[j] * fixeddelay_read(unit, tapdelay, taps[j]);
+      u[j] = tapgains[j] * fixeddelay_read(unit, tapdelay, taps[j], storage);
     }
 
-    fixeddelay_write(unit, tapdelay, z);
+    fixeddelay_write(unit, tapdelay, z, storage);
 
     for (int j = 0; j < FDNORDER; j++) {
-      d[j] = damper_do(unit, fdndamps[j], fdngains[j] * fixeddelay_read(unit, fdndels[j], fdnlens[j]));
+      d[j] = damper_do(unit, &fdndamps[j], fdngains[j] * fixeddelay_read(unit, &fdndels[j], fdnlens[j], storage));
     }
 
     for (int j = 0; j < FDNORDER; j++) {
@@ -1447,15 +1868,15 @@ static void GVerb_next(Reverb* rev, float** out, float** in_array, double* args,
     gverb_fdnmatrix(d, f);
 
     for (int j = 0; j < FDNORDER; j++) {
-      fixeddelay_write(unit, fdndels[j], u[j] + f[j]);
+      fixeddelay_write(unit, &fdndels[j], u[j] + f[j], storage);
     }
 
-    lsum = diffuser_do(unit, ldifs[1], lsum);
-    lsum = diffuser_do(unit, ldifs[2], lsum);
-    lsum = diffuser_do(unit, ldifs[3], lsum);
-    rsum = diffuser_do(unit, rdifs[1], rsum);
-    rsum = diffuser_do(unit, rdifs[2], rsum);
-    rsum = diffuser_do(unit, rdifs[3], rsum);
+    lsum = diffuser_do(unit, &ldifs[1], lsum, storage);
+    lsum = diffuser_do(unit, &ldifs[2], lsum, storage);
+    lsum = diffuser_do(unit, &ldifs[3], lsum, storage);
+    rsum = diffuser_do(unit, &rdifs[1], rsum, storage);
+    rsum = diffuser_do(unit, &rdifs[2], rsum, storage);
+    rsum = diffuser_do(unit, &rdifs[3], rsum, storage);
 
     x = x * drylevel;
     outl[i] = lsum + x;
@@ -1472,28 +1893,208 @@ static void GVerb_next(Reverb* rev, float** out, float** in_array, double* args,
 
   // store vals back to the struct
   for (int i = 0; i < FDNORDER; i++) {
-    unit->ldifs[i] = ldifs[i];
-    unit->rdifs[i] = rdifs[i];
-    unit->u[i] = u[i];
-    unit->f[i] = f[i];
-    unit->d[i] = d[i];
-    unit->tapgains[i] = tapgains[i];
-    unit->taps[i] = taps[i];
-    unit->fdndamps[i] = fdndamps[i];
-    unit->fdndels[i] = fdndels[i];
-    unit->fdngains[i] = fdngains[i];
-    unit->fdnlens[i] = fdnlens[i];
     unit->fdngainslopes[i] = 0.f;
     unit->tapgainslopes[i] = 0.f;
   }
-  unit->inputdamper = inputdamper;
-  unit->tapdelay = tapdelay;
   // clear the slopes
   unit->earlylevelslope = unit->taillevelslope = unit->drylevelslope = 0.f;
 }
 
+// One kernel per storage, see sc_load
+static void GVerb_next(Reverb* rev, float** out, float** in, double* args, int inNumSamples) {
+  GVerb_run(rev, out, in, args, inNumSamples, SC_STORE_F32);
+}
+
+static void GVerb_next_f16(Reverb* rev, float** out, float** in, double* args, int inNumSamples) {
+  GVerb_run(rev, out, in, args, inNumSamples, SC_STORE_F16);
+}
+
+static void GVerb_next_i16(Reverb* rev, float** out, float** in, double* args, int inNumSamples) {
+  GVerb_run(rev, out, in, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const gverb_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &GVerb_next, &GVerb_next_f16, &GVerb_next_i16
+};
+
+/*  GVerb with the four FDN lines and the four taps in the lanes of an
+    sc_v4f. The reads and writes go to separate lines or taps, lane by
+    lane, the gains, dampers, Hadamard matrix and zapgremlins are lane
+    wise. The dampers are computed in double as damper_do does and the
+    matrix adds its terms in the order of gverb_fdnmatrix, the output
+    is the same as the scalar kernel's. The diffusers are chained and
+    stay scalar.
+*/
+
+// zapgremlins lane wise
+static sc_always_inline sc_v4f gverb_zap4(sc_v4f x) {
+  sc_v4f absx = (sc_v4f) ((sc_v4i) x & 0x7fffffff);
+  return (sc_v4f) ((sc_v4i) x & ((absx > (float)1e-15) & (absx < (float)1e15)));
+}
+
+// gverb_fdnmatrix, lane j is b[j]
+static sc_always_inline sc_v4f gverb_fdnmatrix4(sc_v4f a) {
+  const sc_v4f s0 = {+1.f, +1.f, -1.f, +1.f};
+  const sc_v4f s1 = {+1.f, -1.f, +1.f, +1.f};
+  const sc_v4f s2 = {-1.f, -1.f, -1.f, +1.f};
+  const sc_v4f s3 = {-1.f, +1.f, +1.f, +1.f};
+  return 0.5f * ((((s0 * a[0]) + (s1 * a[1])) + (s2 * a[2])) + (s3 * a[3]));
+}
+
+static sc_always_inline void GVerb_simd_run(Reverb* rev, float** out, float** in_array,
+                                           double* args, int inNumSamples, const int storage) {
+  GVerb * unit = rev->unit.gv;
+  float* in = in_array[0];
+  float* outl = out[0];
+  float* outr = out[1];
+  float roomsize = args[0];
+  float revtime = args[1];
+  float damping = args[2];
+  float inputbandwidth = args[3];
+  float drylevel = args[5];
+  float earlylevel = args[6];
+  float taillevel = args[7];
+  g_diffuser* ldifs = unit->ldifs;
+  g_diffuser* rdifs = unit->rdifs;
+  g_damper* inputdamper = &unit->inputdamper;
+  g_fixeddelay* tapdelay = &unit->tapdelay;
+
+  if ((roomsize != unit->roomsize) || (revtime != unit->revtime) || (damping != unit->damping)
+      || (inputbandwidth != unit->inputbandwidth) || (drylevel != unit->drylevel) || (earlylevel != unit->earlylevel)
+      || (taillevel != unit->taillevel)) {
+    gverb_set_roomsize(unit, roomsize);
+    gverb_set_revtime(unit, revtime);
+    gverb_set_damping(unit, damping);
+    gverb_set_inputbandwidth(unit, inputbandwidth);
+    drylevel = gverb_set_drylevel(unit, drylevel);
+    earlylevel = gverb_set_earlylevel(unit, earlylevel);
+    taillevel = gverb_set_taillevel(unit, taillevel);
+  }
+
+  float earlylevelslope = unit->earlylevelslope;
+  float taillevelslope = unit->taillevelslope;
+  float drylevelslope = unit->drylevelslope;
+
+  void * fdnbuf[FDNORDER];
+  sc_v4i fdnidx, fdnmask, fdnlens, taps;
+  sc_v4f fdngains, fdngainslopes, tapgains, tapgainslopes, fdndamping, fdndelay;
+  for (int j = 0; j < FDNORDER; j++) {
+    fdnbuf[j] = unit->fdndels[j].buf;
+    fdnidx[j] = unit->fdndels[j].idx;
+    fdnmask[j] = unit->fdndels[j].mask;
+    fdndamping[j] = unit->fdndamps[j].damping;
+    fdndelay[j] = unit->fdndamps[j].delay;
+  }
+  memcpy(&fdnlens, unit->fdnlens, sizeof(fdnlens));
+  memcpy(&taps, unit->taps, sizeof(taps));
+  memcpy(&fdngains, unit->fdngains, sizeof(fdngains));
+  memcpy(&fdngainslopes, unit->fdngainslopes, sizeof(fdngainslopes));
+  memcpy(&tapgains, unit->tapgains, sizeof(tapgains));
+  memcpy(&tapgainslopes, unit->tapgainslopes, sizeof(tapgainslopes));
+  const sc_v4d fdndamping1 = 1.0 - __builtin_convertvector(fdndamping, sc_v4d);
+  sc_v4f u = {0}, d = {0}, f = {0};
+
+  for (int i = 0; i < inNumSamples; i++) {
+    float sum, lsum, rsum, x;
+    if (isnan(in[i]))
+      x = 0.f;
+    else
+      x = in[i];
+
+    float z = damper_do(unit, inputdamper, x);
+    z = diffuser_do(unit, &ldifs[0], z, storage);
+
+    sc_v4i tapread = ((int) tapdelay->idx - taps) & (int) tapdelay->mask;
+    sc_v4f tap;
+    for (int j = 0; j < FDNORDER; j++)
+      tap[j] = sc_load(tapdelay->buf, tapread[j], storage);
+    u = tapgains * tap;
+
+    fixeddelay_write(unit, tapdelay, z, storage);
+
+    sc_v4i fdnread = (fdnidx - fdnlens) & fdnmask;
+    sc_v4f fdn;
+    for (int j = 0; j < FDNORDER; j++)
+      fdn[j] = sc_load(fdnbuf[j], fdnread[j], storage);
+    // damper_do, x * (1.0 - damping) in double
+    sc_v4d y = __builtin_convertvector(fdngains * fdn, sc_v4d) * fdndamping1 +
+      __builtin_convertvector(fdndelay * fdndamping, sc_v4d);
+    d = __builtin_convertvector(y, sc_v4f);
+    fdndelay = gverb_zap4(d);
+
+    sc_v4f t = (taillevel * d) + (earlylevel * u);
+    sum = ((((0.f + t[0]) - t[1]) + t[2]) - t[3]);
+
+    sum += x * earlylevel;
+    lsum = sum;
+    rsum = sum;
+
+    f = gverb_fdnmatrix4(d);
+
+    sc_v4f w = gverb_zap4(u + f);
+    for (int j = 0; j < FDNORDER; j++)
+      sc_store(fdnbuf[j], fdnidx[j], w[j], storage);
+    fdnidx = (fdnidx + 1) & fdnmask;
+
+    lsum = diffuser_do(unit, &ldifs[1], lsum, storage);
+    lsum = diffuser_do(unit, &ldifs[2], lsum, storage);
+    lsum = diffuser_do(unit, &ldifs[3], lsum, storage);
+    rsum = diffuser_do(unit, &rdifs[1], rsum, storage);
+    rsum = diffuser_do(unit, &rdifs[2], rsum, storage);
+    rsum = diffuser_do(unit, &rdifs[3], rsum, storage);
+
+    x = x * drylevel;
+    outl[i] = lsum + x;
+    outr[i] = rsum + x;
+
+    drylevel += drylevelslope;
+    taillevel += taillevelslope;
+    earlylevel += earlylevelslope;
+    fdngains += fdngainslopes;
+    tapgains += tapgainslopes;
+  }
+
+  for (int j = 0; j < FDNORDER; j++) {
+    unit->fdndels[j].idx = fdnidx[j];
+    unit->fdndamps[j].delay = fdndelay[j];
+  }
+  memcpy(unit->fdngains, &fdngains, sizeof(fdngains));
+  memcpy(unit->tapgains, &tapgains, sizeof(tapgains));
+  memcpy(unit->u, &u, sizeof(u));
+  memcpy(unit->d, &d, sizeof(d));
+  memcpy(unit->f, &f, sizeof(f));
+  // clear the slopes
+  memset(unit->fdngainslopes, 0, sizeof(unit->fdngainslopes));
+  memset(unit->tapgainslopes, 0, sizeof(unit->tapgainslopes));
+  unit->earlylevelslope = unit->taillevelslope = unit->drylevelslope = 0.f;
+}
+
+static void GVerb_simd_next(Reverb* rev, float** out, float** in, double* args, int inNumSamples) {
+  GVerb_simd_run(rev, out, in, args, inNumSamples, SC_STORE_F32);
+}
+
+static void GVerb_simd_next_f16(Reverb* rev, float** out, float** in, double* args,
+                                int inNumSamples) {
+  GVerb_simd_run(rev, out, in, args, inNumSamples, SC_STORE_F16);
+}
+
+static void GVerb_simd_next_i16(Reverb* rev, float** out, float** in, double* args,
+                                int inNumSamples) {
+  GVerb_simd_run(rev, out, in, args, inNumSamples, SC_STORE_I16);
+}
+
+static void (* const gverb_simd_kernels[])(Reverb*, float**, float**, double*, int) = {
+  &GVerb_simd_next, &GVerb_simd_next_f16, &GVerb_simd_next_i16
+};
+
 /* ---------------------------------------------------------- */
 
+// Live instances and bytes per reverb type, see sc_mem_charge
+#define REVERB_MEM_TYPES 3
+static SCMemType reverb_mem[REVERB_MEM_TYPES] = {
+  {"freeverb"}, {"freeverb2"}, {"gverb"}
+};
+
 // ErlNifResourceDtor
 static void reverb_resource_dtor(ErlNifEnv* env, void * obj){
   Reverb * rev = (Reverb*) obj;
@@ -1501,12 +2102,75 @@ static void reverb_resource_dtor(ErlNifEnv* env, void * obj){
   if(rev->dtor) {
     (*rev->dtor)(rev);
   }
-  enif_free((void*)rev->unit.fv);
+  // GVerb allocates in its Ctor, on the first call
+  if(rev->mem) {
+    sc_delay_free(rev->mem);
+  }
+  sc_unit_release(&rev->sc);
+}
+
+static const char * const freeverb_names[] = {"mix", "room", "damp"};
+static const double freeverb_defaults[] = {0.33, 0.5, 0.5};
+static const char * const gverb_names[] = {"roomsize", "revtime", "damping", "inputbw", "spread",
+                                           "drylevel", "earlyreflevel", "taillevel",
+                                           "maxroomsize"};
+static const double gverb_defaults[] = {10.0, 3.0, 0.5, 0.5, 15.0, 1.0, 0.7, 0.5, 300.0};
+
+static void reverb_block(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  Reverb * rev = (Reverb *) sc;
+  (*rev->next)(rev, out, in, args, inNumSamples);
+}
+
+static void reverb_calc(SCUnit* sc, float ** out, float ** in, double * args, int inNumSamples) {
+  Reverb * rev = (Reverb *) sc;
+  sc_bus_args(sc, args);
+  if(rev->first) {
+    (*rev->first)(rev, args);
+    (*rev->next)(rev, out, in, args, 1);
+    rev->first = NULL;
+  }
+  // GVerb ramps its gains over one period
+  sc_subblocks(sc, &reverb_block, out, in, args, inNumSamples, rev->period_size);
+}
+
+enum { KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SIMD, KERNEL_BLOCK };
+
+// Kernel from the atoms auto, simd, block and scalar
+static int get_kernel(ErlNifEnv* env, ERL_NIF_TERM term, int * kernel)
+{
+  char name[8];
+  if (!enif_get_atom(env, term, name, sizeof(name), ERL_NIF_LATIN1)){
+    return 0;
+  }
+  if (strcmp(name, "auto") == 0) {
+    *kernel = KERNEL_AUTO;
+  } else if (strcmp(name, "simd") == 0) {
+    *kernel = KERNEL_SIMD;
+  } else if (strcmp(name, "block") == 0) {
+    *kernel = KERNEL_BLOCK;
+  } else if (strcmp(name, "scalar") == 0) {
+    *kernel = KERNEL_SCALAR;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+// The faster FreeVerb kernel, SIMD for float32 lines on AVX, block
+// for the others
+static int freeverb_auto_kernel(int storage)
+{
+#ifdef __AVX__
+  return (storage == SC_STORE_F32) ? KERNEL_SIMD : KERNEL_BLOCK;
+#else
+  return (storage == SC_STORE_F32) ? KERNEL_SCALAR : KERNEL_BLOCK;
+#endif
 }
 
 static ERL_NIF_TERM reverb_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   unsigned int rate, period_size;
+  int storage, kernel;
   char type[12];
   if (!enif_get_uint(env, argv[0], &rate)){
     return enif_make_badarg(env);
@@ -1517,28 +2181,66 @@ static ERL_NIF_TERM reverb_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
   if (!enif_get_atom(env, argv[2], type, 12, ERL_NIF_LATIN1)){
     return enif_make_badarg(env);
   }
+  if (!sc_get_storage(env, argv[3], &storage)){
+    return enif_make_badarg(env);
+  }
+  if (!get_kernel(env, argv[4], &kernel)){
+    return enif_make_badarg(env);
+  }
 
   Reverb * rev = enif_alloc_resource(sc_reverb_type, sizeof(Reverb));
+  size_t bytes = sizeof(Reverb);
+  // The FreeVerb delay lines are sized from the rate
+  rev->rate = rate;
+  rev->period_size = period_size;
+  rev->storage = storage;
   if (strcmp(type, "freeverb") == 0) {
-    rev->unit.fv = enif_alloc(sizeof(FreeVerb));
+    sc_unit_init(&rev->sc, 1, 1, 3, &reverb_calc);
+    sc_unit_params(&rev->sc, freeverb_names, freeverb_defaults);
+    rev->unit.fv = FreeVerb_Alloc(rev, sizeof(FreeVerb), 12);
+    bytes += sizeof(FreeVerb) + rev->unit.fv->lines.arena_size;
     rev->first = &FreeVerb_Ctor;
-    rev->next = &FreeVerb_next;
+    rev->reset = &FreeVerb_Ctor;
+    if (kernel == KERNEL_AUTO)
+      kernel = freeverb_auto_kernel(storage);
+    rev->next = (kernel == KERNEL_SIMD) ? freeverb_simd_kernels[storage] :
+      (kernel == KERNEL_BLOCK) ? freeverb_block_kernels[storage] : freeverb_kernels[storage];
     rev->dtor = NULL;
   } else if (strcmp(type, "freeverb2") == 0) {
-    rev->unit.fv2 = enif_alloc(sizeof(FreeVerb2));
+    sc_unit_init(&rev->sc, 2, 2, 3, &reverb_calc);
+    sc_unit_params(&rev->sc, freeverb_names, freeverb_defaults);
+    rev->unit.fv2 = FreeVerb_Alloc(rev, sizeof(FreeVerb2), 24);
+    bytes += sizeof(FreeVerb2) + rev->unit.fv2->lines.arena_size;
     rev->first = &FreeVerb2_Ctor;
-    rev->next = &FreeVerb2_next;
+    rev->reset = &FreeVerb2_Ctor;
+    if (kernel == KERNEL_AUTO)
+      kernel = freeverb_auto_kernel(storage);
+    rev->next = (kernel == KERNEL_SIMD) ? freeverb2_simd_kernels[storage] :
+      (kernel == KERNEL_BLOCK) ? freeverb2_block_kernels[storage] : freeverb2_kernels[storage];
     rev->dtor = NULL;
   } else if (strcmp(type, "gverb") == 0) {
-    rev->unit.gv = enif_alloc(sizeof(GVerb));
+    sc_unit_init(&rev->sc, 1, 2, 9, &reverb_calc);
+    sc_unit_params(&rev->sc, gverb_names, gverb_defaults);
+    rev->unit.gv = rev->mem = NULL;
     rev->first = &GVerb_Ctor;
-    rev->next = &GVerb_next;
-    rev->dtor = &GVerb_Dtor;
+    rev->reset = &GVerb_Reset;
+    // The SIMD kernel is the faster one with and without AVX
+    rev->next = (kernel == KERNEL_SIMD || kernel == KERNEL_AUTO) ?
+      gverb_simd_kernels[storage] : gverb_kernels[storage];
+    rev->dtor = NULL;
   } else {
+    // Leave the resource safe for its dtor
+    sc_unit_init(&rev->sc, 0, 0, 0, NULL);
+    rev->mem = NULL;
+    rev->dtor = NULL;
+    enif_release_resource(rev);
     return enif_make_badarg(env);
   }
-  rev->rate = rate;
-  rev->period_size = period_size;
+  // GVerb adds its lines on the first call
+  if (!sc_mem_charge(&rev->sc.mem, sc_mem_find(reverb_mem, REVERB_MEM_TYPES, type), bytes)){
+    enif_release_resource(rev);
+    return sc_budget_exceeded(env);
+  }
 
   ERL_NIF_TERM term = enif_make_resource(env, rev);
   enif_release_resource(rev);
@@ -1549,7 +2251,8 @@ static ERL_NIF_TERM reverb_ctor(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
 static ERL_NIF_TERM reverb_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 {
   Reverb * rev;
-  double args[4];
+  // GVerb has more parameters than the three given here
+  double args[SC_MAX_ARGS] = {0};
 
   if (!enif_get_resource(env, argv[0],
                          sc_reverb_type,
@@ -1592,9 +2295,13 @@ static ERL_NIF_TERM reverb_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
     unsigned i = 0;
     while (enif_get_list_cell(env, list, &head, &tail)){
       if(enif_inspect_binary(env, head, &in_bin)){
+        if(i == 0 && sc_dirty_needed(in_bin.size / sizeof(float))){
+          return enif_schedule_nif(env, "reverb_next", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                                   reverb_next, argc, argv);
+        }
         inNumSamples = in_bin.size / sizeof(float);
         in_array[i] = (float *) in_bin.data;
-        out_array[i] = (float *) enif_make_new_binary(env, in_bin.size, &out_term[i]);
+        out_array[i] = sc_make_output(env, &rev->sc, in_bin.size, &out_term[i]);
         list = tail;
         i++;
       } else {
@@ -1604,12 +2311,7 @@ static ERL_NIF_TERM reverb_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
                                                      ERL_NIF_LATIN1));
       }
     }
-    if(rev->first) {
-      (*rev->first)(rev, args);
-      (*rev->next)(rev, out_array, in_array, args, 1);
-      rev->first = NULL;
-    }
-    (*rev->next)(rev, out_array, in_array, args, inNumSamples);
+    reverb_calc(&rev->sc, out_array, in_array, args, inNumSamples);
     if (len == 1){
       return out_term[0];
     } else {
@@ -1623,25 +2325,124 @@ static ERL_NIF_TERM reverb_next(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
   }
 }
 
+static ERL_NIF_TERM unit(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Reverb * rev;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_reverb_type,
+                         (void**) &rev)){
+    return enif_make_badarg(env);
+  }
+  return sc_unit_handle(env, &rev->sc);
+}
+
+static ERL_NIF_TERM next_events(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Reverb * rev;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_reverb_type,
+                         (void**) &rev)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  return sc_next_events(env, &rev->sc, "next_events", next_events, argc, argv);
+}
+
+static ERL_NIF_TERM set_params(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Reverb * rev;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_reverb_type,
+                         (void**) &rev)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  return sc_set_params(env, &rev->sc, argv);
+}
+
+static ERL_NIF_TERM process(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Reverb * rev;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_reverb_type,
+                         (void**) &rev)){
+    return enif_raise_exception(env,
+                                enif_make_string(env,
+                                                 "No valid reference",
+                                                 ERL_NIF_LATIN1));
+  }
+  return sc_process(env, &rev->sc, "process", process, argc, argv);
+}
+
+// Clear the state for reuse, e.g. by SC.Pool. Lazily, the state is
+// cleared by the next call, before it renders.
+static ERL_NIF_TERM reset(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  Reverb * rev;
+
+  if (!enif_get_resource(env, argv[0],
+                         sc_reverb_type,
+                         (void**) &rev)){
+    return enif_make_badarg(env);
+  }
+  // A unit not run yet still has its constructor pending
+  if(rev->first == NULL) {
+    rev->first = rev->reset;
+  }
+  return enif_make_atom(env, "ok");
+}
+
+// delay_memory(), delay memory counters of the reverbs, see sc_delay_alloc
+static ERL_NIF_TERM delay_memory(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_delay_stats_term(env);
+}
+
+// memory_stats(), live instances and bytes per reverb type
+static ERL_NIF_TERM memory_stats(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_mem_stats(env, reverb_mem, REVERB_MEM_TYPES);
+}
+
+static ERL_NIF_TERM memory_budget(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sc_mem_budget(env, reverb_mem, REVERB_MEM_TYPES, argv);
+}
+
 /* ---------------------------------------------------------- */
 static ErlNifFunc nif_funcs[] = {
-  {"reverb_ctor", 3, reverb_ctor},
-  {"reverb_next", 5,  reverb_next}
+  {"reverb_ctor", 5, reverb_ctor},
+  {"reverb_next", 5,  reverb_next},
+  {"unit", 1, unit},
+  {"next_events", 4, next_events},
+  {"set_params", 2, set_params},
+  {"process", 2, process},
+  {"reset", 1, reset},
+  {"delay_memory", 0, delay_memory},
+  {"memory_stats", 0, memory_stats},
+  {"memory_budget", 2, memory_budget}
 };
 
 static int open_reverb_resource_type(ErlNifEnv* env)
 {
-  const char* mod = "Elixir.SC.Reverb";
   const char* resource_type = "sc_reverb";
   int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
   sc_reverb_type =
-    enif_open_resource_type(env, mod, resource_type,
-                            reverb_resource_dtor, flags, NULL);
+    sc_open_unit_type(env, resource_type, reverb_resource_dtor, flags);
   return ((sc_reverb_type == NULL) ? -1:0);
 }
 
 static int load(ErlNifEnv* caller_env, void** priv_data, ERL_NIF_TERM load_info)
 {
+  sc_delay_load(caller_env, load_info);
   return open_reverb_resource_type(caller_env);
 }
 
@@ -0,0 +1,92 @@
+defmodule SC.Ahead do
+
+  @moduledoc """
+  ### Render ahead
+
+  Runs a plugin, chain or graph on a native worker thread, decoupled
+  from the BEAM schedulers. Input periods are pushed ahead of time, the
+  worker renders each one as soon as it arrives and sends
+  `{:sc_ready, tag, n}` to the owner, `n` being the number of rendered
+  blocks waiting. Rendered blocks are pulled without copying.
+
+      ahead = SC.Ahead.new(SC.Chain.new([lpf, verb]), depth: 4)
+      :ok = SC.Ahead.push(ahead, frames)
+      tag = ahead.tag
+      receive do
+        {:sc_ready, ^tag, _n} -> [left, right] = SC.Ahead.pull(ahead)
+      end
+
+  Up to `depth` periods can be pushed and not yet rendered, and up
+  to `depth` rendered blocks can wait to be pulled. `push/2` returns
+  `:full` and `pull/1` returns `:empty` instead of blocking.
+
+  Pushing and pulling may be done by different processes, but only
+  by one process each. The plugin is run by the worker thread only,
+  do not call `next/2` on it while it is owned by an SC.Ahead.
+  """
+
+  defstruct [:ref, :tag, :plugin]
+
+  @type t() :: %__MODULE__{
+    ref: reference(),
+    tag: reference(),
+    plugin: struct()
+  }
+
+  @on_load :load_nifs
+  @doc false
+  def load_nifs do
+    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_ahead', 0) do
+      :ok -> :ok
+      {:error, {:reload, _}} -> :ok
+      {:error, reason} ->
+        :logger.warning('Failed to load sc_ahead NIF: ~p',[reason])
+    end
+  end
+
+  @doc false
+  def ahead_ctor(_handle, _args, _depth, _pid, _tag), do: raise "NIF ahead_ctor/5 not loaded"
+  @doc false
+  def ahead_push(_ref, _frames), do: raise "NIF ahead_push/2 not loaded"
+  @doc false
+  def ahead_pull(_ref), do: raise "NIF ahead_pull/1 not loaded"
+  @doc false
+  def ahead_ready(_ref), do: raise "NIF ahead_ready/1 not loaded"
+  @doc false
+  def ahead_set_args(_ref, _args), do: raise "NIF ahead_set_args/2 not loaded"
+
+  @doc """
+  Start a worker thread rendering the plugin.
+
+  Options:
+  * `:depth` - ring depth in periods, default 4.
+  * `:pid` - process notified when blocks are ready, default self().
+  """
+  @spec new(plugin :: struct(), opts :: keyword()) :: t
+  def new(plugin, opts \\ []) when is_struct(plugin) do
+    {handle, args} = (plugin.__struct__).unit(plugin)
+    tag = make_ref()
+    ref = ahead_ctor(handle, args, Keyword.get(opts, :depth, 4),
+                     Keyword.get(opts, :pid, self()), tag)
+    %__MODULE__{ref: ref, tag: tag, plugin: plugin}
+  end
+
+  @doc "Queue one input period for rendering"
+  @spec push(t(), frames :: binary() | [binary()]) :: :ok | :full
+  def push(%__MODULE__{ref: ref}, frames), do: ahead_push(ref, frames)
+
+  @doc "Take the oldest rendered block"
+  @spec pull(t()) :: binary() | [binary()] | :empty
+  def pull(%__MODULE__{ref: ref}), do: ahead_pull(ref)
+
+  @doc "Number of rendered blocks waiting to be pulled"
+  @spec ready(t()) :: non_neg_integer()
+  def ready(%__MODULE__{ref: ref}), do: ahead_ready(ref)
+
+  @doc "Set the control parameters, applied from the next rendered period"
+  @spec set_args(t(), args :: [float()]) :: :ok
+  def set_args(%__MODULE__{ref: ref}, args) do
+    ahead_set_args(ref, Enum.map(args, &(&1 * 1.0)))
+  end
+
+end
@@ -0,0 +1,106 @@
+defmodule SC.Buffer do
+
+  @moduledoc """
+  ### In-place buffer
+
+  A native buffer holding one period that plugins process in place.
+  The frames are copied in once, every plugin run on the buffer
+  writes to memory owned by the buffer and the result is copied out
+  once, so a stream of plugins reuses one buffer per voice instead of
+  allocating an output binary per plugin and period.
+
+      buffer = SC.Buffer.new()
+      lpf = SC.Filter.LPF.new(800.0)
+      echo = SC.Reverb.AnalogEcho.new(0.2)
+      verb = SC.Reverb.FreeVerb.new2()
+      [left, right] = SC.Buffer.process(buffer, frames, [lpf, echo, verb])
+
+  Plugins are run through their `c:SC.Plugin.unit/1` handles, with
+  the parameters of the struct, or with the sticky parameters of the
+  unit when run with `:params` (see the plugins' `set_params/2`). A
+  plugin taking more channels than the buffer carries (FreeVerb2 after
+  a mono filter) gets the last channel repeated.
+
+  A buffer is meant to be used by one process at a time.
+  """
+
+  defstruct [:ref, :size]
+
+  @type t() :: %__MODULE__{
+    ref: reference(),
+    size: pos_integer()
+  }
+
+  @on_load :load_nifs
+  @doc false
+  def load_nifs do
+    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_buffer', 0) do
+      :ok -> :ok
+      {:error, {:reload, _}} -> :ok
+      {:error, reason} ->
+        :logger.warning('Failed to load sc_buffer NIF: ~p',[reason])
+    end
+  end
+
+  @doc false
+  def buffer_ctor(_size), do: raise "NIF buffer_ctor/1 not loaded"
+  @doc false
+  def buffer_write(_ref, _frames), do: raise "NIF buffer_write/2 not loaded"
+  @doc false
+  def buffer_run(_ref, _handle, _args), do: raise "NIF buffer_run/3 not loaded"
+  @doc false
+  def buffer_read(_ref), do: raise "NIF buffer_read/1 not loaded"
+  @doc false
+  def buffer_ring(_handle, _depth, _samples), do: raise "NIF buffer_ring/3 not loaded"
+
+  @doc "Create a buffer of size samples per channel, default the period size"
+  @spec new(size :: pos_integer()) :: t
+  def new(size \\ SC.Ctx.get().period_size) do
+    %__MODULE__{ref: buffer_ctor(size), size: size}
+  end
+
+  @doc "Copy frames, a binary or a list of channel binaries, into the buffer"
+  @spec write(t(), frames :: binary() | [binary()]) :: :ok
+  def write(%__MODULE__{ref: ref}, frames), do: buffer_write(ref, frames)
+
+  @doc """
+  Run the plugin on the buffer in place, with the parameters of the
+  plugin struct or, given `:params`, with its sticky parameters.
+  """
+  @spec run(t(), plugin :: struct(), :args | :params) :: t()
+  def run(buffer = %__MODULE__{ref: ref}, plugin, which \\ :args) when is_struct(plugin) do
+    {handle, args} = (plugin.__struct__).unit(plugin)
+    :ok = buffer_run(ref, handle, if(which == :params, do: :params, else: args))
+    buffer
+  end
+
+  @doc "Copy the buffer out as a binary or a list of channel binaries"
+  @spec read(t()) :: binary() | [binary()]
+  def read(%__MODULE__{ref: ref}), do: buffer_read(ref)
+
+  @doc "Write frames, run the plugins in order and read the result"
+  @spec process(t(), frames :: binary() | [binary()], plugins :: [struct()]) ::
+          binary() | [binary()]
+  def process(buffer, frames, plugins) do
+    :ok = write(buffer, frames)
+    Enum.reduce(plugins, buffer, &run(&2, &1))
+    |> read()
+  end
+
+  @doc """
+  Give the plugin a ring of depth output blocks of samples each, see
+  `:ring_depth` of `t:SC.Ctx.t/0`. Once per plugin, returns the plugin.
+  """
+  @spec ring(plugin :: struct(), depth :: 1..64, samples :: pos_integer()) :: struct()
+  def ring(plugin, depth, samples) when is_struct(plugin) do
+    {handle, _args} = (plugin.__struct__).unit(plugin)
+    :ok = buffer_ring(handle, depth, samples)
+    plugin
+  end
+
+  @spec stream(t(), plugins :: [struct()], enum :: Enumerable.t()) :: Enumerable.t()
+  def stream(buffer = %__MODULE__{}, plugins, enum) do
+    Stream.map(enum, fn frames -> process(buffer, frames, plugins) end)
+  end
+
+end
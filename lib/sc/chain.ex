@@ -0,0 +1,83 @@
+defmodule SC.Chain do
+  @behaviour SC.Plugin
+
+  @moduledoc """
+  ### Plugin chain
+
+  A chain runs a list of plugins back to back in one NIF call. Only the
+  output of the last plugin is copied back as binaries, intermediate
+  periods are kept in native scratch buffers.
+
+      chain = SC.Chain.new([SC.Filter.LPF.new(800.0),
+                            SC.Reverb.AnalogEcho.new(0.2),
+                            SC.Reverb.FreeVerb.new2()])
+      SC.Chain.next(chain, frames)
+
+  Every plugin in the chain must implement the `c:SC.Plugin.unit/1`
+  callback and have scalar control parameters. The parameters are
+  captured when the chain is created, use `set_args/3` to change them.
+  A plugin taking more channels than the chain carries at that point
+  (FreeVerb2 after a mono filter) gets the last channel repeated.
+
+  The plugins are shared, not copied. Calling `next/2` on a plugin
+  that is also part of a chain advances the same state.
+  """
+
+  defstruct [:ref, plugins: []]
+
+  @type t() :: %__MODULE__{
+    ref: reference(),
+    plugins: [struct()]
+  }
+
+  @on_load :load_nifs
+  @doc false
+  def load_nifs do
+    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_chain', 0) do
+      :ok -> :ok
+      {:error, {:reload, _}} -> :ok
+      {:error, reason} ->
+        :logger.warning('Failed to load sc_chain NIF: ~p',[reason])
+    end
+  end
+
+  @doc false
+  def chain_ctor(_units), do: raise "NIF chain_ctor/1 not loaded"
+  @doc false
+  def chain_next(_ref, _frames), do: raise "NIF chain_next/2 not loaded"
+  @doc false
+  def chain_set_args(_ref, _index, _args), do: raise "NIF chain_set_args/3 not loaded"
+  @doc false
+  def chain_unit(_ref), do: raise "NIF chain_unit/1 not loaded"
+
+  @doc "Create a chain from a non empty list of plugins"
+  @spec new(plugins :: [struct()]) :: t
+  def new(plugins = [_ | _]) do
+    units = Enum.map(plugins, fn plugin -> (plugin.__struct__).unit(plugin) end)
+    %__MODULE__{ref: chain_ctor(units), plugins: plugins}
+    |> SC.Plugin.init_ring()
+  end
+
+  def ns(enum, plugins), do: stream(new(plugins), enum)
+
+  @doc "Set the control parameters of the plugin at index in the chain"
+  @spec set_args(t(), index :: non_neg_integer(), args :: [float()]) :: :ok
+  def set_args(%__MODULE__{ref: ref}, index, args) do
+    chain_set_args(ref, index, Enum.map(args, &(&1 * 1.0)))
+  end
+
+  @spec next(t(), frames :: binary() | [binary()]) :: binary() | [binary()]
+  def next(%__MODULE__{ref: ref}, frames) do
+    chain_next(ref, frames)
+  end
+
+  @doc "A chain is itself a unit, e.g. a voice of an SC.Group"
+  @spec unit(t()) :: {reference(), [float()]}
+  def unit(%__MODULE__{ref: ref}), do: {chain_unit(ref), []}
+
+  @spec stream(t(), enum :: Enumerable.t()) :: Enumerable.t()
+  def stream(chain = %__MODULE__{}, enum) do
+    Stream.map(enum, fn frames -> next(chain, frames) end)
+  end
+
+end
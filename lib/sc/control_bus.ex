@@ -0,0 +1,95 @@
+defmodule SC.ControlBus do
+
+  @moduledoc """
+  ### Control bus
+
+  A control bus is a native array of floats shared by plugins. A
+  parameter of a plugin bound to a bus index is read from the bus at
+  the start of each period, so setting one bus value retunes every
+  plugin bound to it without passing the value to each `next/2` call.
+
+      bus = SC.ControlBus.new(2)
+      voices = for _ <- 1..1000, do: SC.Filter.LPF.new()
+      Enum.each(voices, &SC.ControlBus.bind(bus, 0, &1, 0))
+      SC.ControlBus.set(bus, 0, 1200.0)
+
+  A bound parameter ignores the value given to `next/2` and parameter
+  events for it. Binding works through the plugin's `c:SC.Plugin.unit/1`
+  handle, so the plugin may as well be run in an SC.Chain, SC.Graph,
+  SC.Group or SC.Ahead.
+
+  A plugin may be bound, rebound or unbound while it runs on an
+  SC.Ahead worker, an SC.Group pool thread or a dirty scheduler, the
+  next call of the plugin reads the new binding. A call racing a
+  rebind may read one period from the old binding. A bus once bound
+  to a plugin is kept alive, also after unbinding, until the plugin
+  is garbage collected.
+  """
+
+  defstruct [:ref, :size]
+
+  @type t() :: %__MODULE__{
+    ref: reference(),
+    size: pos_integer()
+  }
+
+  @on_load :load_nifs
+  @doc false
+  def load_nifs do
+    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_bus', 0) do
+      :ok -> :ok
+      {:error, {:reload, _}} -> :ok
+      {:error, reason} ->
+        :logger.warning('Failed to load sc_bus NIF: ~p',[reason])
+    end
+  end
+
+  @doc false
+  def bus_ctor(_size), do: raise "NIF bus_ctor/1 not loaded"
+  @doc false
+  def bus_set(_ref, _index, _value), do: raise "NIF bus_set/3 not loaded"
+  @doc false
+  def bus_get(_ref, _index), do: raise "NIF bus_get/2 not loaded"
+  @doc false
+  def bus_bind(_ref, _index, _handle, _slot), do: raise "NIF bus_bind/4 not loaded"
+  @doc false
+  def bus_unbind(_handle, _slot), do: raise "NIF bus_unbind/2 not loaded"
+
+  @doc "Create a bus of size values, all 0.0"
+  @spec new(size :: pos_integer()) :: t
+  def new(size) do
+    %__MODULE__{ref: bus_ctor(size), size: size}
+  end
+
+  @doc "Set the value at index, or consecutive values from index on"
+  @spec set(t(), index :: non_neg_integer(), value :: number() | [number()]) :: :ok
+  def set(%__MODULE__{ref: ref}, index, values) when is_list(values) do
+    bus_set(ref, index, Enum.map(values, &(&1 * 1.0)))
+  end
+  def set(%__MODULE__{ref: ref}, index, value), do: bus_set(ref, index, value * 1.0)
+
+  @spec get(t(), index :: non_neg_integer()) :: float()
+  def get(%__MODULE__{ref: ref}, index), do: bus_get(ref, index)
+
+  @doc """
+  Bind parameter slot of the plugin to the bus index. Slots are
+  numbered in the order of the `c:SC.Plugin.unit/1` parameters.
+  Returns the plugin.
+  """
+  @spec bind(t(), index :: non_neg_integer(), plugin :: struct(), slot :: non_neg_integer()) ::
+          struct()
+  def bind(%__MODULE__{ref: ref}, index, plugin, slot) when is_struct(plugin) do
+    {handle, _args} = (plugin.__struct__).unit(plugin)
+    :ok = bus_bind(ref, index, handle, slot)
+    plugin
+  end
+
+  @doc "Take parameter slot of the plugin from `next/2` again"
+  @spec unbind(plugin :: struct(), slot :: non_neg_integer()) :: struct()
+  def unbind(plugin, slot) when is_struct(plugin) do
+    {handle, _args} = (plugin.__struct__).unit(plugin)
+    :ok = bus_unbind(handle, slot)
+    plugin
+  end
+
+end
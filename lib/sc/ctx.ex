@@ -6,7 +6,7 @@ defmodule SC.Ctx do
   the application by calling SC.Ctx.put/1.
 
   """
-  defstruct [:rate, :period_size]
+  defstruct [:rate, :period_size, ring_depth: 0]
 
   @type rates() :: 44100 | 48000 | 96000 | 192_000
 
@@ -15,10 +15,18 @@ defmodule SC.Ctx do
 
   * `:rate` - Sample rate.
   * `:period_size` - Buffer size in number of samples.
+  * `:ring_depth` - Output blocks preallocated per plugin, 0 (the
+    default) to allocate a new binary per output. With a depth
+    plugins created afterwards return periods as resource binaries
+    on blocks of their own ring, recycled when the binary is garbage
+    collected, so an output costs no binary allocation. A plugin falls
+    back to a new binary when all its blocks are still referenced, so
+    the depth should cover the periods kept alive downstream. Max 64.
   """
   @type t() :: %__MODULE__{
     rate: rates(),
-    period_size: pos_integer()
+    period_size: pos_integer(),
+    ring_depth: 0..64
   }
 
   @spec put(ctx :: t()) :: :ok
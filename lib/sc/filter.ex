@@ -7,7 +7,12 @@ defmodule SC.Filter do
   @doc false
   def load_nifs do
     case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_filter', 0) do
-      :ok -> :ok
+      :ok ->
+        # See SC.Stats.set_budget/2
+        for {type, bytes} <- Application.get_env(:sc_plugin_nifs, :memory_budgets, []) do
+          memory_budget(type, bytes)
+        end
+        :ok
       {:error, {:reload, _}} -> :ok
       {:error, reason} ->
         :logger.warning('Failed to load sc_filter NIF: ~p',[reason])
@@ -34,6 +39,42 @@ defmodule SC.Filter do
 
   @doc false
   def lhpf_next(_ref, _frames, _freq, _bw), do: raise "NIF lpf_next/4 not loaded"
+
+  @doc false
+  def ramp_next_kr(_ref, _values, _lagtime), do: raise "NIF ramp_next_kr/3 not loaded"
+  @doc false
+  def lag_next_kr(_ref, _values, _lag), do: raise "NIF lag_next_kr/3 not loaded"
+  @doc false
+  def lagud_next_kr(_ref, _values, _lagup, _lagdown), do: raise "NIF lagud_next_kr/4 not loaded"
+  @doc false
+  def lhpf_next_kr(_ref, _values, _freq), do: raise "NIF lhpf_next_kr/3 not loaded"
+  @doc false
+  def lhpf_next_kr(_ref, _values, _freq, _bw), do: raise "NIF lhpf_next_kr/4 not loaded"
+
+  @doc false
+  def lhpf_bank_ctor(_rate, _period_size, _type, _n), do: raise "NIF lhpf_bank_ctor/4 not loaded"
+  @doc false
+  def lhpf_bank_next(_ref, _frames, _freqs), do: raise "NIF lhpf_bank_next/3 not loaded"
+  @doc false
+  def lhpf_bank_next(_ref, _frames, _freqs, _bws), do: raise "NIF lhpf_bank_next/4 not loaded"
+
+  @doc false
+  def lag_bank_ctor(_rate, _period_size, _n), do: raise "NIF lag_bank_ctor/3 not loaded"
+  @doc false
+  def lag_bank_next(_ref, _frames, _lagups, _lagdowns), do: raise "NIF lag_bank_next/4 not loaded"
+
+  @doc false
+  def unit(_ref), do: raise "NIF unit/1 not loaded"
+  @doc false
+  def next_events(_ref, _frames, _args, _events), do: raise "NIF next_events/4 not loaded"
+  @doc false
+  def set_params(_ref, _params), do: raise "NIF set_params/2 not loaded"
+  @doc false
+  def process(_ref, _frames), do: raise "NIF process/2 not loaded"
+  @doc false
+  def memory_stats(), do: raise "NIF memory_stats/0 not loaded"
+  @doc false
+  def memory_budget(_type, _bytes), do: raise "NIF memory_budget/2 not loaded"
   # -----------------------------------------------------------
   # Break a continuous signal into linearly interpolated segments
   # with specific durations.
@@ -43,7 +84,11 @@ defmodule SC.Filter do
 
     def new(lagtime \\ 0.1) do
       %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-      %__MODULE__{ref: SC.Filter.ramp_ctor(rate, period_size), lagTime: lagtime}
+      with ref when is_reference(ref) <- SC.Filter.ramp_ctor(rate, period_size) do
+        %__MODULE__{ref: ref, lagTime: lagtime}
+        |> SC.Plugin.init_params([:lagTime])
+        |> SC.Plugin.init_ring()
+      end
     end
 
     def ns(enum, lagtime \\ 0.1), do: stream(new(lagtime), enum)
@@ -52,6 +97,32 @@ defmodule SC.Filter do
       SC.Filter.ramp_next(ref, frames, lagtime)
     end
 
+    @doc """
+    Run N control rate steps in one call, as N calls of `next/2` with
+    a float each. Values are a binary of floats or a list of floats.
+    """
+    def next_kr(%__MODULE__{ref: ref, lagTime: lagtime}, values) when is_number(lagtime) do
+      SC.Filter.ramp_next_kr(ref, values, lagtime * 1.0)
+    end
+
+    @doc "Process frames applying `{offset, 0, lagtime}` events, see `c:SC.Plugin.next/3`"
+    def next(%__MODULE__{ref: ref, lagTime: lagtime}, frames, events) when is_number(lagtime) do
+      SC.Filter.next_events(ref, frames, [lagtime * 1.0], events)
+    end
+
+    def unit(%__MODULE__{ref: ref, lagTime: lagtime}) when is_number(lagtime) do
+      {SC.Filter.unit(ref), [lagtime * 1.0]}
+    end
+
+    @doc "Store parameters in the native unit, used by `process/2`"
+    def set_params(m = %__MODULE__{ref: ref}, params) do
+      :ok = SC.Filter.set_params(ref, SC.Plugin.float_params(params))
+      struct!(m, params)
+    end
+
+    @doc "Process frames with the stored parameters"
+    def process(%__MODULE__{ref: ref}, frames), do: SC.Filter.process(ref, frames)
+
     def stream(m = %__MODULE__{lagTime: lagtime}, enum) when is_float(lagtime) do
       ls = Stream.unfold(lagtime, fn x -> {x,x} end)
       stream(%{m | :lagTime => ls}, enum)
@@ -70,7 +141,11 @@ defmodule SC.Filter do
 
     def new(lagtime \\ 0.1) do
       %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-      %__MODULE__{ref: SC.Filter.lag_ctor(rate, period_size), lagTime: lagtime}
+      with ref when is_reference(ref) <- SC.Filter.lag_ctor(rate, period_size) do
+        %__MODULE__{ref: ref, lagTime: lagtime}
+        |> SC.Plugin.init_params([:lagTime])
+        |> SC.Plugin.init_ring()
+      end
     end
 
     def ns(enum, lagtime \\ 0.1), do: stream(new(lagtime), enum)
@@ -79,6 +154,29 @@ defmodule SC.Filter do
       SC.Filter.lag_next(ref, frames, lagtime)
     end
 
+    @doc "Control rate batch, see `SC.Filter.Ramp.next_kr/2`"
+    def next_kr(%__MODULE__{ref: ref, lagTime: lagtime}, values) when is_number(lagtime) do
+      SC.Filter.lag_next_kr(ref, values, lagtime * 1.0)
+    end
+
+    @doc "Process frames applying `{offset, 0, lagtime}` events, see `c:SC.Plugin.next/3`"
+    def next(%__MODULE__{ref: ref, lagTime: lagtime}, frames, events) when is_number(lagtime) do
+      SC.Filter.next_events(ref, frames, [lagtime * 1.0], events)
+    end
+
+    def unit(%__MODULE__{ref: ref, lagTime: lagtime}) when is_number(lagtime) do
+      {SC.Filter.unit(ref), [lagtime * 1.0]}
+    end
+
+    @doc "Store parameters in the native unit, used by `process/2`"
+    def set_params(m = %__MODULE__{ref: ref}, params) do
+      :ok = SC.Filter.set_params(ref, SC.Plugin.float_params(params))
+      struct!(m, params)
+    end
+
+    @doc "Process frames with the stored parameters"
+    def process(%__MODULE__{ref: ref}, frames), do: SC.Filter.process(ref, frames)
+
     def stream(m = %__MODULE__{lagTime: lagtime}, enum) when is_float(lagtime) do
       ls = Stream.unfold(lagtime, fn x -> {x,x} end)
       stream(%{m | :lagTime => ls}, enum)
@@ -97,8 +195,11 @@ defmodule SC.Filter do
 
     def new(lagtime_u \\ 0.1, lagtime_d \\ 0.1) do
       %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-      %__MODULE__{ref: SC.Filter.lagud_ctor(rate, period_size),
-                  lagTimeU: lagtime_u, lagTimeD: lagtime_d}
+      with ref when is_reference(ref) <- SC.Filter.lagud_ctor(rate, period_size) do
+        %__MODULE__{ref: ref, lagTimeU: lagtime_u, lagTimeD: lagtime_d}
+        |> SC.Plugin.init_params([:lagTimeU, :lagTimeD])
+        |> SC.Plugin.init_ring()
+      end
     end
 
     def ns(enum, lu \\ 0.1, ld \\ 0.1), do: stream(new(lu, ld), enum)
@@ -108,6 +209,32 @@ defmodule SC.Filter do
       SC.Filter.lagud_next(ref, frames, lagtime_u, lagtime_d)
     end
 
+    @doc "Control rate batch, see `SC.Filter.Ramp.next_kr/2`"
+    def next_kr(%__MODULE__{ref: ref, lagTimeU: lagtime_u, lagTimeD: lagtime_d}, values)
+    when is_number(lagtime_u) and is_number(lagtime_d) do
+      SC.Filter.lagud_next_kr(ref, values, lagtime_u * 1.0, lagtime_d * 1.0)
+    end
+
+    @doc "Process frames applying events, index 0 is lagTimeU and 1 lagTimeD"
+    def next(%__MODULE__{ref: ref, lagTimeU: lagtime_u, lagTimeD: lagtime_d}, frames, events)
+    when is_number(lagtime_u) and is_number(lagtime_d) do
+      SC.Filter.next_events(ref, frames, [lagtime_u * 1.0, lagtime_d * 1.0], events)
+    end
+
+    def unit(%__MODULE__{ref: ref, lagTimeU: lagtime_u, lagTimeD: lagtime_d})
+    when is_number(lagtime_u) and is_number(lagtime_d) do
+      {SC.Filter.unit(ref), [lagtime_u * 1.0, lagtime_d * 1.0]}
+    end
+
+    @doc "Store parameters in the native unit, used by `process/2`"
+    def set_params(m = %__MODULE__{ref: ref}, params) do
+      :ok = SC.Filter.set_params(ref, SC.Plugin.float_params(params))
+      struct!(m, params)
+    end
+
+    @doc "Process frames with the stored parameters"
+    def process(%__MODULE__{ref: ref}, frames), do: SC.Filter.process(ref, frames)
+
     def stream(m = %__MODULE__{lagTimeU: lagtime_u}, enum) when is_number(lagtime_u) do
       ls = Stream.unfold(lagtime_u * 1.0, fn x -> {x,x} end)
       stream(%{m | :lagTimeU => ls}, enum)
@@ -134,16 +261,50 @@ defmodule SC.Filter do
 
       def new(frequency \\ 440.0) do
         %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-        %unquote(mod){ref: SC.Filter.lhpf_ctor(rate, period_size, unquote(type)),
-                    frequency: frequency}
+        with ref when is_reference(ref) <- SC.Filter.lhpf_ctor(rate, period_size, unquote(type)) do
+          %unquote(mod){ref: ref, frequency: frequency}
+          |> SC.Plugin.init_params([:frequency])
+          |> SC.Plugin.init_ring()
+        end
       end
 
       def ns(enum, frequency \\ 440.0), do: stream(new(frequency), enum)
 
+      @doc """
+      Process frames. The frequency is a number or, at audio rate, a
+      binary of native floats as long as frames, one frequency per
+      sample.
+      """
+      def next(%unquote(mod){ref: ref, frequency: frequency}, frames) when is_binary(frequency) do
+        SC.Filter.lhpf_next(ref, frames, frequency)
+      end
       def next(%unquote(mod){ref: ref, frequency: frequency}, frames) when is_number(frequency) do
         SC.Filter.lhpf_next(ref, frames, frequency * 1.0)
       end
 
+      @doc "Control rate batch, see `SC.Filter.Ramp.next_kr/2`"
+      def next_kr(%unquote(mod){ref: ref, frequency: frequency}, values) when is_number(frequency) do
+        SC.Filter.lhpf_next_kr(ref, values, frequency * 1.0)
+      end
+
+      @doc "Process frames applying `{offset, 0, frequency}` events, see `c:SC.Plugin.next/3`"
+      def next(%unquote(mod){ref: ref, frequency: frequency}, frames, events) when is_number(frequency) do
+        SC.Filter.next_events(ref, frames, [frequency * 1.0], events)
+      end
+
+      def unit(%unquote(mod){ref: ref, frequency: frequency}) when is_number(frequency) do
+        {SC.Filter.unit(ref), [frequency * 1.0]}
+      end
+
+      @doc "Store parameters in the native unit, used by `process/2`"
+      def set_params(m = %unquote(mod){ref: ref}, params) do
+        :ok = SC.Filter.set_params(ref, SC.Plugin.float_params(params))
+        struct!(m, params)
+      end
+
+      @doc "Process frames with the stored parameters"
+      def process(%unquote(mod){ref: ref}, frames), do: SC.Filter.process(ref, frames)
+
       def stream(m = %unquote(mod){frequency: frequency}, enum) when is_number(frequency) do
         fs = Stream.unfold(frequency, fn x -> {x,x} end)
         stream(%{m | :frequency => fs}, enum)
@@ -170,27 +331,65 @@ defmodule SC.Filter do
       WARNING: due to the nature of its implementation frequency values
       close to 0 may cause glitches and/or extremely loud audio artifacts!
       """
-      @type frequency() :: float()
+      @type frequency() :: float() | binary()
 
       @typedoc """
       Bandwidth ratio. The reciprocal of Q.
       Q is conventionally defined as centerFreq / bandwidth,
       meaning bwr = (bandwidth / centerFreq).
       """
-      @type bwr() :: float()
+      @type bwr() :: float() | binary()
 
       def new(frequency \\ 440.0, bwr \\ 1.0 ) do
         %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-        %unquote(mod){ref: SC.Filter.lhpf_ctor(rate, period_size, unquote(type)),
-                    frequency: frequency, bwr: bwr}
+        with ref when is_reference(ref) <- SC.Filter.lhpf_ctor(rate, period_size, unquote(type)) do
+          %unquote(mod){ref: ref, frequency: frequency, bwr: bwr}
+          |> SC.Plugin.init_params([:frequency, :bwr])
+          |> SC.Plugin.init_ring()
+        end
       end
 
       def ns(enum, frequency \\ 440.0, bwr \\ 1.0), do: stream(new(frequency, bwr), enum)
 
-      def next(%unquote(mod){ref: ref, frequency: frequency, bwr: bwr}, frames) when is_number(frequency) do
-        SC.Filter.lhpf_next(ref, frames, frequency * 1.0, bwr)
+      @doc """
+      Process frames. Frequency and bwr are numbers or, at audio rate,
+      binaries of native floats as long as frames, one value per
+      sample.
+      """
+      def next(%unquote(mod){ref: ref, frequency: frequency, bwr: bwr}, frames)
+      when (is_number(frequency) or is_binary(frequency)) and (is_number(bwr) or is_binary(bwr)) do
+        SC.Filter.lhpf_next(ref, frames, ar(frequency), ar(bwr))
+      end
+
+      defp ar(value) when is_binary(value), do: value
+      defp ar(value), do: value * 1.0
+
+      @doc "Control rate batch, see `SC.Filter.Ramp.next_kr/2`"
+      def next_kr(%unquote(mod){ref: ref, frequency: frequency, bwr: bwr}, values)
+      when is_number(frequency) and is_number(bwr) do
+        SC.Filter.lhpf_next_kr(ref, values, frequency * 1.0, bwr * 1.0)
       end
 
+      @doc "Process frames applying events, index 0 is frequency and 1 bwr"
+      def next(%unquote(mod){ref: ref, frequency: frequency, bwr: bwr}, frames, events)
+      when is_number(frequency) and is_number(bwr) do
+        SC.Filter.next_events(ref, frames, [frequency * 1.0, bwr * 1.0], events)
+      end
+
+      def unit(%unquote(mod){ref: ref, frequency: frequency, bwr: bwr})
+      when is_number(frequency) and is_number(bwr) do
+        {SC.Filter.unit(ref), [frequency * 1.0, bwr * 1.0]}
+      end
+
+      @doc "Store parameters in the native unit, used by `process/2`"
+      def set_params(m = %unquote(mod){ref: ref}, params) do
+        :ok = SC.Filter.set_params(ref, SC.Plugin.float_params(params))
+        struct!(m, params)
+      end
+
+      @doc "Process frames with the stored parameters"
+      def process(%unquote(mod){ref: ref}, frames), do: SC.Filter.process(ref, frames)
+
       def stream(m = %unquote(mod){frequency: frequency}, enum) when is_number(frequency) do
         fs = Stream.unfold(frequency, fn x -> {x,x} end)
         stream(%{m | :frequency => fs}, enum)
@@ -206,4 +405,107 @@ defmodule SC.Filter do
     end
   end
 
+  # -----------------------------------------------------------
+  # Voice banks, N instances of a filter run in SIMD lanes.
+  # Frames are one packed binary with the periods of all voices
+  # concatenated, parameters a float for all voices or a list with
+  # one float per voice.
+
+  defmodule LHPFBank do
+    @moduledoc """
+    Bank of `size` LPF, HPF, BPF or BRF filters of the same type.
+
+        bank = SC.Filter.LHPFBank.new(:lpf, 3, [200.0, 400.0, 800.0])
+        packed = SC.Filter.LHPFBank.next(bank, [frames1, frames2, frames3])
+        [out1, out2, out3] = SC.Filter.LHPFBank.unpack(bank, packed)
+    """
+    defstruct [:ref, :type, :size, frequency: 440.0, bwr: 1.0]
+    @type t() :: %__MODULE__{
+      ref: reference(),
+      type: :lpf | :hpf | :bpf | :brf,
+      size: pos_integer(),
+      frequency: float() | [float()],
+      bwr: float() | [float()]
+    }
+
+    def new(type, size, frequency \\ 440.0, bwr \\ 1.0)
+    when type in [:lpf, :hpf, :bpf, :brf] do
+      %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
+      with ref when is_reference(ref) <- SC.Filter.lhpf_bank_ctor(rate, period_size, type, size) do
+        %__MODULE__{ref: ref, type: type, size: size, frequency: frequency, bwr: bwr}
+      end
+    end
+
+    def ns(enum, type, size, frequency \\ 440.0, bwr \\ 1.0) do
+      stream(new(type, size, frequency, bwr), enum)
+    end
+
+    def next(bank = %__MODULE__{}, frames) when is_list(frames) do
+      next(bank, IO.iodata_to_binary(frames))
+    end
+    def next(%__MODULE__{ref: ref, type: type, frequency: frequency}, frames)
+    when type in [:lpf, :hpf] do
+      SC.Filter.lhpf_bank_next(ref, frames, SC.Filter.bank_args(frequency))
+    end
+    def next(%__MODULE__{ref: ref, frequency: frequency, bwr: bwr}, frames) do
+      SC.Filter.lhpf_bank_next(ref, frames, SC.Filter.bank_args(frequency),
+        SC.Filter.bank_args(bwr))
+    end
+
+    @doc "Split a packed binary into one binary per voice"
+    def unpack(%__MODULE__{size: size}, packed), do: SC.Filter.bank_unpack(packed, size)
+
+    def stream(bank = %__MODULE__{}, enum) do
+      Stream.map(enum, fn frames -> next(bank, frames) end)
+    end
+  end
+
+  defmodule LagBank do
+    @moduledoc """
+    Bank of `size` lag filters with separate up and down lag times,
+    a voice with equal lag times is a Lag.
+    """
+    defstruct [:ref, :size, lagTimeU: 0.1, lagTimeD: 0.1]
+    @type t() :: %__MODULE__{
+      ref: reference(),
+      size: pos_integer(),
+      lagTimeU: float() | [float()],
+      lagTimeD: float() | [float()]
+    }
+
+    def new(size, lagtime_u \\ 0.1, lagtime_d \\ nil) do
+      %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
+      with ref when is_reference(ref) <- SC.Filter.lag_bank_ctor(rate, period_size, size) do
+        %__MODULE__{ref: ref, size: size, lagTimeU: lagtime_u, lagTimeD: lagtime_d || lagtime_u}
+      end
+    end
+
+    def ns(enum, size, lu \\ 0.1, ld \\ nil), do: stream(new(size, lu, ld), enum)
+
+    def next(bank = %__MODULE__{}, frames) when is_list(frames) do
+      next(bank, IO.iodata_to_binary(frames))
+    end
+    def next(%__MODULE__{ref: ref, lagTimeU: lagtime_u, lagTimeD: lagtime_d}, frames) do
+      SC.Filter.lag_bank_next(ref, frames, SC.Filter.bank_args(lagtime_u),
+        SC.Filter.bank_args(lagtime_d))
+    end
+
+    @doc "Split a packed binary into one binary per voice"
+    def unpack(%__MODULE__{size: size}, packed), do: SC.Filter.bank_unpack(packed, size)
+
+    def stream(bank = %__MODULE__{}, enum) do
+      Stream.map(enum, fn frames -> next(bank, frames) end)
+    end
+  end
+
+  @doc false
+  def bank_args(x) when is_number(x), do: x * 1.0
+  def bank_args(xs) when is_list(xs), do: Enum.map(xs, &(&1 * 1.0))
+
+  @doc false
+  def bank_unpack(packed, size) do
+    period = div(byte_size(packed), size)
+    for i <- 0..(size - 1), do: binary_part(packed, i * period, period)
+  end
+
 end
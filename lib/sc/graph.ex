@@ -0,0 +1,260 @@
+defmodule SC.Graph do
+  @behaviour SC.Plugin
+
+  @moduledoc """
+  ### Plugin graph
+
+  A graph connects plugins in a directed acyclic graph, in the same way
+  as a SuperCollider SynthDef. The graph is compiled into a flat,
+  topologically sorted list of native ops that run within one NIF call.
+
+  The buffers between the ops (wires) are allocated by liveness, a
+  wire is reused as soon as the last op reading it has run. A graph with
+  many nodes therefore only needs a handful of scratch buffers per block.
+
+      input = SC.Graph.input()
+      lpf = SC.Graph.node(SC.Filter.LPF.new(800.0), input)
+      echo = SC.Graph.node(SC.Reverb.AnalogEcho.new(0.2), lpf)
+      verb = SC.Graph.node(SC.Reverb.FreeVerb.new2(), lpf)
+      graph = SC.Graph.compile(SC.Graph.sum([echo, verb]))
+      [left, right] = SC.Graph.next(graph, frames)
+
+  A node given as an input stands for all its output channels,
+  use `channel/2` to pick one. A node taking more input channels than
+  it is given gets the last channel repeated. Sums are done channel
+  by channel, a mono term is added to every channel.
+
+  Every plugin must implement the `c:SC.Plugin.unit/1` callback and may
+  only appear in one node, the state is shared with the plugin.
+  """
+
+  defmodule Node do
+    @moduledoc false
+    defstruct [:id, :op, inputs: []]
+  end
+
+  defstruct [:ref, num_inputs: 0, num_outputs: 1, num_scratch: 0, ops: %{}]
+
+  @typedoc "A node or one output channel of a node"
+  @type signal() :: %Node{} | {%Node{}, non_neg_integer()}
+
+  @type t() :: %__MODULE__{
+    ref: reference(),
+    num_inputs: non_neg_integer(),
+    num_outputs: pos_integer(),
+    num_scratch: non_neg_integer(),
+    ops: %{reference() => non_neg_integer()}
+  }
+
+  @on_load :load_nifs
+  @doc false
+  def load_nifs do
+    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_graph', 0) do
+      :ok -> :ok
+      {:error, {:reload, _}} -> :ok
+      {:error, reason} ->
+        :logger.warning('Failed to load sc_graph NIF: ~p',[reason])
+    end
+  end
+
+  @doc false
+  def graph_ctor(_num_inputs, _num_outputs, _num_scratch, _ops) do
+    raise "NIF graph_ctor/4 not loaded"
+  end
+  @doc false
+  def graph_next(_ref, _frames), do: raise "NIF graph_next/2 not loaded"
+  @doc false
+  def graph_set_args(_ref, _index, _args), do: raise "NIF graph_set_args/3 not loaded"
+  @doc false
+  def unit_info(_handle), do: raise "NIF unit_info/1 not loaded"
+  @doc false
+  def graph_unit(_ref), do: raise "NIF graph_unit/1 not loaded"
+
+  # -----------------------------------------------------------
+  # DSL
+
+  @doc "Graph input channel"
+  @spec input(index :: non_neg_integer()) :: %Node{}
+  def input(index \\ 0), do: %Node{id: make_ref(), op: {:input, index}}
+
+  @doc "Plugin node reading the given signals"
+  @spec node(plugin :: struct(), inputs :: signal() | [signal()]) :: %Node{}
+  def node(plugin, inputs) when is_struct(plugin) do
+    %Node{id: make_ref(), op: {:unit, plugin}, inputs: List.wrap(inputs)}
+  end
+
+  @doc "Channel by channel sum of the given signals"
+  @spec sum(inputs :: [signal()]) :: %Node{}
+  def sum(inputs = [_ | _]), do: %Node{id: make_ref(), op: :sum, inputs: inputs}
+
+  @doc "One output channel of a node"
+  @spec channel(node :: %Node{}, index :: non_neg_integer()) :: signal()
+  def channel(node = %Node{}, index), do: {node, index}
+
+  # -----------------------------------------------------------
+  # Compiler
+
+  @doc "Compile the graph ending in the given output signals"
+  @spec compile(outputs :: signal() | [signal()]) :: t
+  def compile(outputs) do
+    outputs = List.wrap(outputs)
+    {_, order} = Enum.reduce(outputs, {MapSet.new(), []}, &visit/2)
+    nodes = Enum.reverse(order)
+
+    # Instantiate units and count output channels, in topological order
+    {info, ops} = Enum.reduce(nodes, {%{}, []}, &expand/2)
+    ops = Enum.reverse(ops)
+    out_signals = Enum.flat_map(outputs, &signals(&1, info))
+
+    num_inputs =
+      Enum.reduce(nodes, 0, fn
+        %Node{op: {:input, i}}, acc -> max(acc, i + 1)
+        _, acc -> acc
+      end)
+    input_wires =
+      for %Node{id: id, op: {:input, i}} <- nodes, into: %{}, do: {{id, 0}, i}
+
+    {ops, out_wires} = assign_outputs(ops, out_signals, num_inputs, input_wires)
+    {ops, num_scratch} =
+      color(ops, Map.merge(input_wires, out_wires), num_inputs + length(out_signals))
+
+    native =
+      Enum.map(ops, fn %{op: op, args: args, ins: ins, outs: outs} ->
+        {op, args, ins, outs}
+      end)
+    ref = graph_ctor(num_inputs, length(out_signals), num_scratch, native)
+    op_index =
+      ops
+      |> Enum.with_index()
+      |> Enum.reduce(%{}, fn
+        {%{node: id, op: op}, i}, acc when op != :sum -> Map.put(acc, id, i)
+        _, acc -> acc
+      end)
+    %__MODULE__{ref: ref, num_inputs: num_inputs, num_outputs: length(out_signals),
+                num_scratch: num_scratch, ops: op_index}
+    |> SC.Plugin.init_ring()
+  end
+
+  # Depth first post order, shared nodes are visited once.
+  defp visit({node = %Node{}, _index}, acc), do: visit(node, acc)
+  defp visit(node = %Node{id: id, inputs: inputs}, {seen, order}) do
+    if MapSet.member?(seen, id) do
+      {seen, order}
+    else
+      {seen, order} = Enum.reduce(inputs, {MapSet.put(seen, id), order}, &visit/2)
+      {seen, [node | order]}
+    end
+  end
+
+  defp signals({%Node{id: id}, index}, info) do
+    if index >= Map.fetch!(info, id) do
+      raise ArgumentError, "node has no channel #{index}"
+    end
+    [{id, index}]
+  end
+  defp signals(%Node{id: id}, info) do
+    for c <- 0..(Map.fetch!(info, id) - 1), do: {id, c}
+  end
+
+  defp expand(%Node{id: id, op: {:input, _}}, {info, ops}) do
+    {Map.put(info, id, 1), ops}
+  end
+  defp expand(%Node{id: id, op: {:unit, plugin}, inputs: inputs}, {info, ops}) do
+    {handle, args} = (plugin.__struct__).unit(plugin)
+    {nin, nout} = unit_info(handle)
+    ins = Enum.flat_map(inputs, &signals(&1, info))
+    if ins == [] or length(ins) > nin do
+      raise ArgumentError, "#{inspect(plugin.__struct__)} takes #{nin} input channels"
+    end
+    ins = ins ++ List.duplicate(List.last(ins), nin - length(ins))
+    outs = for c <- 0..(nout - 1), do: {id, c}
+    {Map.put(info, id, nout), [%{node: id, op: handle, args: args, ins: ins, outs: outs} | ops]}
+  end
+  defp expand(%Node{id: id, op: :sum, inputs: inputs}, {info, ops}) do
+    terms = Enum.map(inputs, &signals(&1, info))
+    width = terms |> Enum.map(&length/1) |> Enum.max()
+    sums =
+      for c <- 0..(width - 1) do
+        ins = Enum.map(terms, fn term -> Enum.at(term, rem(c, length(term))) end)
+        %{node: id, op: :sum, args: [], ins: ins, outs: [{id, c}]}
+      end
+    {Map.put(info, id, width), Enum.reverse(sums, ops)}
+  end
+
+  # Ops producing a graph output write straight into the output binary.
+  # Outputs that are graph inputs or already taken get a copy op.
+  defp assign_outputs(ops, out_signals, num_inputs, input_wires) do
+    {wires, copies} =
+      out_signals
+      |> Enum.with_index(num_inputs)
+      |> Enum.reduce({%{}, []}, fn {signal, wire}, {wires, copies} ->
+        if Map.has_key?(wires, signal) or Map.has_key?(input_wires, signal) do
+          {wires, [%{node: nil, op: :sum, args: [], ins: [signal], outs: [wire]} | copies]}
+        else
+          {Map.put(wires, signal, wire), copies}
+        end
+      end)
+    {ops ++ Enum.reverse(copies), wires}
+  end
+
+  # Linear scan wire coloring. An op gets its output wires before the
+  # wires of its last read inputs are released, so no op reads and
+  # writes the same buffer.
+  defp color(ops, fixed, first_scratch) do
+    last_use =
+      ops
+      |> Enum.with_index()
+      |> Enum.reduce(%{}, fn {%{ins: ins}, i}, acc ->
+        Enum.reduce(ins, acc, &Map.put(&2, &1, i))
+      end)
+
+    {ops, {_, _, count}} =
+      ops
+      |> Enum.with_index()
+      |> Enum.map_reduce({fixed, [], 0}, fn {op = %{ins: ins, outs: outs}, i}, {wires, free, count} ->
+        {wires, free, count} =
+          Enum.reduce(outs, {wires, free, count}, fn
+            wire, acc when is_integer(wire) -> acc
+            signal, {wires, free, count} ->
+              cond do
+                Map.has_key?(wires, signal) -> {wires, free, count}
+                free == [] -> {Map.put(wires, signal, first_scratch + count), free, count + 1}
+                true -> {Map.put(wires, signal, hd(free)), tl(free), count}
+              end
+          end)
+        in_wires = Enum.map(ins, &Map.fetch!(wires, &1))
+        out_wires = Enum.map(outs, fn wire when is_integer(wire) -> wire
+                                      signal -> Map.fetch!(wires, signal) end)
+        dead =
+          (Enum.filter(Enum.uniq(ins), &(Map.fetch!(last_use, &1) == i)) ++
+             Enum.reject(outs, &(is_integer(&1) or Map.has_key?(last_use, &1))))
+          |> Enum.map(&Map.fetch!(wires, &1))
+          |> Enum.filter(&(&1 >= first_scratch))
+        {%{op | ins: in_wires, outs: out_wires}, {wires, Enum.sort(dead ++ free), count}}
+      end)
+    {ops, count}
+  end
+
+  # -----------------------------------------------------------
+
+  @doc "Set the control parameters of a plugin node in the graph"
+  @spec set_args(t(), node :: %Node{}, args :: [float()]) :: :ok
+  def set_args(%__MODULE__{ref: ref, ops: ops}, %Node{id: id}, args) do
+    graph_set_args(ref, Map.fetch!(ops, id), Enum.map(args, &(&1 * 1.0)))
+  end
+
+  @spec next(t(), frames :: binary() | [binary()]) :: binary() | [binary()]
+  def next(%__MODULE__{ref: ref}, frames) do
+    graph_next(ref, frames)
+  end
+
+  @doc "A graph is itself a unit, e.g. a voice of an SC.Group"
+  @spec unit(t()) :: {reference(), [float()]}
+  def unit(%__MODULE__{ref: ref}), do: {graph_unit(ref), []}
+
+  @spec stream(t(), enum :: Enumerable.t()) :: Enumerable.t()
+  def stream(graph = %__MODULE__{}, enum) do
+    Stream.map(enum, fn frames -> next(graph, frames) end)
+  end
+
+end
@@ -0,0 +1,89 @@
+defmodule SC.Group do
+  @behaviour SC.Plugin
+
+  @moduledoc """
+  ### Parallel group
+
+  A group renders a list of independent voices in parallel on a pool
+  of native worker threads and sums them onto one output bus, like a
+  supernova parallel group. A voice is any plugin implementing the
+  `c:SC.Plugin.unit/1` callback, typically an `SC.Chain` or `SC.Graph`.
+
+      voices = for f <- [200.0, 400.0, 800.0], do: SC.Filter.LPF.new(f)
+      group = SC.Group.new(voices)
+      SC.Group.next(group, frames)
+
+  All voices read the same input, or each voice its own when given a
+  list with one list of channel binaries per voice.
+  The bus has as many channels as the widest voice, a mono voice is
+  added to every channel.
+
+  Voices run on different threads and must not share plugins with each
+  other. The calling process renders voices as well. If the pool is
+  busy with another group the caller renders all voices on its own.
+  Voices may be bound to an SC.ControlBus, and rebound or unbound,
+  while the group runs, see SC.ControlBus.
+
+  The number of worker threads is set by the `:group_threads`
+  application environment, default one less than the number of cores.
+  """
+
+  defstruct [:ref, voices: []]
+
+  @type t() :: %__MODULE__{
+    ref: reference(),
+    voices: [struct()]
+  }
+
+  @on_load :load_nifs
+  @doc false
+  def load_nifs do
+    threads = Application.get_env(:sc_plugin_nifs, :group_threads, 0)
+    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_group', threads) do
+      :ok -> :ok
+      {:error, {:reload, _}} -> :ok
+      {:error, reason} ->
+        :logger.warning('Failed to load sc_group NIF: ~p',[reason])
+    end
+  end
+
+  @doc false
+  def group_ctor(_units), do: raise "NIF group_ctor/1 not loaded"
+  @doc false
+  def group_next(_ref, _frames), do: raise "NIF group_next/2 not loaded"
+  @doc false
+  def group_set_args(_ref, _index, _args), do: raise "NIF group_set_args/3 not loaded"
+  @doc false
+  def group_threads(), do: raise "NIF group_threads/0 not loaded"
+
+  @doc "Create a group from a non empty list of voices"
+  @spec new(voices :: [struct()]) :: t
+  def new(voices = [_ | _]) do
+    units = Enum.map(voices, fn voice -> (voice.__struct__).unit(voice) end)
+    %__MODULE__{ref: group_ctor(units), voices: voices}
+  end
+
+  def ns(enum, voices), do: stream(new(voices), enum)
+
+  @doc "Set the control parameters of the voice at index in the group"
+  @spec set_args(t(), index :: non_neg_integer(), args :: [float()]) :: :ok
+  def set_args(%__MODULE__{ref: ref}, index, args) do
+    group_set_args(ref, index, Enum.map(args, &(&1 * 1.0)))
+  end
+
+  @spec next(t(), frames :: binary() | [binary()] | [[binary()]]) ::
+          binary() | [binary()]
+  def next(%__MODULE__{ref: ref}, frames) do
+    group_next(ref, frames)
+  end
+
+  @doc "Number of native worker threads, not counting the caller"
+  @spec threads() :: non_neg_integer()
+  def threads(), do: group_threads()
+
+  @spec stream(t(), enum :: Enumerable.t()) :: Enumerable.t()
+  def stream(group = %__MODULE__{}, enum) do
+    Stream.map(enum, fn frames -> next(group, frames) end)
+  end
+
+end
@@ -6,6 +6,41 @@ defmodule SC.Plugin do
   SC plugins uses NIFs for generating and transforming the frames in a similar way as Supercollider (SC) uses UGens.
   SC "plugins" should implement the SC.Plugin behavior.
 
+  ## Long binaries
+
+  Binaries may be longer than a period, e.g. for offline processing
+  or to amortize the NIF call overhead. They are rendered period by
+  period, parameter changes ramp over the first period just as when
+  the plugin is called once per period, so the sound does not change.
+  A call rendering more than 16384 samples (times the stages of a
+  chain or graph, or the voices of a bank) hops to a dirty CPU
+  scheduler so it does not block a normal scheduler.
+
+  ## Parameter events
+
+  Plugins with `next/3` take a list of `{offset, index, value}` events
+  with a period. Each sets control parameter `index` (in the order of
+  the `unit/1` parameters) to `value` from sample `offset` on, ramping
+  as a change between two calls would. Events must be in offset order
+  and within the period. The plugin struct is not changed, the values
+  in it apply again from the next call.
+
+      SC.Filter.BPF.next(bpf, frames, [{0, 0, 300.0}, {128, 0, 600.0}, {128, 1, 0.2}])
+
+  Events can also be given as a binary packed with `events/1`, e.g.
+  when generated by a sequencer ahead of time.
+
+  ## Sticky parameters
+
+  Plugins with `set_params/2` keep a native copy of their parameters.
+  `process/2` runs the plugin with the stored copy, a period then only
+  carries the audio binary. The numeric parameters given to `new` are
+  stored from the start.
+
+      lpf = SC.Filter.LPF.new(800.0)
+      lpf = SC.Filter.LPF.set_params(lpf, frequency: 1200.0)
+      SC.Filter.LPF.process(lpf, frames)
+
   ## Installation
 
   **Include from github.**
@@ -25,14 +60,68 @@ defmodule SC.Plugin do
 
   """
   @type frames() :: binary | integer
+  @type events() :: [{non_neg_integer, non_neg_integer, float}] | binary
 
   @callback next(plugin :: struct(), frames :: frames()) :: binary
   @callback stream(plugin :: struct(), frames :: Enumerable.t() | integer) :: Enumerable.t()
 
+  @doc """
+  Return the unit handle of the plugin together with its current
+  control parameters. Used by SC.Chain to run the plugin natively.
+  The handle is the resource reference of the plugin, handles need
+  OTP 24 or later (enif_dynamic_resource_call).
+  """
+  @callback unit(plugin :: struct()) :: {reference, [float]}
+
+  @doc """
+  Like `c:next/2` with control parameter changes at exact samples
+  of the period, see "Parameter events" above.
+  """
+  @callback next(plugin :: struct(), frames :: frames(), events :: events()) :: binary
+
+  @doc """
+  Clear the state of the plugin so it can be reused instead of
+  reallocated, see SC.Pool.
+  """
+  @callback reset(plugin :: struct()) :: struct()
+  @optional_callbacks unit: 1, next: 3, reset: 1
+
   def next(frames, plugin) when is_struct(plugin) do
     (plugin.__struct__).next(plugin, frames)
   end
 
+  @doc "Pack a list of events into the native binary format"
+  @spec events([{non_neg_integer, non_neg_integer, number}]) :: binary
+  def events(list) do
+    for {offset, index, value} <- list, into: <<>> do
+      <<offset::32-signed-native, index::32-native, value * 1.0::float-64-native>>
+    end
+  end
+
+  @doc false
+  def float_params(params), do: for {k, v} <- params, do: {k, v * 1.0}
+
+  @doc false
+  # Store the numeric parameters of a new plugin natively
+  def init_params(plugin, keys) do
+    params = for k <- keys, is_number(v = Map.fetch!(plugin, k)), do: {k, v}
+    (plugin.__struct__).set_params(plugin, params)
+  end
+
+  @doc """
+  Give the plugin a ring of `ring_depth` output blocks of a period
+  each, when set in SC.Ctx. Called by the `new` functions.
+  """
+  @spec init_ring(plugin :: struct()) :: struct()
+  def init_ring(plugin) do
+    case SC.Ctx.get() do
+      %SC.Ctx{ring_depth: depth, period_size: period_size} when depth > 0 ->
+        SC.Buffer.ring(plugin, depth, period_size)
+      _ ->
+        plugin
+    end
+  end
+
   def stream(plugin) when is_struct(plugin) do
     ctx = SC.Ctx.get()
     (plugin.__struct__).stream(plugin, ctx.period_size)
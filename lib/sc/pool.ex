@@ -0,0 +1,116 @@
+defmodule SC.Pool do
+
+  @moduledoc """
+  ### Instance pool
+
+  Creating a reverb or an echo allocates and clears its delay lines,
+  ~90 KB for a FreeVerb2. A pool creates plugins ahead of time and
+  hands them out, plugins checked in are reset and reused instead of
+  being dropped and reallocated, e.g. for note per voice effects.
+
+      {:ok, pool} = SC.Pool.start_link(
+        verb: {&SC.Reverb.FreeVerb.new2/0, 64},
+        echo: {fn -> SC.Reverb.AnalogEcho.new(0.5) end, 256})
+      verb = SC.Pool.checkout(pool, :verb)
+      ...
+      :ok = SC.Pool.checkin(pool, :verb, verb)
+
+  Each type is a function creating a plugin and the number to create
+  at start. Plugins are created by the pool process, SC.Ctx must be
+  put before the pool is started. When a type runs out `checkout/2`
+  creates a new plugin rather than failing, it is kept when checked
+  in.
+
+  A create function may return `{:error, reason}`, e.g.
+  `{:error, :budget_exceeded}` from a reverb when the delay memory
+  budget is spent. Such results are left out of the plugins created
+  at start, so the pool may start with fewer, and `checkout/2` returns
+  the error when it has to create a plugin.
+
+  `checkin/3` calls the `reset/1` of plugins having one, the state is
+  cleared by the next call to the plugin. The parameters in the
+  struct and the sticky parameters are kept, set them when checking
+  the plugin out.
+  """
+
+  use GenServer
+
+  @type type() :: atom()
+
+  @doc "Start a pool with the given types, `[type: {create_fun, count}]`"
+  @spec start_link([{type(), {(() -> struct()), non_neg_integer()}}], GenServer.options()) ::
+          GenServer.on_start()
+  def start_link(types, opts \\ []) do
+    GenServer.start_link(__MODULE__, types, opts)
+  end
+
+  @doc "Take a plugin of type from the pool, `{:error, reason}` if creating one failed"
+  @spec checkout(GenServer.server(), type()) :: struct() | {:error, term()}
+  def checkout(pool, type) do
+    case GenServer.call(pool, {:checkout, type}) do
+      {:ok, plugin} -> plugin
+      {:error, reason} -> {:error, reason}
+      :error -> raise ArgumentError, "unknown pool type #{inspect(type)}"
+    end
+  end
+
+  @doc "Reset the plugin and return it to the pool"
+  @spec checkin(GenServer.server(), type(), plugin :: struct()) :: :ok
+  def checkin(pool, type, plugin) when is_struct(plugin) do
+    module = plugin.__struct__
+    plugin = if function_exported?(module, :reset, 1), do: module.reset(plugin), else: plugin
+    GenServer.cast(pool, {:checkin, type, plugin})
+  end
+
+  @doc "Number of plugins of type waiting in the pool"
+  @spec available(GenServer.server(), type()) :: non_neg_integer()
+  def available(pool, type), do: GenServer.call(pool, {:available, type})
+
+  # -----------------------------------------------------------
+
+  @impl true
+  def init(types) do
+    state =
+      for {type, {create, count}} <- types, into: %{} do
+        plugins =
+          Stream.repeatedly(create)
+          |> Enum.take(count)
+          |> Enum.filter(&is_struct/1)
+        {type, {create, plugins}}
+      end
+    {:ok, state}
+  end
+
+  @impl true
+  def handle_call({:checkout, type}, _from, state) do
+    case Map.fetch(state, type) do
+      {:ok, {create, [plugin | rest]}} ->
+        {:reply, {:ok, plugin}, Map.put(state, type, {create, rest})}
+      {:ok, {create, []}} ->
+        case create.() do
+          plugin when is_struct(plugin) -> {:reply, {:ok, plugin}, state}
+          {:error, reason} -> {:reply, {:error, reason}, state}
+        end
+      :error ->
+        {:reply, :error, state}
+    end
+  end
+
+  def handle_call({:available, type}, _from, state) do
+    case Map.fetch(state, type) do
+      {:ok, {_create, plugins}} -> {:reply, length(plugins), state}
+      :error -> {:reply, 0, state}
+    end
+  end
+
+  @impl true
+  def handle_cast({:checkin, type, plugin}, state) do
+    case Map.fetch(state, type) do
+      {:ok, {create, plugins}} ->
+        {:noreply, Map.put(state, type, {create, [plugin | plugins]})}
+      :error ->
+        {:noreply, state}
+    end
+  end
+
+end
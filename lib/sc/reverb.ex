@@ -6,8 +6,14 @@ defmodule SC.Reverb do
 
   @doc false
   def load_nifs do
-    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_reverb', 0) do
-      :ok -> :ok
+    huge = if Application.get_env(:sc_plugin_nifs, :huge_pages, false), do: 1, else: 0
+    case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++ '/sc_reverb', huge) do
+      :ok ->
+        # See SC.Stats.set_budget/2
+        for {type, bytes} <- Application.get_env(:sc_plugin_nifs, :memory_budgets, []) do
+          memory_budget(type, bytes)
+        end
+        :ok
       {:error, {:reload, _}} -> :ok
       {:error, reason} ->
         :logger.warning('Failed to load sc_reverb NIF: ~p',[reason])
@@ -15,9 +21,106 @@ defmodule SC.Reverb do
   end
 
   @doc false
-  def reverb_ctor(_rate, _level, _type), do: raise "NIF ramp_ctor/3 not loaded"
+  def reverb_ctor(_rate, _level, _type, _storage, _kernel), do: raise "NIF reverb_ctor/5 not loaded"
   @doc false
   def reverb_next(_ref, _frames, _mix, _room, _damp), do: raise "NIF ramp_next/5 not loaded"
+  @doc false
+  def unit(_ref), do: raise "NIF unit/1 not loaded"
+  @doc false
+  def next_events(_ref, _frames, _args, _events), do: raise "NIF next_events/4 not loaded"
+  @doc false
+  def set_params(_ref, _params), do: raise "NIF set_params/2 not loaded"
+  @doc false
+  def process(_ref, _frames), do: raise "NIF process/2 not loaded"
+  @doc false
+  def reset(_ref), do: raise "NIF reset/1 not loaded"
+  @doc false
+  def delay_memory(), do: raise "NIF delay_memory/0 not loaded"
+  @doc false
+  def memory_stats(), do: raise "NIF memory_stats/0 not loaded"
+  @doc false
+  def memory_budget(_type, _bytes), do: raise "NIF memory_budget/2 not loaded"
+
+  @doc """
+  Delay memory of the reverbs and echoes.
+
+  With the `:huge_pages` application environment set to true the
+  delay lines of FreeVerb, GVerb and AnalogEcho are carved from
+  regions backed by huge pages, reserved ones (MAP_HUGETLB) or else
+  transparent huge pages, cutting TLB misses with hundreds of
+  instances. Lines are rounded up to power of two size classes and
+  freed blocks are reused by new plugins of the same class. A region
+  is unmapped once all its plugins are gone, lines over 1 MB get a
+  region of their own. Without huge pages, or when the system has
+  none, the lines come from the VM allocator.
+
+  * `:instances` - plugins holding delay memory.
+  * `:huge_instances` - of those, plugins backed by huge pages.
+  * `:regions`, `:region_bytes` - regions currently mapped.
+  * `:huge_bytes` - region bytes backed by huge pages.
+
+  Transparent huge pages are only advised to the kernel, see
+  AnonHugePages in /proc/meminfo for what it granted.
+  """
+  @spec delay_memory_stats() :: %{atom() => non_neg_integer()}
+  def delay_memory_stats() do
+    Map.merge(delay_memory(), SC.Reverb.AnalogEcho.delay_memory(),
+      fn _key, a, b -> a + b end)
+  end
+
+  @typedoc """
+  Sample format of the delay lines of a reverb or echo, given as the
+  `:storage` option when creating it. Default `:float32`.
+
+  `:float16` and `:int16` (scaled to +-4.0, saturating) halve the
+  delay memory and the bytes moved per sample, at some precision. The
+  error of the output against `:float32` for noise bursts at 48 kHz,
+  in dB relative to the output:
+
+  | plugin     | `:float16` | `:int16` |
+  |------------|-----------:|---------:|
+  | FreeVerb   | -74        | -47      |
+  | FreeVerb2  | -69        | -49      |
+  | GVerb      | -70        | -67      |
+  | AnalogEcho | -88        | -89      |
+
+  The FreeVerb lines carry small levels, int16 loses the most there.
+  The conversions cost time, a gain needs many instances whose lines
+  do not fit the caches: 1024 FreeVerb2 with `:float16` took 57 ns per
+  sample and instance against 68 ns with `:float32`, 256 of them
+  about the same. float16 is converted in hardware when the NIFs are
+  built with F16C (`-mf16c` or `-march=native` in CFLAGS), else in
+  software at about twice the cost of the float32 kernel.
+  """
+  @type storage() :: :float32 | :float16 | :int16
+
+  @typedoc """
+  Kernel of a reverb, given as the `:kernel` option when creating it.
+
+  The `:simd` FreeVerb kernels run the combs in vector lanes, eight
+  for FreeVerb and sixteen for FreeVerb2, their output is the same as
+  the `:scalar` kernels'. With float32 lines on AVX FreeVerb is some
+  5% faster, FreeVerb2 15 to 20%. Without AVX or with `:float16` and
+  `:int16` lines they are slower or no faster.
+
+  The `:block` FreeVerb kernels run each delay line over up to 128
+  samples at a time, reading and writing a segment of the line at
+  once, with the same output. With `:float16` and `:int16` lines they
+  are some 20% faster than the scalar kernels, about twice as fast
+  with F16C and AVX2, with float32 lines they are no faster.
+
+  The `:simd` GVerb kernel runs the four feedback delay lines and the
+  four early reflection taps in vector lanes, their gains, dampers
+  and Hadamard feedback matrix lane wise, with the same output as the
+  `:scalar` kernel. It is 5 to 15% faster for all storages, with or
+  without AVX.
+
+  `:auto`, the default, takes the SIMD kernels for GVerb and for
+  FreeVerb with float32 lines on AVX, and the block kernels for
+  FreeVerb with the other lines. Reverbs without such a kernel run
+  the scalar one.
+  """
+  @type kernel() :: :auto | :simd | :block | :scalar
 
   # -----------------------------------------------------------
 
@@ -49,20 +152,37 @@ defmodule SC.Reverb do
       damp: par()
     }
 
-    @doc "Create one channel FreeVerb filter"
-    @spec new(mix :: par, room :: par, damp :: par) :: t
-    def new(mix \\ 0.33, room \\ 0.5, damp \\ 0.5) do
+    @typedoc "Options, see `t:SC.Reverb.storage/0` and `t:SC.Reverb.kernel/0`"
+    @type opts() :: [storage: SC.Reverb.storage(), kernel: SC.Reverb.kernel()]
+
+    @doc "Create one channel FreeVerb filter with options `:storage` and `:kernel`"
+    @spec new(mix :: par, room :: par, damp :: par, opts :: opts()) ::
+            t | {:error, :budget_exceeded}
+    def new(mix \\ 0.33, room \\ 0.5, damp \\ 0.5, opts \\ []) do
       %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-      %__MODULE__{ref: SC.Reverb.reverb_ctor(rate, period_size, :freeverb),
-                  mix: mix, room: room, damp: damp}
+      storage = Keyword.get(opts, :storage, :float32)
+      kernel = Keyword.get(opts, :kernel, :auto)
+      with ref when is_reference(ref) <-
+             SC.Reverb.reverb_ctor(rate, period_size, :freeverb, storage, kernel) do
+        %__MODULE__{ref: ref, mix: mix, room: room, damp: damp}
+        |> SC.Plugin.init_params([:mix, :room, :damp])
+        |> SC.Plugin.init_ring()
+      end
     end
 
-    @doc "Create two channel FreeVerb filter (FreeVerb2)"
-    @spec new2(mix :: par, room :: par, damp :: par) :: t
-    def new2(mix \\ 0.33, room \\ 0.5, damp \\ 0.5) do
+    @doc "Create two channel FreeVerb filter (FreeVerb2), options as for `new/4`"
+    @spec new2(mix :: par, room :: par, damp :: par, opts :: opts()) ::
+            t | {:error, :budget_exceeded}
+    def new2(mix \\ 0.33, room \\ 0.5, damp \\ 0.5, opts \\ []) do
       %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-      %__MODULE__{ref: SC.Reverb.reverb_ctor(rate, period_size, :freeverb2),
-                  mix: mix, room: room, damp: damp}
+      storage = Keyword.get(opts, :storage, :float32)
+      kernel = Keyword.get(opts, :kernel, :auto)
+      with ref when is_reference(ref) <-
+             SC.Reverb.reverb_ctor(rate, period_size, :freeverb2, storage, kernel) do
+        %__MODULE__{ref: ref, mix: mix, room: room, damp: damp}
+        |> SC.Plugin.init_params([:mix, :room, :damp])
+        |> SC.Plugin.init_ring()
+      end
     end
 
     @doc "Create one channel FreeVerb filter stream"
@@ -82,7 +202,44 @@ defmodule SC.Reverb do
       SC.Reverb.reverb_next(ref, frames, mix, room, damp)
     end
 
+    @doc "Process frames applying events, index 0 is mix, 1 room and 2 damp"
+    @spec next(freeverb :: t(), frames :: binary() | [binary()], SC.Plugin.events()) ::
+            binary() | [binary()]
+    def next(%__MODULE__{ref: ref, mix: mix, room: room, damp: damp}, frames, events)
+    when is_number(mix) and is_number(room) and is_number(damp) do
+      SC.Reverb.next_events(ref, frames, [mix * 1.0, room * 1.0, damp * 1.0], events)
+    end
+
+    @spec unit(freeverb :: t()) :: {reference(), [float()]}
+    def unit(%__MODULE__{ref: ref, mix: mix, room: room, damp: damp})
+    when is_number(mix) and is_number(room) and is_number(damp) do
+      {SC.Reverb.unit(ref), [mix * 1.0, room * 1.0, damp * 1.0]}
+    end
+
+    @doc "Store parameters in the native unit, used by `process/2`"
+    @spec set_params(freeverb :: t(), params :: keyword()) :: t()
+    def set_params(freeverb = %__MODULE__{ref: ref}, params) do
+      :ok = SC.Reverb.set_params(ref, SC.Plugin.float_params(params))
+      struct!(freeverb, params)
+    end
+
+    @doc "Process frames with the stored parameters"
+    @spec process(freeverb :: t(), frames :: binary() | [binary()]) :: binary() | [binary()]
+    def process(%__MODULE__{ref: ref}, frames), do: SC.Reverb.process(ref, frames)
+
+    @doc "Clear the reverb tail for reuse, the delay lines are cleared by the next call"
+    @spec reset(freeverb :: t()) :: t()
+    def reset(freeverb = %__MODULE__{ref: ref}) do
+      :ok = SC.Reverb.reset(ref)
+      freeverb
+    end
+
     @spec stream(freeverb :: t(), enum :: Enumerable.t()) :: Enumerable.t()
+    def stream(freeverb = %__MODULE__{mix: mix, room: room, damp: damp}, enum)
+    when is_number(mix) and is_number(room) and is_number(damp) do
+      freeverb = set_params(freeverb, mix: mix, room: room, damp: damp)
+      Stream.map(enum, fn frames -> process(freeverb, frames) end)
+    end
     def stream(freeverb = %__MODULE__{mix: a}, enum) when is_float(a) do
       ls = Stream.unfold(a, fn x -> {x,x} end)
       stream(%{freeverb | :mix => ls}, enum)
@@ -106,4 +263,115 @@ defmodule SC.Reverb do
     end
   end
 
+  # -----------------------------------------------------------
+
+  defmodule GVerb do
+    @behaviour SC.Plugin
+    @moduledoc """
+    ### GVerb plugin
+
+    The SC.Reverb.GVerb module instances a mono in, stereo out GVerb
+    reverb. Parameters are given as a keyword list, see `t:t/0`.
+
+        gverb = SC.Reverb.GVerb.new(roomsize: 20.0, revtime: 4.0)
+        [left, right] = SC.Reverb.GVerb.next(gverb, frames)
+
+    `spread` and `maxroomsize` are taken when the first period is
+    processed, `roomsize` must not exceed `maxroomsize`.
+    """
+
+    @params [:roomsize, :revtime, :damping, :inputbw, :spread,
+             :drylevel, :earlyreflevel, :taillevel, :maxroomsize]
+
+    defstruct [:ref, roomsize: 10.0, revtime: 3.0, damping: 0.5, inputbw: 0.5,
+               spread: 15.0, drylevel: 1.0, earlyreflevel: 0.7, taillevel: 0.5,
+               maxroomsize: 300.0]
+    @typedoc """
+    Properties that can be set for GVerb.
+
+    Available options are:
+    * `:roomsize` - room size in meters. Default 10.
+    * `:revtime` - reverberation time in seconds. Default 3.
+    * `:damping` - HF damping, 0..1. Default 0.5.
+    * `:inputbw` - input bandwidth, 0..1. Default 0.5.
+    * `:spread` - stereo spread and diffusion, 0..160, clamped to that
+      range. Default 15.
+    * `:drylevel` - dry signal level. Default 1.
+    * `:earlyreflevel` - early reflection level. Default 0.7.
+    * `:taillevel` - tail level. Default 0.5.
+    * `:maxroomsize` - largest room size in meters. Default 300.
+    """
+    @type t() :: %__MODULE__{
+      ref: reference(),
+      roomsize: float(),
+      revtime: float(),
+      damping: float(),
+      inputbw: float(),
+      spread: float(),
+      drylevel: float(),
+      earlyreflevel: float(),
+      taillevel: float(),
+      maxroomsize: float()
+    }
+
+    @doc """
+    Create a GVerb, `params` may also hold `:storage` and `:kernel`,
+    see `t:SC.Reverb.storage/0` and `t:SC.Reverb.kernel/0`
+    """
+    @spec new(params :: keyword()) :: t | {:error, :budget_exceeded}
+    def new(params \\ []) do
+      %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
+      {storage, params} = Keyword.pop(params, :storage, :float32)
+      {kernel, params} = Keyword.pop(params, :kernel, :auto)
+      with ref when is_reference(ref) <-
+             SC.Reverb.reverb_ctor(rate, period_size, :gverb, storage, kernel) do
+        %__MODULE__{ref: ref}
+        |> struct!(params)
+        |> SC.Plugin.init_params(@params)
+        |> SC.Plugin.init_ring()
+      end
+    end
+
+    def ns(enum, params \\ []), do: stream(new(params), enum)
+
+    @spec next(gverb :: t(), frames :: binary() | [binary()]) :: [binary()]
+    def next(gverb = %__MODULE__{ref: ref}, frames) do
+      SC.Reverb.next_events(ref, frames, args(gverb), [])
+    end
+
+    @doc "Process frames applying events, indices in the order of `t:t/0`"
+    @spec next(gverb :: t(), frames :: binary() | [binary()], SC.Plugin.events()) :: [binary()]
+    def next(gverb = %__MODULE__{ref: ref}, frames, events) do
+      SC.Reverb.next_events(ref, frames, args(gverb), events)
+    end
+
+    @spec unit(gverb :: t()) :: {reference(), [float()]}
+    def unit(gverb = %__MODULE__{ref: ref}), do: {SC.Reverb.unit(ref), args(gverb)}
+
+    @doc "Store parameters in the native unit, used by `process/2`"
+    @spec set_params(gverb :: t(), params :: keyword()) :: t()
+    def set_params(gverb = %__MODULE__{ref: ref}, params) do
+      :ok = SC.Reverb.set_params(ref, SC.Plugin.float_params(params))
+      struct!(gverb, params)
+    end
+
+    @doc "Process frames with the stored parameters"
+    @spec process(gverb :: t(), frames :: binary() | [binary()]) :: [binary()]
+    def process(%__MODULE__{ref: ref}, frames), do: SC.Reverb.process(ref, frames)
+
+    @doc "Clear the reverb tail for reuse, the delay lines are cleared by the next call"
+    @spec reset(gverb :: t()) :: t()
+    def reset(gverb = %__MODULE__{ref: ref}) do
+      :ok = SC.Reverb.reset(ref)
+      gverb
+    end
+
+    @spec stream(gverb :: t(), enum :: Enumerable.t()) :: Enumerable.t()
+    def stream(gverb = %__MODULE__{}, enum) do
+      Stream.map(enum, fn frames -> process(gverb, frames) end)
+    end
+
+    defp args(gverb), do: for k <- @params, do: Map.fetch!(gverb, k) * 1.0
+  end
+
 end
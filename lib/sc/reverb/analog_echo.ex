@@ -19,14 +19,15 @@ defmodule SC.Reverb.AnalogEcho do
 
   Available options are:
     * `:maxdelay` - max size of delay buffer in seconds. Default 0.3.
-    * `:delay` - delay for echo in seconds. Default 0.3.
+    * `:delay` - delay for echo in seconds. Default 0.3. May also be
+      a binary of native floats, see `next/2`.
     * `:fb` - feedback coefficient. Default 0.9.
     * `:coeff` - filter coefficient. Default 0.95.
   """
   @type t() :: %__MODULE__{
     ref: reference(),
     maxdelay: float(),
-    delay: float(),
+    delay: float() | binary(),
     fb: float(),
     coeff: float()
   }
@@ -35,9 +36,16 @@ defmodule SC.Reverb.AnalogEcho do
   @on_load :load_nifs
   @doc false
   def load_nifs do
+    # See SC.Reverb.delay_memory_stats/0
+    huge = if Application.get_env(:sc_plugin_nifs, :huge_pages, false), do: 1, else: 0
     case :erlang.load_nif(:code.priv_dir(:sc_plugin_nifs) ++
-          '/sc_analog_echo', 0) do
-      :ok -> :ok
+          '/sc_analog_echo', huge) do
+      :ok ->
+        # See SC.Stats.set_budget/2
+        for {type, bytes} <- Application.get_env(:sc_plugin_nifs, :memory_budgets, []) do
+          analog_echo_memory_budget(type, bytes)
+        end
+        :ok
       {:error, {:reload, _}} -> :ok
       {:error, reason} ->
         :logger.warning('Failed to load sc_analog_echo nif: ~p', [reason])
@@ -45,8 +53,8 @@ defmodule SC.Reverb.AnalogEcho do
   end
 
   @doc false
-  defp analog_echo_ctor(_rate, _period_size, _maxdelay) do
-    raise "NIF analog_echo_ctor/3 not loaded"
+  defp analog_echo_ctor(_rate, _period_size, _maxdelay, _storage) do
+    raise "NIF analog_echo_ctor/4 not loaded"
   end
 
   @doc false
@@ -54,20 +62,127 @@ defmodule SC.Reverb.AnalogEcho do
     raise "NIF analog_echo_next/5 not loaded"
   end
 
+  @doc false
+  defp analog_echo_unit(_ref) do
+    raise "NIF analog_echo_unit/1 not loaded"
+  end
+
+  @doc false
+  defp analog_echo_next_events(_ref, _frames, _args, _events) do
+    raise "NIF analog_echo_next_events/4 not loaded"
+  end
+
+  @doc false
+  defp analog_echo_set_params(_ref, _params) do
+    raise "NIF analog_echo_set_params/2 not loaded"
+  end
+
+  @doc false
+  defp analog_echo_process(_ref, _frames) do
+    raise "NIF analog_echo_process/2 not loaded"
+  end
+
+  @doc false
+  defp analog_echo_reset(_ref) do
+    raise "NIF analog_echo_reset/1 not loaded"
+  end
+
+  @doc false
+  defp analog_echo_delay_memory() do
+    raise "NIF analog_echo_delay_memory/0 not loaded"
+  end
+
+  @doc false
+  defp analog_echo_memory_stats() do
+    raise "NIF analog_echo_memory_stats/0 not loaded"
+  end
+
+  @doc false
+  defp analog_echo_memory_budget(_type, _bytes) do
+    raise "NIF analog_echo_memory_budget/2 not loaded"
+  end
 
-  @spec new(maxdelay :: float) :: t
-  def new(maxdelay \\ 0.3) do
+
+  @doc "Create an echo. Option `:storage`, see `t:SC.Reverb.storage/0`"
+  @spec new(maxdelay :: float, opts :: [storage: SC.Reverb.storage()]) ::
+          t | {:error, :budget_exceeded}
+  def new(maxdelay \\ 0.3, opts \\ []) do
     %SC.Ctx{rate: rate, period_size: period_size} = SC.Ctx.get()
-    %__MODULE__{ref: analog_echo_ctor(rate, period_size, maxdelay), maxdelay: maxdelay, delay: maxdelay}
+    storage = Keyword.get(opts, :storage, :float32)
+    with ref when is_reference(ref) <- analog_echo_ctor(rate, period_size, maxdelay, storage) do
+      %__MODULE__{ref: ref, maxdelay: maxdelay, delay: maxdelay}
+      |> SC.Plugin.init_ring()
+    end
   end
 
   def ns(enum, maxdelay \\ 0.3), do: stream(new(maxdelay), enum)
 
+  @doc """
+  Process frames. With delay a binary of native floats, one delay
+  time in seconds per sample and as long as frames (or a period when
+  frames is `<<>>`), the read head follows the modulated delay within
+  the call, clamped to `maxdelay`. That gives chorus, flanger and tape
+  wobble effects at the full period size.
+
+  A binary delay applies to `next/2` only. `next/3`, `unit/1` (SC.Buffer,
+  SC.Chain, SC.Graph, SC.Group) and `set_params/2` raise
+  `ArgumentError` for it, they take a number.
+  """
   @spec next(t(), frames :: binary()) :: binary()
   def next(%__MODULE__{ref: ref, delay: delay, fb: fb, coeff: coeff}, frames) do
     analog_echo_next(ref, frames, delay, fb, coeff)
   end
 
+  @doc "Process frames applying events, index 0 is delay, 1 fb and 2 coeff"
+  @spec next(t(), frames :: binary(), SC.Plugin.events()) :: binary()
+  def next(analog_echo = %__MODULE__{ref: ref}, frames, events) do
+    analog_echo_next_events(ref, frames, args(analog_echo), events)
+  end
+
+  @spec unit(t()) :: {reference(), [float()]}
+  def unit(analog_echo = %__MODULE__{ref: ref}) do
+    {analog_echo_unit(ref), args(analog_echo)}
+  end
+
+  # Control rate args, a modulated delay only runs through next/2
+  defp args(%__MODULE__{delay: delay}) when is_binary(delay) do
+    raise ArgumentError, "a binary delay runs through next/2 only, give a number"
+  end
+  defp args(%__MODULE__{delay: delay, fb: fb, coeff: coeff}) do
+    [delay * 1.0, fb * 1.0, coeff * 1.0]
+  end
+
+  @doc """
+  Store delay, fb and coeff in the native unit, used by `process/2`.
+  Raises `ArgumentError` for a binary delay, see `next/2`.
+  """
+  @spec set_params(t(), params :: keyword()) :: t()
+  def set_params(analog_echo = %__MODULE__{ref: ref}, params) do
+    if Enum.any?(params, fn {_key, value} -> is_binary(value) end) do
+      raise ArgumentError, "a binary delay runs through next/2 only, give a number"
+    end
+    :ok = analog_echo_set_params(ref, SC.Plugin.float_params(params))
+    struct!(analog_echo, params)
+  end
+
+  @doc "Process frames with the stored parameters"
+  @spec process(t(), frames :: binary()) :: binary()
+  def process(%__MODULE__{ref: ref}, frames), do: analog_echo_process(ref, frames)
+
+  @doc "Clear the echo for reuse, the delay line is cleared by the next call"
+  @spec reset(t()) :: t()
+  def reset(analog_echo = %__MODULE__{ref: ref}) do
+    :ok = analog_echo_reset(ref)
+    analog_echo
+  end
+
+  @doc false
+  def delay_memory(), do: analog_echo_delay_memory()
+  @doc false
+  def memory_stats(), do: analog_echo_memory_stats()
+  @doc false
+  def memory_budget(type, bytes), do: analog_echo_memory_budget(type, bytes)
+
   @spec stream(t(), enum :: Enumerable.t()) :: Enumerable.t()
   def stream(analog_echo, enum) do
     # When upstream halted - emit echo for 500 * 6 ms ~ 3 s
@@ -0,0 +1,50 @@
+defmodule SC.Stats do
+
+  @moduledoc """
+  ### Native memory
+
+  Every plugin library counts the live instances and native bytes of
+  each of its plugin types: the resource and what the plugin allocates
+  besides, delay lines, bank lanes and the like. Bytes of a plugin are
+  given back when its resource is garbage collected.
+
+      %{freeverb2: %{instances: n, bytes: bytes, budget: :infinity}} = SC.Stats.memory()
+
+  A type may be given a budget of bytes. Constructors of a type whose
+  live bytes would go past its budget return `{:error, :budget_exceeded}`
+  instead of a plugin, plugins already created are not affected.
+  Budgets are set with `set_budget/2` or, when the NIFs load, from
+  the `:memory_budgets` application environment:
+
+      config :sc_plugin_nifs, memory_budgets: [freeverb2: 64_000_000, gverb: 200_000_000]
+
+  GVerb allocates its delay lines on the first call, those are counted
+  then and are not checked against the budget.
+  """
+
+  @type type() :: atom()
+  @type counters() :: %{
+    instances: non_neg_integer(),
+    bytes: non_neg_integer(),
+    budget: pos_integer() | :infinity
+  }
+
+  @modules [SC.Filter, SC.Reverb, SC.Reverb.AnalogEcho]
+
+  @doc "Live instances, bytes and budget per plugin type"
+  @spec memory() :: %{type() => counters()}
+  def memory() do
+    Enum.reduce(@modules, %{}, fn module, acc -> Map.merge(acc, module.memory_stats()) end)
+  end
+
+  @doc "Set the budget of bytes of a plugin type, `:infinity` for none"
+  @spec set_budget(type(), bytes :: pos_integer() | :infinity) :: :ok
+  def set_budget(type, bytes) when is_atom(type) do
+    if Enum.any?(@modules, &(&1.memory_budget(type, bytes) == :ok)) do
+      :ok
+    else
+      raise ArgumentError, "unknown plugin type #{inspect(type)}"
+    end
+  end
+
+end
@@ -0,0 +1,41 @@
+defmodule SC.DelayMemoryTest do
+  use ExUnit.Case, async: false
+
+  # Echoes of varied maxdelay created and dropped again must not grow
+  # the mapped delay memory, all but the current region are unmapped.
+  # The longest lines get regions of their own. Without huge pages
+  # the regions stay at 0.
+  @region 2 * 1024 * 1024
+
+  test "dropping echoes of varied maxdelay gives back their regions" do
+    SC.Ctx.put(%SC.Ctx{rate: 48000, period_size: 64})
+    base = SC.Reverb.delay_memory_stats()
+    for cycle <- 1..20 do
+      drop(fn ->
+        for k <- 1..8, do: SC.Reverb.AnalogEcho.new(0.01 * cycle + 0.9 * k)
+      end)
+      stats = wait_instances(base.instances, 100)
+      assert stats.instances == base.instances
+      assert stats.region_bytes <= base.region_bytes + @region
+    end
+  end
+
+  # Run fun in a process of its own, the plugins it holds are freed
+  # when it exits
+  defp drop(fun) do
+    {pid, ref} = spawn_monitor(fn -> fun.() end)
+    receive do
+      {:DOWN, ^ref, :process, ^pid, :normal} -> :ok
+    end
+  end
+
+  defp wait_instances(instances, tries) do
+    stats = SC.Reverb.delay_memory_stats()
+    if stats.instances == instances or tries == 0 do
+      stats
+    else
+      Process.sleep(10)
+      wait_instances(instances, tries - 1)
+    end
+  end
+end
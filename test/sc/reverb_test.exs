@@ -0,0 +1,93 @@
+defmodule SC.ReverbTest do
+  use ExUnit.Case, async: false
+
+  # The kernels of a reverb must render byte identical output, also
+  # with parameters changing within and between periods and a NaN in
+  # the input. Each storage runs at its own rate and period size.
+  @runs [{:float32, 48000, 64}, {:float16, 44100, 37}, {:int16, 96000, 1000}]
+  @periods 60
+
+  defp ctx(rate, period_size) do
+    SC.Ctx.put(%SC.Ctx{rate: rate, period_size: period_size})
+  end
+
+  # Noise bursts, with a NaN in the last period as it turns the tail
+  # to NaN
+  defp input(seed, period_size) do
+    :rand.seed(:exsss, {seed, 2, 3})
+    for p <- 0..(@periods - 1) do
+      for i <- 0..(period_size - 1), into: <<>> do
+        cond do
+          p == @periods - 1 and i == 5 -> <<0x7FC00000::32-native>>
+          rem(p * period_size + i, 9000) < 300 -> <<:rand.uniform() - 0.5::float-32-native>>
+          true -> <<0.0::float-32-native>>
+        end
+      end
+    end
+  end
+
+  defp stereo(period_size) do
+    for {l, r} <- Enum.zip(input(1, period_size), input(2, period_size)), do: [l, r]
+  end
+
+  # Runs the inputs with events from `events.(period, period_size)`
+  # and sets `params` on the struct half way
+  defp render(plugin, module, inputs, period_size, events, params) do
+    {_, out} =
+      inputs
+      |> Enum.with_index()
+      |> Enum.reduce({plugin, []}, fn {frames, p}, {plugin, acc} ->
+        plugin = if p == div(@periods, 2), do: struct!(plugin, params), else: plugin
+        {plugin, [module.next(plugin, frames, events.(p, period_size)) | acc]}
+      end)
+    Enum.reverse(out)
+  end
+
+  defp freeverb_events(p, period_size) do
+    [{0, 1, 0.3 + p / @periods * 0.6}, {div(period_size, 3), 2, 0.8}]
+  end
+
+  defp gverb_events(p, period_size) do
+    [{0, 1, 1.0 + p / @periods * 3.0}, {div(period_size, 3), 2, 0.8}]
+  end
+
+  defp freeverb(new, kernels, inputs) do
+    for {storage, rate, period_size} <- @runs do
+      ctx(rate, period_size)
+      ins = inputs.(period_size)
+      [ref | rest] =
+        for kernel <- kernels do
+          SC.Reverb.FreeVerb
+          |> apply(new, [0.5, 0.4, 0.2, [storage: storage, kernel: kernel]])
+          |> render(SC.Reverb.FreeVerb, ins, period_size, &freeverb_events/2,
+                    mix: 0.7, room: 0.9, damp: 0.6)
+        end
+      for {out, kernel} <- Enum.zip(rest, tl(kernels)) do
+        assert out == ref, "FreeVerb #{new} #{storage} #{kernel} differs from scalar"
+      end
+    end
+  end
+
+  test "GVerb :simd renders as :scalar" do
+    for {storage, rate, period_size} <- @runs do
+      ctx(rate, period_size)
+      ins = input(1, period_size)
+      [ref, out] =
+        for kernel <- [:scalar, :simd] do
+          [storage: storage, kernel: kernel]
+          |> SC.Reverb.GVerb.new()
+          |> render(SC.Reverb.GVerb, ins, period_size, &gverb_events/2,
+                    roomsize: 20.0, spread: 40.0, inputbw: 0.8)
+        end
+      assert out == ref, "GVerb #{storage} simd differs from scalar"
+    end
+  end
+
+  test "FreeVerb :simd and :block render as :scalar" do
+    freeverb(:new, [:scalar, :simd, :block], &input(1, &1))
+  end
+
+  test "FreeVerb2 :simd and :block render as :scalar" do
+    freeverb(:new2, [:scalar, :simd, :block], &stereo/1)
+  end
+end
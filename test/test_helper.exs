@@ -0,0 +1,3 @@
+# Exercise the delay memory regions, see SC.Reverb.delay_memory_stats/0
+Application.put_env(:sc_plugin_nifs, :huge_pages, true)
+ExUnit.start()